@@ -0,0 +1,97 @@
+#ifndef LOCKFREE_BENCH_UTIL_HPP
+#define LOCKFREE_BENCH_UTIL_HPP
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+inline uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Baseline every queue benchmark is compared against.
+template <typename T>
+class MutexQueue {
+public:
+    void push(const T& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push(value);
+    }
+
+    void push(T&& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push(std::move(value));
+    }
+
+    bool pop(T& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+            return false;
+        }
+        value = std::move(queue_.front());
+        queue_.pop();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::queue<T> queue_;
+};
+
+// Fixed-size message carrying its enqueue timestamp.
+template <size_t N>
+struct Payload {
+    static_assert(N >= 2 * sizeof(uint64_t), "payload too small");
+
+    Payload() : stamp(0) {}
+    explicit Payload(uint64_t s) : stamp(s) {}
+
+    uint64_t stamp;
+    char bytes[N - sizeof(uint64_t)];
+};
+
+// Collects latency samples and reports percentiles as user counters.
+class LatencyRecorder {
+public:
+    void reserve(size_t n) { samples_.reserve(n); }
+    void record(uint64_t ns) { samples_.push_back(ns); }
+
+    void merge(const LatencyRecorder& other) {
+        samples_.insert(samples_.end(), other.samples_.begin(),
+                        other.samples_.end());
+    }
+
+    size_t count() const { return samples_.size(); }
+
+    void report(benchmark::State& state) {
+        if (samples_.empty()) {
+            return;
+        }
+        std::sort(samples_.begin(), samples_.end());
+        state.counters["p50_ns"] = percentile(0.50);
+        state.counters["p99_ns"] = percentile(0.99);
+        state.counters["p999_ns"] = percentile(0.999);
+        state.counters["max_ns"] = static_cast<double>(samples_.back());
+    }
+
+private:
+    double percentile(double p) const {
+        size_t rank = static_cast<size_t>(p * (samples_.size() - 1) + 0.5);
+        return static_cast<double>(samples_[rank]);
+    }
+
+    std::vector<uint64_t> samples_;
+};
+
+} // namespace bench
+
+#endif // LOCKFREE_BENCH_UTIL_HPP
@@ -0,0 +1,122 @@
+#include <benchmark/benchmark.h>
+#include "../include/lockfree/hash_map.hpp"
+#include "perf_counters.hpp"
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+// What HashMap replaces: an unordered_map behind one mutex.
+class MutexMap {
+public:
+    bool find(uint64_t key, uint64_t& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = map_.find(key);
+        if (it == map_.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    void insert_or_assign(uint64_t key, uint64_t value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_[key] = value;
+    }
+
+    void erase(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_.erase(key);
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, uint64_t> map_;
+};
+
+const uint64_t kKeys = 1 << 16;
+
+template <typename Map>
+void prefill(Map& map) {
+    for (uint64_t k = 0; k < kKeys; k += 2) {
+        map.insert_or_assign(k, k);
+    }
+}
+
+// Each thread walks its own xorshift sequence over kKeys keys, half of
+// them present. write_pct of the operations alternate between
+// insert_or_assign and erase, the rest are lookups.
+template <typename Map>
+void run_mix(benchmark::State& state, Map& map, int write_pct) {
+    uint64_t x = 0x9e3779b97f4a7c15ull * (state.thread_index() + 1);
+    uint64_t hits = 0;
+    bench::PerfCounters perf;
+    perf.start();
+    for (auto _ : state) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        const uint64_t key = x % kKeys;
+        if (static_cast<int>(x >> 57) % 100 < write_pct) {
+            if (x & (1ull << 40)) {
+                map.insert_or_assign(key, x);
+            } else {
+                map.erase(key);
+            }
+        } else {
+            uint64_t value;
+            hits += map.find(key, value);
+        }
+    }
+    perf.stop();
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+    perf.report(state, state.iterations());
+}
+
+} // namespace
+
+// Maps are function statics shared by every thread of a run.
+static void BM_HashMap_ReadHeavy(benchmark::State& state) {
+    static lockfree::HashMap<uint64_t, uint64_t> map(kKeys);
+    if (state.thread_index() == 0) prefill(map);
+    run_mix(state, map, 5);
+}
+BENCHMARK(BM_HashMap_ReadHeavy)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_MutexMap_ReadHeavy(benchmark::State& state) {
+    static MutexMap map;
+    if (state.thread_index() == 0) prefill(map);
+    run_mix(state, map, 5);
+}
+BENCHMARK(BM_MutexMap_ReadHeavy)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_HashMap_WriteHeavy(benchmark::State& state) {
+    static lockfree::HashMap<uint64_t, uint64_t> map(kKeys);
+    if (state.thread_index() == 0) prefill(map);
+    run_mix(state, map, 50);
+}
+BENCHMARK(BM_HashMap_WriteHeavy)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_MutexMap_WriteHeavy(benchmark::State& state) {
+    static MutexMap map;
+    if (state.thread_index() == 0) prefill(map);
+    run_mix(state, map, 50);
+}
+BENCHMARK(BM_MutexMap_WriteHeavy)->ThreadRange(1, 16)->UseRealTime();
+
+// Starts empty so that the timed loop runs through every resize.
+static void BM_HashMap_InsertGrowing(benchmark::State& state) {
+    for (auto _ : state) {
+        lockfree::HashMap<uint64_t, uint64_t> map;
+        for (uint64_t k = 0; k < kKeys; ++k) {
+            map.insert(k, k);
+        }
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.iterations() * kKeys);
+}
+BENCHMARK(BM_HashMap_InsertGrowing)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include "../include/lockfree/object_pool.hpp"
+#include "../include/lockfree/queue.hpp"
+#include "perf_counters.hpp"
+#include <vector>
+
+namespace {
+
+struct Buffer {
+    char bytes[4096];
+};
+
+// What ObjectPool replaces: idle objects parked in a Queue<T*>, which
+// allocates and retires a node on every release/acquire pair.
+class QueuePool {
+public:
+    ~QueuePool() {
+        Buffer* b = nullptr;
+        while (queue_.pop(b)) {
+            delete b;
+        }
+    }
+
+    Buffer* acquire() {
+        Buffer* b = nullptr;
+        return queue_.pop(b) ? b : new Buffer;
+    }
+
+    void release(Buffer* b) { queue_.push(b); }
+
+private:
+    lockfree::Queue<Buffer*> queue_;
+};
+
+const int kBurst = 16;
+
+// Each iteration takes a burst of objects and hands them back, as a
+// request handler holding a few buffers at once would.
+template <typename Pool>
+void run_acquire_release(benchmark::State& state, Pool& pool) {
+    std::vector<Buffer*> held(kBurst);
+    bench::PerfCounters perf;
+    perf.start();
+    for (auto _ : state) {
+        for (int i = 0; i < kBurst; ++i) {
+            held[i] = pool.acquire();
+            benchmark::DoNotOptimize(held[i]);
+        }
+        for (int i = 0; i < kBurst; ++i) {
+            pool.release(held[i]);
+        }
+    }
+    perf.stop();
+    state.SetItemsProcessed(state.iterations() * kBurst);
+    perf.report(state, state.iterations() * kBurst);
+}
+
+} // namespace
+
+// Shared by every benchmark thread; function statics so that all
+// threads of a run see the same pool.
+static void BM_ObjectPool_AcquireRelease(benchmark::State& state) {
+    static lockfree::ObjectPool<Buffer> pool;
+    run_acquire_release(state, pool);
+}
+BENCHMARK(BM_ObjectPool_AcquireRelease)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_QueuePool_AcquireRelease(benchmark::State& state) {
+    static QueuePool pool;
+    run_acquire_release(state, pool);
+}
+BENCHMARK(BM_QueuePool_AcquireRelease)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,191 @@
+#ifndef LOCKFREE_PERF_COUNTERS_HPP
+#define LOCKFREE_PERF_COUNTERS_HPP
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+// Hardware counters read through perf_event_open and reported as
+// per-operation user counters. Counters are opened with inherit set, so
+// create the object before any threads it should cover (e.g. before
+// constructing a ThreadPool). Events the kernel or container refuses are
+// skipped; with perf access fully restricted nothing is reported. The
+// software context-switch count is kept whenever it can be opened.
+//
+// LOCKFREE_PERF=0 disables collection. LOCKFREE_PERF_HITM_EVENT=<hex>
+// adds a model-specific raw event for HITM cache-line transfers, e.g.
+// 0x4d2 (MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM) on Skylake.
+class PerfCounters {
+public:
+    PerfCounters() {
+        for (int i = 0; i < kNumEvents; ++i) {
+            fds_[i] = -1;
+            start_[i] = 0;
+            delta_[i] = 0;
+        }
+        const char* env = std::getenv("LOCKFREE_PERF");
+        if (env && std::strcmp(env, "0") == 0) {
+            return;
+        }
+#if defined(__linux__)
+        open_event(kCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open_event(kInstructions, PERF_TYPE_HARDWARE,
+                   PERF_COUNT_HW_INSTRUCTIONS);
+        open_event(kBranchMisses, PERF_TYPE_HARDWARE,
+                   PERF_COUNT_HW_BRANCH_MISSES);
+        open_event(kL1dMisses, PERF_TYPE_HW_CACHE,
+                   PERF_COUNT_HW_CACHE_L1D |
+                   (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        open_event(kLlcMisses, PERF_TYPE_HW_CACHE,
+                   PERF_COUNT_HW_CACHE_LL |
+                   (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        open_event(kContextSwitches, PERF_TYPE_SOFTWARE,
+                   PERF_COUNT_SW_CONTEXT_SWITCHES);
+        const char* hitm = std::getenv("LOCKFREE_PERF_HITM_EVENT");
+        if (hitm) {
+            open_event(kHitm, PERF_TYPE_RAW, std::strtoull(hitm, nullptr, 16));
+        }
+#endif
+        if (!available()) {
+            warn_once();
+        }
+    }
+
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (int i = 0; i < kNumEvents; ++i) {
+            if (fds_[i] >= 0) {
+                close(fds_[i]);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // True if any hardware event could be opened.
+    bool available() const {
+        for (int i = 0; i < kNumEvents; ++i) {
+            if (i != kContextSwitches && fds_[i] >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start() {
+        for (int i = 0; i < kNumEvents; ++i) {
+            start_[i] = read_event(i);
+        }
+    }
+
+    void stop() {
+        for (int i = 0; i < kNumEvents; ++i) {
+            delta_[i] = read_event(i) - start_[i];
+        }
+    }
+
+    // Publishes the counts between start() and stop() divided by ops.
+    // Averaged over benchmark threads so ->Threads(n) stays per-op.
+    void report(benchmark::State& state, double ops) const {
+        if (ops <= 0) {
+            return;
+        }
+        static const char* const kNames[kNumEvents] = {
+            "cycles/op", "instructions/op", "branch_misses/op",
+            "l1d_misses/op", "llc_misses/op", "ctx_switches/op", "hitm/op"
+        };
+        for (int i = 0; i < kNumEvents; ++i) {
+            if (fds_[i] >= 0) {
+                state.counters[kNames[i]] = benchmark::Counter(
+                    static_cast<double>(delta_[i]) / ops,
+                    benchmark::Counter::kAvgThreads);
+            }
+        }
+    }
+
+private:
+    enum Event {
+        kCycles,
+        kInstructions,
+        kBranchMisses,
+        kL1dMisses,
+        kLlcMisses,
+        kContextSwitches,
+        kHitm,
+        kNumEvents
+    };
+
+#if defined(__linux__)
+    void open_event(int index, uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds_[index] = static_cast<int>(
+            syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    // Current count, scaled up if the event was multiplexed.
+    uint64_t read_event(int index) const {
+#if defined(__linux__)
+        if (fds_[index] < 0) {
+            return 0;
+        }
+        uint64_t values[3] = {0, 0, 0};
+        if (read(fds_[index], values, sizeof(values)) !=
+            static_cast<ssize_t>(sizeof(values))) {
+            return 0;
+        }
+        if (values[2] == 0) {
+            return 0;
+        }
+        if (values[2] < values[1]) {
+            return static_cast<uint64_t>(
+                static_cast<double>(values[0]) * values[1] / values[2]);
+        }
+        return values[0];
+#else
+        (void)index;
+        return 0;
+#endif
+    }
+
+    static void warn_once() {
+        static std::atomic<bool> warned{false};
+        if (!warned.exchange(true)) {
+            std::cerr << "perf_event_open unavailable "
+                         "(check kernel.perf_event_paranoid); "
+                         "hardware counters disabled\n";
+        }
+    }
+
+    int fds_[kNumEvents];
+    uint64_t start_[kNumEvents];
+    uint64_t delta_[kNumEvents];
+};
+
+} // namespace bench
+
+#endif // LOCKFREE_PERF_COUNTERS_HPP
@@ -1,5 +1,8 @@
 #include <benchmark/benchmark.h>
 #include "../include/lockfree/queue.hpp"
+#include "bench_util.hpp"
+#include "perf_counters.hpp"
+#include <chrono>
 #include <queue>
 #include <mutex>
 #include <atomic>
@@ -9,18 +12,24 @@
 // Single-threaded benchmarks
 static void BM_LockfreeQueue_Throughput(benchmark::State& state) {
     lockfree::Queue<int> queue;
+    bench::PerfCounters perf;
+    perf.start();
     for (auto _ : state) {
         queue.push(1);
         int val;
         queue.pop(val);
     }
+    perf.stop();
     state.SetItemsProcessed(state.iterations());
+    perf.report(state, state.iterations());
 }
 BENCHMARK(BM_LockfreeQueue_Throughput);
 
 static void BM_MutexQueue_Throughput(benchmark::State& state) {
     std::queue<int> queue;
     std::mutex mtx;
+    bench::PerfCounters perf;
+    perf.start();
     for (auto _ : state) {
         {
             std::lock_guard<std::mutex> lock(mtx);
@@ -33,107 +42,50 @@ static void BM_MutexQueue_Throughput(benchmark::State& state) {
             }
         }
     }
+    perf.stop();
     state.SetItemsProcessed(state.iterations());
+    perf.report(state, state.iterations());
 }
 BENCHMARK(BM_MutexQueue_Throughput);
 
-// Multi-threaded benchmarks
+// Multi-threaded benchmarks: every benchmark thread alternates push and
+// pop on one shared queue inside the timed loop.
 static void BM_LockfreeQueue_Contention(benchmark::State& state) {
-    lockfree::Queue<int> queue;
-    std::atomic<bool> running{true};
-    std::atomic<int> total_ops{0};
-
-    // Producer thread
-    auto producer = [&] {
-        while (running) {
-            queue.push(1);
-            total_ops.fetch_add(1, std::memory_order_relaxed);
-        }
-    };
-
-    // Consumer thread
-    auto consumer = [&] {
-        int val;
-        while (running) {
-            if (queue.pop(val)) {
-                total_ops.fetch_add(1, std::memory_order_relaxed);
-            }
-        }
-    };
-
-    // Start threads
-    std::vector<std::thread> threads;
-    threads.emplace_back(producer);
-    threads.emplace_back(consumer);
-
-    // Run benchmark
+    static lockfree::Queue<int> queue;
+    int val;
+    bench::PerfCounters perf;
+    perf.start();
     for (auto _ : state) {
-        benchmark::DoNotOptimize(total_ops.load());
-    }
-
-    // Cleanup
-    running = false;
-    for (auto& t : threads) {
-        t.join();
+        queue.push(1);
+        benchmark::DoNotOptimize(queue.pop(val));
     }
-
-    state.SetItemsProcessed(total_ops.load());
+    perf.stop();
+    state.SetItemsProcessed(state.iterations() * 2);
+    perf.report(state, state.iterations() * 2);
 }
-BENCHMARK(BM_LockfreeQueue_Contention)->Threads(2);
+BENCHMARK(BM_LockfreeQueue_Contention)->ThreadRange(1, 32)->UseRealTime();
 
 static void BM_MutexQueue_Contention(benchmark::State& state) {
-    std::queue<int> queue;
-    std::mutex mtx;
-    std::atomic<bool> running{true};
-    std::atomic<int> total_ops{0};
-
-    // Producer thread
-    auto producer = [&] {
-        while (running) {
-            {
-                std::lock_guard<std::mutex> lock(mtx);
-                queue.push(1);
-            }
-            total_ops.fetch_add(1, std::memory_order_relaxed);
-        }
-    };
-
-    // Consumer thread
-    auto consumer = [&] {
-        while (running) {
-            {
-                std::lock_guard<std::mutex> lock(mtx);
-                if (!queue.empty()) {
-                    queue.pop();
-                    total_ops.fetch_add(1, std::memory_order_relaxed);
-                }
-            }
-        }
-    };
-
-    // Start threads
-    std::vector<std::thread> threads;
-    threads.emplace_back(producer);
-    threads.emplace_back(consumer);
-
-    // Run benchmark
+    static bench::MutexQueue<int> queue;
+    int val;
+    bench::PerfCounters perf;
+    perf.start();
     for (auto _ : state) {
-        benchmark::DoNotOptimize(total_ops.load());
-    }
-
-    // Cleanup
-    running = false;
-    for (auto& t : threads) {
-        t.join();
+        queue.push(1);
+        benchmark::DoNotOptimize(queue.pop(val));
     }
-
-    state.SetItemsProcessed(total_ops.load());
+    perf.stop();
+    state.SetItemsProcessed(state.iterations() * 2);
+    perf.report(state, state.iterations() * 2);
 }
-BENCHMARK(BM_MutexQueue_Contention)->Threads(2);
+BENCHMARK(BM_MutexQueue_Contention)->ThreadRange(1, 32)->UseRealTime();
 
 // Latency benchmarks
 static void BM_LockfreeQueue_Latency(benchmark::State& state) {
     lockfree::Queue<int> queue;
+    bench::LatencyRecorder latencies;
+    bench::PerfCounters perf;
+    perf.start();
     for (auto _ : state) {
         auto start = std::chrono::high_resolution_clock::now();
         queue.push(1);
@@ -142,7 +94,11 @@ static void BM_LockfreeQueue_Latency(benchmark::State& state) {
         auto end = std::chrono::high_resolution_clock::now();
         auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
         state.SetIterationTime(elapsed.count() / 1e9);
+        latencies.record(elapsed.count());
     }
+    perf.stop();
+    latencies.report(state);
+    perf.report(state, state.iterations());
 }
 BENCHMARK(BM_LockfreeQueue_Latency)->UseManualTime();
 
@@ -1,103 +1,271 @@
 #include <benchmark/benchmark.h>
+#include "../include/lockfree/broadcast_ring.hpp"
 #include "../include/lockfree/queue.hpp"
-#include <queue>
-#include <mutex>
+#include "../include/lockfree/sharded_queue.hpp"
+#include "../include/lockfree/stack.hpp"
+#include "bench_util.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <thread>
 #include <vector>
-#include <atomic>
 
-// Producer-consumer throughput benchmarks
-static void BM_LockfreeQueue_ProducerConsumer(benchmark::State& state) {
-    lockfree::Queue<int> queue;
-    const int producers = state.range(0);
-    const int consumers = state.range(1);
-    const int ops_per_thread = 100000;
-    std::atomic<bool> running{true};
-    std::atomic<int> total_ops{0};
-
-    // Producer threads
-    std::vector<std::thread> producer_threads;
-    for (int i = 0; i < producers; ++i) {
-        producer_threads.emplace_back([&] {
-            for (int j = 0; j < ops_per_thread && running; ++j) {
-                queue.push(j);
-                total_ops.fetch_add(1, std::memory_order_relaxed);
-            }
-        });
+using bench::MutexQueue;
+using bench::Payload;
+
+// How consumers take items: poll pop() and yield when empty, or block
+// in pop_wait_for() (lockfree::Queue only). The timeout bounds how long
+// a consumer stays parked after the last item has gone.
+struct SpinPop {
+    template <typename Q, typename P>
+    bool operator()(Q& queue, P& val) const {
+        if (queue.pop(val)) {
+            return true;
+        }
+        std::this_thread::yield();
+        return false;
     }
+};
 
-    // Consumer threads
-    std::vector<std::thread> consumer_threads;
-    for (int i = 0; i < consumers; ++i) {
-        consumer_threads.emplace_back([&] {
-            int val;
-            while (running) {
-                if (queue.pop(val)) {
-                    total_ops.fetch_add(1, std::memory_order_relaxed);
-                }
-            }
-        });
+struct BlockingPop {
+    template <typename Q, typename P>
+    bool operator()(Q& queue, P& val) const {
+        return queue.pop_wait_for(val, std::chrono::milliseconds(1));
     }
+};
+
+// P producers push a fixed batch and C consumers drain it. Thread start,
+// the full handoff and join all run inside the timed loop, so every
+// configuration moves the same number of items per iteration.
+template <typename Q, typename P, typename Pop = SpinPop>
+static void run_producer_consumer(benchmark::State& state, Q& queue,
+                                  Pop pop = Pop()) {
+    const int producers = state.range(0);
+    const int consumers = state.range(1);
+    const int items_per_producer = 1 << 14;
+    const long total = static_cast<long>(producers) * items_per_producer;
 
-    // Run benchmark
     for (auto _ : state) {
-        benchmark::DoNotOptimize(total_ops.load());
+        std::atomic<long> consumed{0};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < producers; ++i) {
+            threads.emplace_back([&] {
+                for (int j = 0; j < items_per_producer; ++j) {
+                    queue.push(P(static_cast<uint64_t>(j)));
+                }
+            });
+        }
+        for (int i = 0; i < consumers; ++i) {
+            threads.emplace_back([&] {
+                P val;
+                while (consumed.load(std::memory_order_relaxed) < total) {
+                    if (pop(queue, val)) {
+                        consumed.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
     }
 
-    // Cleanup
-    running = false;
-    for (auto& t : producer_threads) t.join();
-    for (auto& t : consumer_threads) t.join();
+    state.SetItemsProcessed(state.iterations() * total);
+    state.SetBytesProcessed(state.iterations() * total * sizeof(P));
+}
 
-    state.SetItemsProcessed(total_ops.load());
+// Thread count sweep with a small payload
+template <typename P>
+static void BM_LockfreeQueue_ProducerConsumer(benchmark::State& state) {
+    lockfree::Queue<P> queue;
+    run_producer_consumer<lockfree::Queue<P>, P>(state, queue);
 }
-BENCHMARK(BM_LockfreeQueue_ProducerConsumer)
-    ->Args({1, 1})->Args({2, 2})->Args({4, 4})->Args({8, 8})
-    ->Args({1, 4})->Args({4, 1}); // Different producer/consumer ratios
 
-// Latency under contention
-static void BM_LockfreeQueue_Latency(benchmark::State& state) {
-    lockfree::Queue<int> queue;
-    const int num_threads = state.range(0);
-    std::atomic<bool> running{true};
-    std::atomic<int> ready_threads{0};
-    std::vector<double> latencies;
-
-    // Worker threads
-    std::vector<std::thread> threads;
-    for (int i = 0; i < num_threads; ++i) {
-        threads.emplace_back([&] {
-            ready_threads++;
-            while (ready_threads < num_threads) {} // Sync start
-            
-            for (int j = 0; j < 10000 && running; ++j) {
-                auto start = std::chrono::high_resolution_clock::now();
-                queue.push(j);
-                int val;
-                queue.pop(val);
-                auto end = std::chrono::high_resolution_clock::now();
-                
-                std::chrono::duration<double> elapsed = end - start;
-                latencies.push_back(elapsed.count());
-            }
-        });
+// Consumers park in pop_wait_for() instead of spinning on pop().
+template <typename P>
+static void BM_LockfreeQueue_BlockingConsumer(benchmark::State& state) {
+    lockfree::Queue<P> queue;
+    run_producer_consumer<lockfree::Queue<P>, P>(state, queue, BlockingPop());
+}
+
+template <typename P>
+static void BM_ShardedQueue_Relaxed_ProducerConsumer(benchmark::State& state) {
+    lockfree::ShardedQueue<P> queue(state.range(0),
+                                    lockfree::ShardOrder::Relaxed);
+    run_producer_consumer<lockfree::ShardedQueue<P>, P>(state, queue);
+}
+
+template <typename P>
+static void BM_ShardedQueue_Strict_ProducerConsumer(benchmark::State& state) {
+    lockfree::ShardedQueue<P> queue(state.range(0),
+                                    lockfree::ShardOrder::Strict);
+    run_producer_consumer<lockfree::ShardedQueue<P>, P>(state, queue);
+}
+
+// Consumer-heavy mix where head_ CAS retries dominate, per backoff
+// policy (arg 2): 0 yield_only, 1 fixed spin, 2 adaptive.
+template <typename P>
+static void BM_LockfreeQueue_Backoff(benchmark::State& state) {
+    lockfree::BackoffPolicy policy;
+    if (state.range(2) == 0) {
+        policy = lockfree::BackoffPolicy::yield_only();
+    } else if (state.range(2) == 1) {
+        policy.adaptive = false;
     }
+    lockfree::Queue<P> queue(policy);
+    run_producer_consumer<lockfree::Queue<P>, P>(state, queue);
+}
+
+// LIFO: no ordering guarantees to pay for, and contended pairs can
+// meet in the elimination slots instead of on head_.
+template <typename P>
+static void BM_LockfreeStack_ProducerConsumer(benchmark::State& state) {
+    lockfree::Stack<P> stack;
+    run_producer_consumer<lockfree::Stack<P>, P>(state, stack);
+}
+
+template <typename P>
+static void BM_MutexQueue_ProducerConsumer(benchmark::State& state) {
+    MutexQueue<P> queue;
+    run_producer_consumer<MutexQueue<P>, P>(state, queue);
+}
+
+#define THREAD_SWEEP \
+    ->Args({1, 1})->Args({2, 2})->Args({4, 4})->Args({8, 8}) \
+    ->Args({16, 16})->Args({32, 32}) \
+    ->Args({1, 4})->Args({4, 1})->UseRealTime()
+
+BENCHMARK_TEMPLATE(BM_LockfreeQueue_ProducerConsumer, Payload<16>) THREAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_LockfreeQueue_BlockingConsumer, Payload<16>) THREAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_ShardedQueue_Relaxed_ProducerConsumer, Payload<16>) THREAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_ShardedQueue_Strict_ProducerConsumer, Payload<16>) THREAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_LockfreeStack_ProducerConsumer, Payload<16>) THREAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_MutexQueue_ProducerConsumer, Payload<16>) THREAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_LockfreeQueue_Backoff, Payload<16>)
+    ->ArgNames({"producers", "consumers", "policy"})
+    ->Args({2, 8, 0})->Args({2, 8, 1})->Args({2, 8, 2})
+    ->Args({8, 8, 0})->Args({8, 8, 1})->Args({8, 8, 2})->UseRealTime();
+
+// Payload size sweep at a fixed 4x4 mix
+#define PAYLOAD_SWEEP ->Args({4, 4})->UseRealTime()
+
+BENCHMARK_TEMPLATE(BM_LockfreeQueue_ProducerConsumer, Payload<64>) PAYLOAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_LockfreeQueue_ProducerConsumer, Payload<256>) PAYLOAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_ShardedQueue_Relaxed_ProducerConsumer, Payload<64>) PAYLOAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_ShardedQueue_Relaxed_ProducerConsumer, Payload<256>) PAYLOAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_MutexQueue_ProducerConsumer, Payload<64>) PAYLOAD_SWEEP;
+BENCHMARK_TEMPLATE(BM_MutexQueue_ProducerConsumer, Payload<256>) PAYLOAD_SWEEP;
+
+// Handoff latency: producers stamp each message, a single consumer
+// records enqueue-to-dequeue time. Reported as p50/p99/p99.9.
+template <typename Q>
+static void run_handoff_latency(benchmark::State& state, Q& queue) {
+    const int producers = state.range(0);
+    const int items_per_producer = 4096;
+    const long total = static_cast<long>(producers) * items_per_producer;
+    bench::LatencyRecorder latencies;
+    latencies.reserve(total * 16);
 
-    // Run benchmark
     for (auto _ : state) {
-        benchmark::DoNotOptimize(latencies.size());
+        std::vector<std::thread> threads;
+        for (int i = 0; i < producers; ++i) {
+            threads.emplace_back([&] {
+                for (int j = 0; j < items_per_producer; ++j) {
+                    queue.push(Payload<16>(bench::now_ns()));
+                }
+            });
+        }
+        Payload<16> msg;
+        for (long received = 0; received < total;) {
+            if (queue.pop(msg)) {
+                latencies.record(bench::now_ns() - msg.stamp);
+                ++received;
+            }
+        }
+        for (auto& t : threads) t.join();
     }
 
-    // Cleanup
-    running = false;
-    for (auto& t : threads) t.join();
+    state.SetItemsProcessed(state.iterations() * total);
+    latencies.report(state);
+}
 
-    // Calculate statistics
-    double sum = 0;
-    for (double l : latencies) sum += l;
-    state.counters["avg_latency_ns"] = (sum / latencies.size()) * 1e9;
+static void BM_LockfreeQueue_Latency(benchmark::State& state) {
+    lockfree::Queue<Payload<16>> queue;
+    run_handoff_latency(state, queue);
 }
 BENCHMARK(BM_LockfreeQueue_Latency)
-    ->Arg(2)->Arg(4)->Arg(8)->Arg(16);
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->UseRealTime();
+
+static void BM_MutexQueue_Latency(benchmark::State& state) {
+    MutexQueue<Payload<16>> queue;
+    run_handoff_latency(state, queue);
+}
+BENCHMARK(BM_MutexQueue_Latency)
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->UseRealTime();
+
+// One-to-N fan-out of 64-byte messages: a copy into each subscriber's
+// Queue (one node allocation and move per subscriber) against a single
+// write into a BroadcastRing that every subscriber reads in place.
+static const int kFanoutMessages = 1 << 14;
+
+static void BM_QueueFanout(benchmark::State& state) {
+    const int subscribers = state.range(0);
+    for (auto _ : state) {
+        std::vector<std::unique_ptr<lockfree::Queue<Payload<64>>>> queues;
+        for (int i = 0; i < subscribers; ++i) {
+            queues.emplace_back(new lockfree::Queue<Payload<64>>);
+        }
+        std::vector<std::thread> readers;
+        for (int i = 0; i < subscribers; ++i) {
+            readers.emplace_back([&, i] {
+                Payload<64> msg;
+                for (int received = 0; received < kFanoutMessages;) {
+                    if (queues[i]->pop(msg)) {
+                        benchmark::DoNotOptimize(msg.stamp);
+                        ++received;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (int m = 0; m < kFanoutMessages; ++m) {
+            Payload<64> msg(static_cast<uint64_t>(m));
+            for (auto& q : queues) {
+                q->push(msg);
+            }
+        }
+        for (auto& t : readers) t.join();
+    }
+    state.SetItemsProcessed(state.iterations() * kFanoutMessages);
+}
+BENCHMARK(BM_QueueFanout)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+static void BM_BroadcastRing_Fanout(benchmark::State& state) {
+    const int subscribers = state.range(0);
+    for (auto _ : state) {
+        lockfree::BroadcastRing<Payload<64>> ring(1024);
+        std::vector<lockfree::BroadcastRing<Payload<64>>::Subscriber> subs;
+        for (int i = 0; i < subscribers; ++i) {
+            subs.push_back(ring.subscribe());
+        }
+        std::vector<std::thread> readers;
+        for (int i = 0; i < subscribers; ++i) {
+            readers.emplace_back([&, i] {
+                while (subs[i].wait_batch([](const Payload<64>& msg) {
+                    benchmark::DoNotOptimize(msg.stamp);
+                })) {
+                }
+            });
+        }
+        for (int m = 0; m < kFanoutMessages; ++m) {
+            ring.publish_with([m](Payload<64>& slot) {
+                slot.stamp = static_cast<uint64_t>(m);
+            });
+        }
+        ring.close();
+        for (auto& t : readers) t.join();
+    }
+    state.SetItemsProcessed(state.iterations() * kFanoutMessages);
+}
+BENCHMARK(BM_BroadcastRing_Fanout)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
 
 BENCHMARK_MAIN();
@@ -1,138 +1,111 @@
 #include <benchmark/benchmark.h>
+#include "../include/lockfree/arena.hpp"
+#include "../include/lockfree/async_io.hpp"
+#include "../include/lockfree/pipeline.hpp"
+#include "../include/lockfree/task_arena.hpp"
+#include "../include/lockfree/task_group.hpp"
 #include "../include/lockfree/thread_pool.hpp"
+#include "bench_util.hpp"
+#include "perf_counters.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
 #include <vector>
 #include <future>
 #include <memory>
 #include <thread>
 #include <chrono>
-#include <numeric>
+#include <string>
+#include <unistd.h>
 
-// Throughput benchmarks
-static void BM_ThreadPool_Throughput(benchmark::State& state) {
-    const int num_threads = state.range(0);
-    const int tasks_per_thread = 100;  // Further reduced to 100 tasks per thread
-    lockfree::ThreadPool pool(num_threads);
-    
-    const auto test_start = std::chrono::steady_clock::now();
-        for (auto _ : state) {
-            // Check for timeout (5 seconds max)
-            if (std::chrono::steady_clock::now() - test_start > std::chrono::seconds(5)) {
-                state.SkipWithError("Test timeout");
-                break;
-            }
+// Counts global heap allocations so benchmarks can report allocs/op.
+static std::atomic<uint64_t> g_heap_allocs(0);
 
-            if (!pool.running()) {
-                state.SkipWithError("ThreadPool is not running");
-                break;
-            }
+void* operator new(size_t size) {
+    g_heap_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
 
-            std::vector<std::future<int>> futures;
-            futures.reserve(num_threads * tasks_per_thread);
-            
-            try {
-                for (int i = 0; i < num_threads * tasks_per_thread; ++i) {
-                    if (!pool.running()) {
-                        state.SkipWithError("ThreadPool shutdown during submission");
-                        break;
-                    }
-                    
-                    if (std::chrono::steady_clock::now() - test_start > std::chrono::seconds(5)) {
-                        state.SkipWithError("Test timeout during submission");
-                        break;
-                    }
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
 
-                    futures.push_back(pool.submit([i]{
-                        return i; // Simple task
-                    }));
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
 
-                    // Additional check after each submission
-                    if (!pool.running()) {
-                        state.SkipWithError("ThreadPool shutdown during submission");
-                        break;
-                    }
-                }
+// Throughput benchmarks
+static void BM_ThreadPool_Throughput(benchmark::State& state) {
+    const int num_threads = state.range(0);
+    const int tasks_per_thread = 100;
+    bench::PerfCounters perf;  // before the pool so workers inherit it
+    lockfree::ThreadPool pool(num_threads);
+    std::vector<std::future<int>> futures;
+    futures.reserve(num_threads * tasks_per_thread);
 
-                // Final check after submission loop
-                if (!pool.running()) {
-                    state.SkipWithError("ThreadPool shutdown after submission");
-                    break;
-                }
-            } catch (const std::exception& e) {
-                state.SkipWithError("Exception during submission");
-                break;
-            }
-        
-        // Add global timeout check before processing futures
-        if (std::chrono::steady_clock::now() - test_start > std::chrono::seconds(5)) {
-            state.SkipWithError("Global test timeout reached");
-            break;
+    perf.start();
+    for (auto _ : state) {
+        futures.clear();
+        for (int i = 0; i < num_threads * tasks_per_thread; ++i) {
+            futures.push_back(pool.submit([i]{
+                return i; // Simple task
+            }));
         }
-
         for (auto& f : futures) {
-            if (!pool.running()) {
-                state.SkipWithError("ThreadPool shutdown during wait");
-                break;
-            }
-            if (std::chrono::steady_clock::now() - test_start > std::chrono::seconds(5)) {
-                state.SkipWithError("Test timeout during wait");
-                break;
-            }
-            try {
-                f.get();
-            } catch (const std::future_error& e) {
-                state.SkipWithError("Task execution failed");
-                break;
-            }
-        }
-
-        // Final check after processing futures
-        if (!pool.running()) {
-            state.SkipWithError("ThreadPool shutdown after processing");
-            break;
+            benchmark::DoNotOptimize(f.get());
         }
-        
-        pool.wait();
     }
+    perf.stop();
     
     state.SetItemsProcessed(state.iterations() * num_threads * tasks_per_thread);
+    perf.report(state, state.iterations() * num_threads * tasks_per_thread);
 }
 BENCHMARK(BM_ThreadPool_Throughput)
-    ->Arg(2)->Arg(4)->Arg(8)->Arg(16);
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->Arg(32)->UseRealTime();
 
-// Latency benchmarks
+// Latency benchmarks: submit-to-completion round trip per task
 static void BM_ThreadPool_Latency(benchmark::State& state) {
+    bench::PerfCounters perf;  // before the pool so workers inherit it
     lockfree::ThreadPool pool(state.range(0));
     const int tasks = 1000;
-    std::vector<double> latencies;
+    bench::LatencyRecorder latencies;
     latencies.reserve(tasks);
 
+    perf.start();
     for (auto _ : state) {
         for (int i = 0; i < tasks; ++i) {
-            auto start = std::chrono::high_resolution_clock::now();
-            auto future = pool.submit([&] {
+            uint64_t start = bench::now_ns();
+            auto future = pool.submit([] {
                 return 0; // Simple task
             });
             future.get();
-            auto end = std::chrono::high_resolution_clock::now();
-            
-            std::chrono::duration<double> elapsed = end - start;
-            latencies.push_back(elapsed.count());
+            latencies.record(bench::now_ns() - start);
         }
     }
+    perf.stop();
 
-    // Calculate average latency
-    double sum = std::accumulate(latencies.begin(), latencies.end(), 0.0);
-    state.counters["avg_latency_ns"] = (sum / latencies.size()) * 1e9;
+    state.SetItemsProcessed(state.iterations() * tasks);
+    perf.report(state, state.iterations() * tasks);
+    latencies.report(state);
 }
 BENCHMARK(BM_ThreadPool_Latency)
-    ->Arg(2)->Arg(4)->Arg(8)->Arg(16);
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->UseRealTime();
 
 // Workload complexity benchmarks
 static void BM_ThreadPool_Workload(benchmark::State& state) {
+    bench::PerfCounters perf;  // before the pool so workers inherit it
     lockfree::ThreadPool pool(state.range(0));
     const int tasks = 1000;
     const int workload = state.range(1); // Workload complexity factor
 
+    perf.start();
     for (auto _ : state) {
         std::vector<std::future<int>> futures;
         futures.reserve(tasks);
@@ -152,8 +125,10 @@ static void BM_ThreadPool_Workload(benchmark::State& state) {
             f.get();
         }
     }
+    perf.stop();
 
     state.SetItemsProcessed(state.iterations() * tasks);
+    perf.report(state, state.iterations() * tasks);
 }
 BENCHMARK(BM_ThreadPool_Workload)
     ->Args({2, 1})->Args({2, 10})->Args({2, 100})  // Varying workloads
@@ -165,6 +140,8 @@ static void BM_StdThread_Throughput(benchmark::State& state) {
     const int num_threads = state.range(0);
     const int tasks_per_thread = 10000;
     
+    bench::PerfCounters perf;
+    perf.start();
     for (auto _ : state) {
         std::vector<std::thread> threads;
         for (int i = 0; i < num_threads; ++i) {
@@ -179,18 +156,22 @@ static void BM_StdThread_Throughput(benchmark::State& state) {
             t.join();
         }
     }
+    perf.stop();
     
     state.SetItemsProcessed(state.iterations() * num_threads * tasks_per_thread);
+    perf.report(state, state.iterations() * num_threads * tasks_per_thread);
 }
 BENCHMARK(BM_StdThread_Throughput)
     ->Arg(2)->Arg(4)->Arg(8)->Arg(16);
 
 // Task stealing efficiency benchmark
 static void BM_ThreadPool_StealEfficiency(benchmark::State& state) {
+    bench::PerfCounters perf;  // before the pool so workers inherit it
     lockfree::ThreadPool pool(state.range(0));
     const int tasks = state.range(1);
     
     // Create unbalanced workload
+    perf.start();
     for (auto _ : state) {
         // Submit most tasks to first worker
         for (int i = 0; i < tasks * 0.8; ++i) {
@@ -208,19 +189,61 @@ static void BM_ThreadPool_StealEfficiency(benchmark::State& state) {
         
         pool.wait();
     }
+    perf.stop();
     
     state.SetItemsProcessed(state.iterations() * tasks);
+    perf.report(state, state.iterations() * tasks);
 }
 BENCHMARK(BM_ThreadPool_StealEfficiency)
     ->Args({4, 1000})->Args({8, 2000})->Args({16, 4000});
 
+// Skewed load: a seed task spawns every task from inside one worker, so
+// they all start in that worker's local queue and must be stolen.
+static void BM_ThreadPool_SkewedLoad(benchmark::State& state) {
+    bench::PerfCounters perf;  // before the pool so workers inherit it
+    lockfree::ThreadPool pool(state.range(0));
+    const int tasks = state.range(1);
+    const size_t stolen_before = pool.tasks_stolen();
+    const size_t attempts_before = pool.steal_attempts();
+
+    perf.start();
+    for (auto _ : state) {
+        pool.submit([&pool, tasks] {
+            for (int i = 0; i < tasks; ++i) {
+                pool.submit([] {
+                    volatile int result = 0;
+                    for (int j = 0; j < 2000; ++j) {
+                        result += j % 10;
+                    }
+                });
+            }
+        }).get();
+        pool.wait();
+    }
+    perf.stop();
+
+    state.SetItemsProcessed(state.iterations() * tasks);
+    perf.report(state, state.iterations() * tasks);
+    state.counters["stolen_per_iter"] = benchmark::Counter(
+        static_cast<double>(pool.tasks_stolen() - stolen_before),
+        benchmark::Counter::kAvgIterations);
+    state.counters["steal_attempts_per_iter"] = benchmark::Counter(
+        static_cast<double>(pool.steal_attempts() - attempts_before),
+        benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ThreadPool_SkewedLoad)
+    ->Args({4, 1000})->Args({8, 2000})->Args({16, 4000})
+    ->UseRealTime();
+
 // Dynamic thread adjustment test
 static void BM_ThreadPool_DynamicThreads(benchmark::State& state) {
+    bench::PerfCounters perf;  // before the pool so workers inherit it
     lockfree::ThreadPool pool(2); // Start with 2 threads
     
     const int tasks = 1000;
     const int workload = 100;
     
+    perf.start();
     for (auto _ : state) {
         // Phase 1: Light workload
         for (int i = 0; i < tasks; ++i) {
@@ -244,18 +267,22 @@ static void BM_ThreadPool_DynamicThreads(benchmark::State& state) {
         }
         pool.wait();
     }
+    perf.stop();
     
     state.SetItemsProcessed(state.iterations() * tasks * 2);
+    perf.report(state, state.iterations() * tasks * 2);
 }
 BENCHMARK(BM_ThreadPool_DynamicThreads);
 
 // Mixed workload benchmark
 static void BM_ThreadPool_MixedWorkload(benchmark::State& state) {
+    bench::PerfCounters perf;  // before the pool so workers inherit it
     lockfree::ThreadPool pool(state.range(0));
     const int tasks = state.range(1);
     const int light_work = 10;
     const int heavy_work = 1000;
     
+    perf.start();
     for (auto _ : state) {
         std::vector<std::future<void>> futures;
         futures.reserve(tasks);
@@ -283,10 +310,494 @@ static void BM_ThreadPool_MixedWorkload(benchmark::State& state) {
             f.get();
         }
     }
+    perf.stop();
     
     state.SetItemsProcessed(state.iterations() * tasks);
+    perf.report(state, state.iterations() * tasks);
 }
 BENCHMARK(BM_ThreadPool_MixedWorkload)
     ->Args({4, 1000})->Args({8, 2000})->Args({16, 4000});
 
+// Closure too large for Task's inline storage, submitted through the
+// default heap path (arg 0) or the thread-local arena (arg 1).
+static void BM_ThreadPool_SubmitLargeClosure(benchmark::State& state) {
+    const bool use_arena = state.range(0) != 0;
+    const int tasks = 1000;
+    lockfree::ThreadPool pool(4);
+    std::vector<std::future<int>> futures;
+    futures.reserve(tasks);
+    std::array<int, 32> payload;
+    payload.fill(1);
+
+    const uint64_t allocs_before = g_heap_allocs.load();
+    for (auto _ : state) {
+        futures.clear();
+        for (int i = 0; i < tasks; ++i) {
+            auto body = [payload, i]() { return payload[i % 32] + i; };
+            if (use_arena) {
+                futures.push_back(pool.submit(
+                    std::allocator_arg, lockfree::ArenaAllocator<char>(),
+                    body));
+            } else {
+                futures.push_back(pool.submit(body));
+            }
+        }
+        for (auto& f : futures) {
+            benchmark::DoNotOptimize(f.get());
+        }
+    }
+    const uint64_t ops = state.iterations() * tasks;
+    state.SetItemsProcessed(ops);
+    state.counters["allocs/op"] = static_cast<double>(
+        g_heap_allocs.load() - allocs_before) / ops;
+}
+BENCHMARK(BM_ThreadPool_SubmitLargeClosure)
+    ->ArgName("arena")->Arg(0)->Arg(1)->UseRealTime();
+
+// Producer/consumer chains: each task fills a 16 KB buffer and spawns
+// the task that consumes it. In LIFO mode (arg 1) the consumer runs next
+// on the same worker while the buffer is still in L1/L2.
+static void BM_ThreadPool_SpawnLocality(benchmark::State& state) {
+    const lockfree::SchedulingMode mode = state.range(0)
+        ? lockfree::SchedulingMode::Lifo : lockfree::SchedulingMode::Fifo;
+    const int chains = 256;
+    const size_t kWords = 16 * 1024 / sizeof(uint64_t);
+    bench::PerfCounters perf;  // before the pool so workers inherit it
+    lockfree::ThreadPool pool(4, mode);
+    std::atomic<uint64_t> sink(0);
+    std::atomic<int> consumed(0);
+
+    perf.start();
+    for (auto _ : state) {
+        consumed.store(0, std::memory_order_relaxed);
+        pool.post([&pool, &sink, &consumed, kWords] {
+            for (int c = 0; c < chains; ++c) {
+                pool.post([&pool, &sink, &consumed, kWords, c] {
+                    std::shared_ptr<std::vector<uint64_t>> data =
+                        std::make_shared<std::vector<uint64_t>>(kWords);
+                    for (size_t i = 0; i < kWords; ++i) {
+                        (*data)[i] = i * c;
+                    }
+                    pool.post([data, &sink, &consumed] {
+                        uint64_t sum = 0;
+                        for (uint64_t v : *data) {
+                            sum += v;
+                        }
+                        sink.fetch_add(sum, std::memory_order_relaxed);
+                        consumed.fetch_add(1, std::memory_order_release);
+                    });
+                });
+            }
+        });
+        while (consumed.load(std::memory_order_acquire) < chains) {
+            std::this_thread::yield();
+        }
+    }
+    perf.stop();
+
+    state.SetItemsProcessed(state.iterations() * chains * 2);
+    perf.report(state, state.iterations() * chains * 2);
+}
+BENCHMARK(BM_ThreadPool_SpawnLocality)
+    ->ArgName("lifo")->Arg(0)->Arg(1)->UseRealTime();
+
+// False sharing in isolation: every thread bumps its own counter with
+// the single-writer load/store the pool's per-worker shards use. Only
+// the layout differs: packed puts all counters on one cache line,
+// padded gives each thread a line.
+namespace {
+
+const int kMaxCounterThreads = 16;
+
+struct PackedCounters {
+    std::atomic<uint64_t> value[kMaxCounterThreads];
+};
+
+struct PaddedCounters {
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> value;
+    };
+    Slot slot[kMaxCounterThreads];
+};
+
+} // namespace
+
+static void BM_Counters_Packed(benchmark::State& state) {
+    static PackedCounters counters;
+    std::atomic<uint64_t>& mine = counters.value[state.thread_index()];
+    for (auto _ : state) {
+        mine.store(mine.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Counters_Packed)->ThreadRange(1, kMaxCounterThreads)->UseRealTime();
+
+static void BM_Counters_Padded(benchmark::State& state) {
+    static PaddedCounters counters;
+    std::atomic<uint64_t>& mine = counters.slot[state.thread_index()].value;
+    for (auto _ : state) {
+        mine.store(mine.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Counters_Padded)->ThreadRange(1, kMaxCounterThreads)->UseRealTime();
+
+// The same effect inside the pool: empty tasks spawned by the workers
+// themselves, so the per-task bookkeeping dominates. Arg: worker count.
+static void BM_ThreadPool_TinyTasks(benchmark::State& state) {
+    const int workers = state.range(0);
+    const int per_worker = (1 << 14) / workers;
+    const int kTasks = per_worker * workers;
+    bench::PerfCounters perf;  // before the pool so workers inherit it
+    lockfree::ThreadPool pool(workers);
+
+    perf.start();
+    for (auto _ : state) {
+        for (int w = 0; w < workers; ++w) {
+            pool.post([&pool, per_worker] {
+                for (int i = 0; i < per_worker; ++i) {
+                    pool.post([] {});
+                }
+            });
+        }
+        // wait() sleeps in 10 ms steps; poll instead.
+        while (pool.active_tasks() != 0) {
+            std::this_thread::yield();
+        }
+    }
+    perf.stop();
+
+    state.SetItemsProcessed(state.iterations() * kTasks);
+    perf.report(state, state.iterations() * kTasks);
+}
+BENCHMARK(BM_ThreadPool_TinyTasks)
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+// Fork-join recursion with TaskGroup. Arg: worker count, 0 for the
+// serial baseline (plain recursion, std::sort). allocs/op is per run and
+// comes from submit()'s future; the spawns themselves allocate nothing.
+namespace {
+
+long serial_fib(int n) {
+    return n < 2 ? n : serial_fib(n - 1) + serial_fib(n - 2);
+}
+
+long group_fib(lockfree::ThreadPool& pool, int n) {
+    if (n < 20) {
+        return serial_fib(n);
+    }
+    long a = 0;
+    lockfree::TaskGroup group(pool);
+    group.spawn([&pool, &a, n] { a = group_fib(pool, n - 1); });
+    const long b = group_fib(pool, n - 2);
+    group.sync();
+    return a + b;
+}
+
+// Spawns below 20 are cut off, so this is the number of spawns.
+long fib_spawns(int n) {
+    return n < 20 ? 0 : 1 + fib_spawns(n - 1) + fib_spawns(n - 2);
+}
+
+const ptrdiff_t kSortCutoff = 2048;
+
+void group_sort(lockfree::ThreadPool* pool, int* first, int* last) {
+    if (!pool || last - first <= kSortCutoff) {
+        std::sort(first, last);
+        return;
+    }
+    const int pivot = first[(last - first) / 2];
+    int* mid1 = std::partition(first, last,
+                               [pivot](int v) { return v < pivot; });
+    int* mid2 = std::partition(mid1, last,
+                               [pivot](int v) { return !(pivot < v); });
+    lockfree::TaskGroup group(*pool);
+    group.spawn([pool, first, mid1] { group_sort(pool, first, mid1); });
+    group_sort(pool, mid2, last);
+    group.sync();
+}
+
+} // namespace
+
+static void BM_TaskGroup_Fib(benchmark::State& state) {
+    const int n = 32;
+    const int workers = static_cast<int>(state.range(0));
+    lockfree::ThreadPool pool(workers ? workers : 1);
+    lockfree::ThreadPool* p = workers ? &pool : nullptr;
+    long result = 0;
+    const uint64_t allocs_before = g_heap_allocs.load();
+    for (auto _ : state) {
+        if (p) {
+            result = p->submit([p, n] { return group_fib(*p, n); }).get();
+        } else {
+            result = serial_fib(n);
+        }
+    }
+    benchmark::DoNotOptimize(result);
+    const uint64_t spawns = state.iterations() * fib_spawns(n);
+    state.counters["spawns/s"] = benchmark::Counter(
+        workers ? static_cast<double>(spawns) : 0, benchmark::Counter::kIsRate);
+    state.counters["allocs/op"] = static_cast<double>(
+        g_heap_allocs.load() - allocs_before) / state.iterations();
+}
+BENCHMARK(BM_TaskGroup_Fib)
+    ->ArgName("workers")->Arg(0)->Arg(1)->Arg(2)->Arg(4)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_TaskGroup_Quicksort(benchmark::State& state) {
+    const size_t kElements = 1 << 20;
+    const int workers = static_cast<int>(state.range(0));
+    lockfree::ThreadPool pool(workers ? workers : 1);
+    lockfree::ThreadPool* p = workers ? &pool : nullptr;
+    std::vector<int> input(kElements);
+    std::mt19937 gen(42);
+    for (int& v : input) {
+        v = static_cast<int>(gen());
+    }
+    std::vector<int> data;
+    for (auto _ : state) {
+        state.PauseTiming();
+        data = input;
+        state.ResumeTiming();
+        int* first = data.data();
+        int* last = first + data.size();
+        if (p) {
+            p->submit([p, first, last] { group_sort(p, first, last); }).get();
+        } else {
+            group_sort(nullptr, first, last);
+        }
+    }
+    benchmark::DoNotOptimize(data.data());
+    state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK(BM_TaskGroup_Quicksort)
+    ->ArgName("workers")->Arg(0)->Arg(1)->Arg(2)->Arg(4)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Latency of small requests while background work keeps every core
+// busy. Arg 0: a pool per workload, each sized to the machine, so the
+// OS multiplexes twice the threads there are cores. Arg 1: one pool,
+// with a request arena holding one reserved worker and a background
+// arena limited to the rest.
+static void BM_TaskArena_RequestLatency(benchmark::State& state) {
+    const size_t cores = std::max(2u, std::thread::hardware_concurrency());
+    const bool arenas = state.range(0) != 0;
+    lockfree::ThreadPool shared_pool(cores);
+    // Idle, a single parked thread, in the arena run.
+    lockfree::ThreadPool request_pool(arenas ? 1 : cores);
+    lockfree::TaskArena requests(shared_pool, lockfree::ArenaOptions(4, 0, 1));
+    lockfree::TaskArena background(shared_pool,
+                                   lockfree::ArenaOptions(1, cores - 1));
+
+    // cores background chunks of 200 us in flight, each reposting itself.
+    std::atomic<bool> stop(false);
+    std::function<void()> chunk = [&] {
+        const uint64_t end = bench::now_ns() + 200000;
+        while (bench::now_ns() < end) {
+        }
+        if (stop.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if (arenas) {
+            background.post(chunk);
+        } else {
+            shared_pool.post(chunk);
+        }
+    };
+    for (size_t i = 0; i < cores; ++i) {
+        if (arenas) {
+            background.post(chunk);
+        } else {
+            shared_pool.post(chunk);
+        }
+    }
+
+    bench::LatencyRecorder latency;
+    for (auto _ : state) {
+        const uint64_t start = bench::now_ns();
+        uint64_t ran = arenas
+            ? requests.submit([] { return bench::now_ns(); }).get()
+            : request_pool.submit([] { return bench::now_ns(); }).get();
+        latency.record(ran - start);
+    }
+    stop.store(true);
+    if (arenas) {
+        background.wait();
+    } else {
+        shared_pool.wait();
+    }
+    latency.report(state);
+}
+BENCHMARK(BM_TaskArena_RequestLatency)
+    ->ArgName("arenas")->Arg(0)->Arg(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// 1024 random 4 KB reads from a 16 MB file per iteration on two workers:
+// a blocking pread per task (arg 0), AsyncIo on its I/O threads (1) and
+// AsyncIo on io_uring (2). The file sits in the page cache, so this
+// measures per-read overhead; on a real device the blocking variant also
+// loses a worker per outstanding read.
+static void BM_AsyncIo_RandomReads(benchmark::State& state) {
+    constexpr size_t kFileSize = 16 << 20;
+    constexpr size_t kBlock = 4096;
+    constexpr int kReads = 1024;
+    char path[] = "/tmp/lockfree_bench_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        state.SkipWithError("mkstemp failed");
+        return;
+    }
+    unlink(path);
+    std::vector<char> block(kBlock, 'x');
+    for (size_t offset = 0; offset < kFileSize; offset += kBlock) {
+        if (pwrite(fd, block.data(), kBlock, offset) != static_cast<ssize_t>(kBlock)) {
+            state.SkipWithError("pwrite failed");
+            close(fd);
+            return;
+        }
+    }
+    std::vector<uint64_t> offsets(kReads);
+    std::mt19937_64 rng(42);
+    for (auto& offset : offsets) {
+        offset = rng() % (kFileSize / kBlock) * kBlock;
+    }
+    std::vector<char> buffers(kReads * kBlock);
+
+    const int mode = static_cast<int>(state.range(0));
+    lockfree::ThreadPool pool(2);
+    lockfree::AsyncIo io(pool, lockfree::IoOptions(
+        mode == 1 ? lockfree::IoEngine::Threads : lockfree::IoEngine::Auto));
+    if (mode == 2 && io.engine() != lockfree::IoEngine::IoUring) {
+        state.SkipWithError("io_uring unavailable");
+        close(fd);
+        return;
+    }
+    std::atomic<size_t> bytes(0);
+    for (auto _ : state) {
+        pool.post([&] {
+            for (int i = 0; i < kReads; ++i) {
+                char* buf = &buffers[i * kBlock];
+                if (mode == 0) {
+                    pool.post([&, buf, i] {
+                        bytes += static_cast<size_t>(pread(fd, buf, kBlock, offsets[i]));
+                    });
+                } else {
+                    io.read(fd, buf, kBlock, offsets[i], [&bytes](int n) {
+                        bytes += static_cast<size_t>(n);
+                    });
+                }
+            }
+        });
+        pool.wait();
+    }
+    close(fd);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes.load()));
+    state.SetItemsProcessed(state.iterations() * kReads);
+}
+BENCHMARK(BM_AsyncIo_RandomReads)
+    ->ArgName("mode")->Arg(0)->Arg(1)->Arg(2)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// parse -> transform -> aggregate over 4096 lines per iteration, as a
+// Pipeline on the pool (arg: max_tokens) and hand-wired from Queues with
+// a thread per stage, the setup Pipeline replaces.
+namespace {
+
+const int kPipelineLines = 4096;
+
+uint64_t transform_record(int v) {
+    uint64_t x = static_cast<uint64_t>(v);
+    for (int i = 0; i < 64; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    return x;
+}
+
+} // namespace
+
+static void BM_Pipeline_ParseTransformAggregate(benchmark::State& state) {
+    lockfree::ThreadPool pool(4);
+    std::vector<std::string> lines;
+    for (int i = 0; i < kPipelineLines; ++i) {
+        lines.push_back(std::to_string(i));
+    }
+    size_t next = 0;
+    uint64_t total = 0;
+    lockfree::Pipeline pipeline =
+        lockfree::Pipeline::source(pool, static_cast<size_t>(state.range(0)),
+                [&](lockfree::FlowControl& fc) -> const std::string* {
+            if (next == lines.size()) {
+                fc.stop();
+                return nullptr;
+            }
+            return &lines[next++];
+        })
+            .stage(lockfree::StageMode::Parallel,
+                   [](const std::string*& line) { return std::stoi(*line); })
+            .stage(lockfree::StageMode::Parallel,
+                   [](int& v) { return transform_record(v); })
+            .sink(lockfree::StageMode::SerialInOrder,
+                  [&total](uint64_t& v) { total += v; });
+
+    lockfree::PipelineStats stats;
+    for (auto _ : state) {
+        next = 0;
+        stats = pipeline.run();
+    }
+    benchmark::DoNotOptimize(total);
+    state.SetItemsProcessed(state.iterations() * kPipelineLines);
+    state.counters["max_in_flight"] = static_cast<double>(stats.max_in_flight);
+    state.counters["sink_occupancy"] = stats.stages.back().occupancy;
+}
+BENCHMARK(BM_Pipeline_ParseTransformAggregate)
+    ->Arg(4)->Arg(16)->Arg(64)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_HandWired_ParseTransformAggregate(benchmark::State& state) {
+    std::vector<std::string> lines;
+    for (int i = 0; i < kPipelineLines; ++i) {
+        lines.push_back(std::to_string(i));
+    }
+    uint64_t total = 0;
+    for (auto _ : state) {
+        lockfree::Queue<int> parsed;
+        lockfree::Queue<uint64_t> transformed;
+        std::thread parser([&] {
+            for (const std::string& line : lines) {
+                parsed.push(std::stoi(line));
+            }
+        });
+        std::thread transformer([&] {
+            int v;
+            for (int n = 0; n < kPipelineLines; ++n) {
+                while (!parsed.pop(v)) {
+                    std::this_thread::yield();
+                }
+                transformed.push(transform_record(v));
+            }
+        });
+        uint64_t v;
+        for (int n = 0; n < kPipelineLines; ++n) {
+            while (!transformed.pop(v)) {
+                std::this_thread::yield();
+            }
+            total += v;
+        }
+        parser.join();
+        transformer.join();
+    }
+    benchmark::DoNotOptimize(total);
+    state.SetItemsProcessed(state.iterations() * kPipelineLines);
+}
+BENCHMARK(BM_HandWired_ParseTransformAggregate)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
 BENCHMARK_MAIN();
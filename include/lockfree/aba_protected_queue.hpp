@@ -4,6 +4,7 @@
 #include "queue.hpp"
 #include <atomic>
 #include <cstdint>
+#include <utility>
 
 namespace lockfree {
 
@@ -14,16 +15,13 @@ public:
     
     void push(T value) {
         uintptr_t version = version_counter_.fetch_add(1, std::memory_order_relaxed);
-        queue_.push({std::move(value), version});
+        queue_.emplace(std::move(value), version);
     }
     
     bool pop(T& value) {
-        std::pair<T, uintptr_t> pair;
-        if (queue_.pop(pair)) {
+        return queue_.consume([&value](std::pair<T, uintptr_t>& pair) {
             value = std::move(pair.first);
-            return true;
-        }
-        return false;
+        });
     }
     
     bool empty() const { return queue_.empty(); }
@@ -0,0 +1,237 @@
+#ifndef LOCKFREE_ARENA_HPP
+#define LOCKFREE_ARENA_HPP
+
+#include "cache_aligned.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace lockfree {
+namespace detail {
+
+class SlabCache;
+
+// Precedes every arena block. owner is null for blocks that were too
+// large for a size class and came from operator new.
+struct alignas(16) BlockHeader {
+    SlabCache* owner;
+    union {
+        size_t size_class;
+        BlockHeader* next;  // while on a free list
+    };
+};
+
+// Per-thread slab allocator with power-of-two size classes from 64 to
+// 1024 bytes. The owning thread allocates and frees through plain free
+// lists; any other thread returns a block by pushing it onto the owner's
+// lock-free remote list, which the owner takes over in one exchange the
+// next time its local list runs dry.
+//
+// Caches are never destroyed: a block can be freed long after the
+// thread that allocated it has exited, so an exiting thread parks its
+// cache for the next new thread to adopt, remote list included.
+class SlabCache : public CacheAligned {
+public:
+    static constexpr size_t kClasses = 5;
+    static constexpr size_t kMinBlock = 64;
+    static constexpr size_t kMaxBlock = kMinBlock << (kClasses - 1);
+    static constexpr size_t kSlabBytes = 64 * 1024;
+
+    static void* allocate(size_t bytes) {
+        if (bytes > kMaxBlock) {
+            BlockHeader* h = static_cast<BlockHeader*>(
+                ::operator new(sizeof(BlockHeader) + bytes));
+            h->owner = nullptr;
+            h->size_class = kClasses;
+            return h + 1;
+        }
+        return local().pop(class_of(bytes));
+    }
+
+    static void deallocate(void* p) {
+        if (!p) {
+            return;
+        }
+        BlockHeader* h = static_cast<BlockHeader*>(p) - 1;
+        SlabCache* owner = h->owner;
+        if (!owner) {
+            ::operator delete(h);
+        } else if (owner == current()) {
+            owner->push_local(h);
+        } else {
+            owner->push_remote(h);
+        }
+    }
+
+private:
+    // Registers the calling thread's cache and parks it again on exit.
+    struct ThreadSlot {
+        SlabCache* cache;
+        ThreadSlot() : cache(adopt()) { current() = cache; }
+        ~ThreadSlot() {
+            current() = nullptr;
+            park(cache);
+        }
+    };
+
+    SlabCache() {
+        for (size_t i = 0; i < kClasses; ++i) {
+            free_[i] = nullptr;
+            remote_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    static SlabCache*& current() {
+        static thread_local SlabCache* cache = nullptr;
+        return cache;
+    }
+
+    static SlabCache& local() {
+        SlabCache* cache = current();
+        if (!cache) {
+            static thread_local ThreadSlot slot;
+            cache = slot.cache;
+        }
+        return *cache;
+    }
+
+    static size_t class_of(size_t bytes) {
+        size_t cls = 0;
+        size_t size = kMinBlock;
+        while (size < bytes) {
+            size <<= 1;
+            ++cls;
+        }
+        return cls;
+    }
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<SlabCache*> parked;
+    };
+
+    // Leaked on purpose, like the caches it hands out.
+    static Registry& registry() {
+        static Registry* r = new Registry;
+        return *r;
+    }
+
+    static SlabCache* adopt() {
+        Registry& r = registry();
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            if (!r.parked.empty()) {
+                SlabCache* cache = r.parked.back();
+                r.parked.pop_back();
+                return cache;
+            }
+        }
+        return new SlabCache;
+    }
+
+    static void park(SlabCache* cache) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.parked.push_back(cache);
+    }
+
+    void* pop(size_t cls) {
+        BlockHeader* h = free_[cls];
+        if (!h) {
+            h = remote_[cls].exchange(nullptr, std::memory_order_acquire);
+            if (!h) {
+                h = refill(cls);
+            }
+        }
+        free_[cls] = h->next;
+        h->owner = this;
+        h->size_class = cls;
+        return h + 1;
+    }
+
+    void push_local(BlockHeader* h) {
+        const size_t cls = h->size_class;
+        h->next = free_[cls];
+        free_[cls] = h;
+    }
+
+    void push_remote(BlockHeader* h) {
+        std::atomic<BlockHeader*>& list = remote_[h->size_class];
+        BlockHeader* head = list.load(std::memory_order_relaxed);
+        do {
+            h->next = head;
+        } while (!list.compare_exchange_weak(head, h,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+    }
+
+    // Carves a fresh slab into blocks of class cls.
+    BlockHeader* refill(size_t cls) {
+        const size_t stride = sizeof(BlockHeader) + (kMinBlock << cls);
+        char* slab = static_cast<char*>(::operator new(kSlabBytes));
+        BlockHeader* list = nullptr;
+        for (size_t off = 0; off + stride <= kSlabBytes; off += stride) {
+            BlockHeader* h = reinterpret_cast<BlockHeader*>(slab + off);
+            h->owner = this;
+            h->next = list;
+            list = h;
+        }
+        return list;
+    }
+
+    BlockHeader* free_[kClasses];
+    alignas(64) std::atomic<BlockHeader*> remote_[kClasses];
+};
+
+} // namespace detail
+
+// Standard allocator over the calling thread's SlabCache. Stateless, so
+// memory allocated on one thread may be freed on any other. Types aligned
+// beyond 16 bytes fall back to operator new.
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaAllocator() noexcept {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (alignof(T) > alignof(detail::BlockHeader)) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(detail::SlabCache::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        if (alignof(T) > alignof(detail::BlockHeader)) {
+            ::operator delete(p);
+            return;
+        }
+        detail::SlabCache::deallocate(p);
+    }
+
+    template <typename U>
+    struct rebind {
+        typedef ArenaAllocator<U> other;
+    };
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept {
+    return false;
+}
+
+} // namespace lockfree
+
+#endif // LOCKFREE_ARENA_HPP
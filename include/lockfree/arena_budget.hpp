@@ -0,0 +1,88 @@
+#ifndef LOCKFREE_ARENA_BUDGET_HPP
+#define LOCKFREE_ARENA_BUDGET_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace lockfree {
+
+class TaskArena;
+
+namespace detail {
+
+// The workers of one ThreadPool as TaskArenas see them. Each arena's
+// reservation is set aside for it alone; the rest are shared, handed to
+// whichever waiting arena is furthest behind its weighted share.
+struct ArenaBudget {
+    static constexpr size_t kMaxArenas = 64;
+
+    explicit ArenaBudget(size_t workers) : capacity(workers) {
+        for (auto& slot : arenas) {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ArenaBudget(const ArenaBudget&) = delete;
+    ArenaBudget& operator=(const ArenaBudget&) = delete;
+
+    const size_t capacity;
+    // Sum of the registered arenas' reservations.
+    std::atomic<size_t> reserved{0};
+    // Virtual time (weighted busy nanoseconds) of the arena last handed
+    // a shared worker. An arena waking from idle starts here, so a long
+    // nap does not bank credit to starve the others with.
+    std::atomic<uint64_t> virtual_now{0};
+    // Workers running an arena outside its reservation. Written on
+    // every acquire and release, so it gets a line of its own.
+    alignas(64) std::atomic<size_t> shared_in_use{0};
+    // Registered arenas, and threads currently walking them; an arena
+    // clears its slot and waits for walkers to leave before it dies.
+    std::atomic<TaskArena*> arenas[kMaxArenas];
+    std::atomic<size_t> walkers{0};
+
+    // Reserves n workers. False if that would leave none shared: an
+    // arena without a reservation could then never run, and its owner
+    // would wait on it forever.
+    bool reserve(size_t n) {
+        size_t r = reserved.load(std::memory_order_relaxed);
+        do {
+            if (n != 0 && n >= capacity - r) {
+                return false;
+            }
+        } while (!reserved.compare_exchange_weak(r, r + n,
+                                                 std::memory_order_acq_rel));
+        return true;
+    }
+
+    void unreserve(size_t n) {
+        reserved.fetch_sub(n, std::memory_order_acq_rel);
+    }
+
+    bool try_acquire_shared() {
+        size_t used = shared_in_use.load(std::memory_order_relaxed);
+        do {
+            const size_t r = reserved.load(std::memory_order_relaxed);
+            if (used + r >= capacity) {
+                return false;
+            }
+        } while (!shared_in_use.compare_exchange_weak(
+            used, used + 1, std::memory_order_seq_cst));
+        return true;
+    }
+
+    void release_shared() {
+        shared_in_use.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    bool shared_available() const {
+        return shared_in_use.load(std::memory_order_seq_cst) +
+                   reserved.load(std::memory_order_relaxed) <
+               capacity;
+    }
+};
+
+} // namespace detail
+} // namespace lockfree
+
+#endif // LOCKFREE_ARENA_BUDGET_HPP
@@ -0,0 +1,218 @@
+#ifndef LOCKFREE_ASYNC_IO_HPP
+#define LOCKFREE_ASYNC_IO_HPP
+
+#include "exceptions.hpp"
+#include "thread_pool.hpp"
+#include <sys/uio.h>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace lockfree {
+
+enum class IoEngine {
+    // io_uring if the kernel offers it, Threads otherwise.
+    Auto,
+    // io_uring; the constructor throws std::system_error without it.
+    IoUring,
+    // A few threads making blocking calls; runs anywhere with POSIX I/O.
+    Threads
+};
+
+struct IoOptions {
+    IoEngine engine;
+    // IoUring: ring entries, and so the most operations the kernel has
+    // at once; further ones wait in a backlog until a slot frees up.
+    unsigned queue_depth;
+    // Threads: blocking I/O threads shared by every operation.
+    size_t threads;
+
+    IoOptions() : engine(IoEngine::Auto), queue_depth(256), threads(4) {}
+
+    IoOptions(IoEngine e, unsigned depth = 256, size_t n = 4)
+        : engine(e), queue_depth(depth ? depth : 1), threads(n ? n : 1) {}
+};
+
+namespace detail {
+
+class IoDevice;
+
+// One operation from submission until its handler has run. The backend
+// sets result; finish() runs the handler with it, or with run false
+// only frees the operation, e.g. when the pool drops the completion.
+struct IoOp {
+    enum Kind : uint8_t { Read, Write, Fsync, ReadFixed, WriteFixed };
+
+    Kind kind;
+    int fd;
+    unsigned buffer;  // registered buffer index, *Fixed only
+    void* data;
+    size_t length;
+    uint64_t offset;
+    int result;
+    // Backlog and completion lists; owned by the backend meanwhile.
+    IoOp* next;
+    void (*finish)(IoOp* op, bool run);
+};
+
+template <typename F>
+struct IoOpWith : IoOp {
+    F handler;
+
+    template <typename G>
+    explicit IoOpWith(G&& g) : handler(std::forward<G>(g)) {
+        finish = &IoOpWith::complete;
+    }
+
+    static void complete(IoOp* op, bool run) {
+        std::unique_ptr<IoOpWith> self(static_cast<IoOpWith*>(op));
+        if (run) {
+            self->handler(self->result);
+        }
+    }
+};
+
+} // namespace detail
+
+// File I/O whose completions run as tasks on a ThreadPool, so a task
+// that needs a read issues it and returns instead of blocking its
+// worker in the syscall.
+//
+//   ThreadPool pool;
+//   AsyncIo io(pool);
+//   io.read(fd, buf, 4096, 0, [buf](int n) {
+//       if (n >= 0) parse(buf, n);          // runs on a pool worker
+//   });
+//
+// Handlers get the byte count (0 for fsync) or -errno, and are posted
+// to the pool like any other task, so wait() and a Drain shutdown cover
+// operations still in flight. Buffers must stay valid until then.
+//
+// With io_uring the operations go straight to the kernel's ring, and
+// the pool's workers reap completions on their idle path, next to the
+// timers; one idle worker blocks on the ring instead of parking while
+// anything is in flight. The kernel cancels requests a thread submitted
+// when that thread exits, so submissions from outside the pool wait for
+// a worker to hand them in. Registered buffers are pinned once and then
+// read and written in place by read_fixed() and write_fixed().
+//
+// Without io_uring a few threads make the blocking calls, however many
+// operations are queued; registered buffers are then plain memory.
+//
+// A pool has at most one AsyncIo, and must outlive it. Destroying the
+// AsyncIo waits for its operations. Once the pool has stopped, their
+// handlers are dropped instead of run and the rest are cancelled, so a
+// read from an idle pipe does not hold up teardown. The Threads backend
+// cannot interrupt a blocked call; it abandons one still blocked after
+// a short grace, and that buffer must then outlive the call.
+class AsyncIo {
+public:
+    explicit AsyncIo(ThreadPool& pool, const IoOptions& options = IoOptions());
+    ~AsyncIo();
+
+    AsyncIo(const AsyncIo&) = delete;
+    AsyncIo& operator=(const AsyncIo&) = delete;
+
+    // Reads up to len bytes at offset into buf, then posts done(result).
+    // Offset uint64_t(-1) reads at the file position, e.g. from a pipe.
+    // Shutdown or NoMemory means nothing was started and done dropped.
+    template <typename F>
+    SubmitStatus read(int fd, void* buf, size_t len, uint64_t offset,
+                      F&& done) noexcept {
+        return start(detail::IoOp::Read, fd, 0, buf, len, offset,
+                     std::forward<F>(done));
+    }
+
+    template <typename F>
+    SubmitStatus write(int fd, const void* buf, size_t len, uint64_t offset,
+                       F&& done) noexcept {
+        return start(detail::IoOp::Write, fd, 0, const_cast<void*>(buf), len,
+                     offset, std::forward<F>(done));
+    }
+
+    template <typename F>
+    SubmitStatus fsync(int fd, F&& done) noexcept {
+        return start(detail::IoOp::Fsync, fd, 0, nullptr, 0, 0,
+                     std::forward<F>(done));
+    }
+
+    // As read() and write(), with buf inside registered buffer index.
+    template <typename F>
+    SubmitStatus read_fixed(int fd, unsigned index, void* buf, size_t len,
+                            uint64_t offset, F&& done) noexcept {
+        return start(detail::IoOp::ReadFixed, fd, index, buf, len, offset,
+                     std::forward<F>(done));
+    }
+
+    template <typename F>
+    SubmitStatus write_fixed(int fd, unsigned index, const void* buf,
+                             size_t len, uint64_t offset, F&& done) noexcept {
+        return start(detail::IoOp::WriteFixed, fd, index,
+                     const_cast<void*>(buf), len, offset,
+                     std::forward<F>(done));
+    }
+
+    // For threads outside the pool that want to block on the result. A
+    // refused submission, or one dropped at shutdown, yields -ECANCELED.
+    std::future<int> read(int fd, void* buf, size_t len, uint64_t offset);
+    std::future<int> write(int fd, const void* buf, size_t len,
+                           uint64_t offset);
+    std::future<int> fsync(int fd);
+
+    // Registers the buffers *_fixed() use, by index into buffers. One
+    // set at a time; 0 or -errno.
+    int register_buffers(const struct iovec* buffers, unsigned count);
+    int unregister_buffers();
+
+    // IoUring or Threads, whichever the constructor picked.
+    IoEngine engine() const { return engine_; }
+
+    // Operations submitted whose completions are not yet on the pool.
+    size_t in_flight() const;
+
+    // Returns once every operation submitted so far has completed and
+    // its handler is queued, or after the pool has stopped, once they are
+    // cancelled or abandoned. Must not be called from a task running on
+    // the pool.
+    void wait();
+
+private:
+    template <typename F>
+    SubmitStatus start(detail::IoOp::Kind kind, int fd, unsigned index,
+                       void* data, size_t length, uint64_t offset,
+                       F&& done) noexcept {
+        typedef detail::IoOpWith<typename std::decay<F>::type> Op;
+        Op* op = nullptr;
+        LOCKFREE_TRY {
+            op = new (std::nothrow) Op(std::forward<F>(done));
+        } LOCKFREE_CATCH_ALL {
+        }
+        if (!op) {
+            return SubmitStatus::NoMemory;
+        }
+        op->kind = kind;
+        op->fd = fd;
+        op->buffer = index;
+        op->data = data;
+        op->length = length;
+        op->offset = offset;
+        op->result = 0;
+        op->next = nullptr;
+        return submit(op);
+    }
+
+    SubmitStatus submit(detail::IoOp* op) noexcept;
+    static void wake_pool(void* pool);
+
+    ThreadPool* pool_;
+    IoEngine engine_;
+    std::unique_ptr<detail::IoDevice> device_;
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_ASYNC_IO_HPP
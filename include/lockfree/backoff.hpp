@@ -0,0 +1,187 @@
+#ifndef LOCKFREE_BACKOFF_HPP
+#define LOCKFREE_BACKOFF_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace lockfree {
+
+namespace detail {
+
+// Tells the core we are spinning: frees the sibling hyperthread and
+// avoids the memory-order mis-speculation flush on loop exit.
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+} // namespace detail
+
+// How a retry loop waits between attempts: rounds of pause instructions
+// doubling from min_spins up to the spin budget, then yield_rounds
+// yields, then the caller parks if it has something to park on.
+struct BackoffPolicy {
+    uint32_t min_spins;
+    uint32_t max_spins;
+    uint32_t yield_rounds;
+    // Let the spin budget follow recent outcomes: waits that end while
+    // still spinning double it, waits that run out and park halve it.
+    bool adaptive;
+
+    BackoffPolicy()
+        : min_spins(4), max_spins(1024), yield_rounds(8), adaptive(true) {}
+
+    BackoffPolicy(uint32_t min, uint32_t max, uint32_t yields,
+                  bool adapt = true)
+        : min_spins(min), max_spins(max < min ? min : max),
+          yield_rounds(yields), adaptive(adapt) {}
+
+    // No pause rounds: yield straight away, as the pool used to.
+    static BackoffPolicy yield_only(uint32_t yields = 8) {
+        return BackoffPolicy(0, 0, yields, false);
+    }
+
+    // Never yields before parking; for threads pinned to their own core.
+    static BackoffPolicy spin_only(uint32_t spins = 1 << 14) {
+        return BackoffPolicy(4, spins, 0, false);
+    }
+};
+
+// A policy plus the spin budget learned for one object. Shared by every
+// thread waiting on that object; updates are relaxed and racy on
+// purpose, the budget is only a hint.
+class BackoffState {
+public:
+    explicit BackoffState(const BackoffPolicy& policy = BackoffPolicy())
+        : policy_(policy), budget_(policy.max_spins) {}
+
+    BackoffState(const BackoffState&) = delete;
+    BackoffState& operator=(const BackoffState&) = delete;
+
+    const BackoffPolicy& policy() const { return policy_; }
+
+    uint32_t spin_budget() const {
+        return budget_.load(std::memory_order_relaxed);
+    }
+
+    void record(bool spin_succeeded) {
+        if (!policy_.adaptive) {
+            return;
+        }
+        uint32_t budget = budget_.load(std::memory_order_relaxed);
+        uint32_t next = spin_succeeded ? budget * 2 : budget / 2;
+        if (next < policy_.min_spins) next = policy_.min_spins;
+        if (next > policy_.max_spins) next = policy_.max_spins;
+        if (next != budget) {
+            budget_.store(next, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    const BackoffPolicy policy_;
+    std::atomic<uint32_t> budget_;
+};
+
+// One wait in progress; lives on the waiting thread's stack.
+//
+//   Backoff backoff(state);
+//   while (!try_take()) {
+//       if (!backoff.pause()) park();
+//   }
+//   backoff.succeeded();
+//
+// CAS loops that cannot park just call pause() and ignore the result.
+class Backoff {
+public:
+    // Fixed budget, nothing learned.
+    explicit Backoff(const BackoffPolicy& policy)
+        : policy_(policy), state_(nullptr), budget_(policy.max_spins),
+          round_(0) {}
+
+    // Budget from state; succeeded() and exhausted waits feed it back.
+    explicit Backoff(BackoffState& state)
+        : policy_(state.policy()), state_(&state),
+          budget_(state.spin_budget()), round_(0) {}
+
+    // One step of waiting. Returns false once the spin and yield phases
+    // are used up: the caller should park now. Further calls keep
+    // yielding.
+    bool pause() {
+        const uint32_t spins = spins_for(round_);
+        if (spins != 0) {
+            for (uint32_t i = 0; i < spins; ++i) {
+                detail::cpu_relax();
+            }
+            ++round_;
+            return true;
+        }
+        const uint32_t yields = round_ - spin_rounds();
+        if (yields < policy_.yield_rounds) {
+            std::this_thread::yield();
+            ++round_;
+            return true;
+        }
+        if (yields == policy_.yield_rounds) {
+            if (state_) {
+                state_->record(false);
+            }
+            ++round_;
+        } else {
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    // The wait ended; credits the budget if it ended while spinning.
+    void succeeded() {
+        if (state_ && round_ > 0 && round_ <= spin_rounds()) {
+            state_->record(true);
+        }
+    }
+
+    void reset() {
+        if (state_) {
+            budget_ = state_->spin_budget();
+        }
+        round_ = 0;
+    }
+
+    bool spinning() const { return spins_for(round_) != 0; }
+
+private:
+    // Round r spins min_spins << r, while that stays within the budget.
+    uint32_t spins_for(uint32_t round) const {
+        if (policy_.min_spins == 0 || round >= 31) {
+            return 0;
+        }
+        const uint64_t spins = static_cast<uint64_t>(policy_.min_spins) << round;
+        return spins <= budget_ ? static_cast<uint32_t>(spins) : 0;
+    }
+
+    uint32_t spin_rounds() const {
+        uint32_t rounds = 0;
+        while (spins_for(rounds) != 0) {
+            ++rounds;
+        }
+        return rounds;
+    }
+
+    const BackoffPolicy policy_;
+    BackoffState* state_;
+    uint32_t budget_;
+    uint32_t round_;
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_BACKOFF_HPP
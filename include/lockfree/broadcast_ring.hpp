@@ -0,0 +1,373 @@
+#ifndef LOCKFREE_BROADCAST_RING_HPP
+#define LOCKFREE_BROADCAST_RING_HPP
+
+#include "cache_aligned.hpp"
+#include "exceptions.hpp"
+#include "parking_lot.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lockfree {
+
+// How a BroadcastRing reader waits for data and the writer waits for the
+// slowest reader.
+enum class WaitStrategy {
+    // Spin on the sequence. Lowest latency; burns a core per waiter.
+    BusySpin,
+    // Yield the CPU between checks.
+    Yield,
+    // Spin briefly, then park on the ParkingLot until woken.
+    Block
+};
+
+// Single-writer, multi-reader sequenced ring (Disruptor-style) for
+// one-to-many fan-out. Each message is written once into a preallocated
+// slot; every subscriber reads it in place through its own cursor, so
+// the cost of a publish does not grow with the number of subscribers.
+//
+// The writer never laps a subscriber: when the slowest one is capacity
+// messages behind, publish() waits for it (backpressure). Messages
+// published while nobody is subscribed are not retained for later
+// subscribers, which start at the next message.
+//
+// T must be default-constructible and assignable; slots are reused, not
+// destroyed. Only one thread may publish. The ring must outlive its
+// subscribers.
+template <typename T>
+class BroadcastRing : public detail::CacheAligned {
+    struct Cursor;
+
+public:
+    class Subscriber;
+
+    explicit BroadcastRing(size_t capacity,
+                           WaitStrategy wait = WaitStrategy::Yield)
+        : slots_(round_up(capacity)),
+          mask_(slots_.size() - 1),
+          wait_(wait),
+          published_(0),
+          reader_waiters_(0),
+          closed_(false),
+          cursors_(nullptr),
+          writer_waiting_(false),
+          gate_cache_(0) {}
+
+    ~BroadcastRing() {
+        Cursor* c = cursors_.load(std::memory_order_relaxed);
+        while (c) {
+            Cursor* next = c->link;
+            delete c;
+            c = next;
+        }
+    }
+
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+    void publish(const T& value) {
+        publish_with([&value](T& slot) { slot = value; });
+    }
+
+    void publish(T&& value) {
+        publish_with([&value](T& slot) { slot = std::move(value); });
+    }
+
+    // Waits for a free slot, then lets fill(T&) write the message in place.
+    template <typename F>
+    void publish_with(F&& fill) {
+        const uint64_t seq = published_.load(std::memory_order_relaxed);
+        wait_for_slot(seq);
+        fill(slots_[seq & mask_]);
+        commit(seq + 1);
+    }
+
+    // Returns false instead of waiting when the slowest subscriber is a
+    // full ring behind.
+    bool try_publish(const T& value) {
+        const uint64_t seq = published_.load(std::memory_order_relaxed);
+        if (!slot_free(seq)) {
+            return false;
+        }
+        slots_[seq & mask_] = value;
+        commit(seq + 1);
+        return true;
+    }
+
+    // Wakes blocked subscribers; once they have read everything published
+    // so far their blocking reads return 0.
+    void close() {
+        closed_.store(true, std::memory_order_seq_cst);
+        detail::ParkingLot::unpark_all(&published_);
+    }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // Starts at the next message published after this call. Safe to call
+    // while the writer is publishing.
+    Subscriber subscribe() {
+        Cursor* cursor = nullptr;
+        for (Cursor* c = cursors_.load(std::memory_order_acquire); c;
+             c = c->link) {
+            bool expected = false;
+            if (!c->active.load(std::memory_order_relaxed) &&
+                c->active.compare_exchange_strong(expected, true)) {
+                cursor = c;
+                break;
+            }
+        }
+        if (!cursor) {
+            cursor = new Cursor;
+            cursor->active.store(true, std::memory_order_relaxed);
+            Cursor* head = cursors_.load(std::memory_order_relaxed);
+            do {
+                cursor->link = head;
+            } while (!cursors_.compare_exchange_weak(head, cursor));
+        }
+        // Pairs with the fence in min_cursor(): either the writer's next
+        // scan sees this cursor, or this load sees every sequence that
+        // writer may publish before rescanning.
+        cursor->next.store(published_.load(std::memory_order_seq_cst),
+                           std::memory_order_seq_cst);
+        wake_writer();
+        return Subscriber(this, cursor);
+    }
+
+    // Messages published so far.
+    uint64_t published() const {
+        return published_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return slots_.size(); }
+    WaitStrategy wait_strategy() const { return wait_; }
+
+    class Subscriber {
+    public:
+        Subscriber() : ring_(nullptr), cursor_(nullptr) {}
+
+        Subscriber(Subscriber&& other) noexcept
+            : ring_(other.ring_), cursor_(other.cursor_) {
+            other.ring_ = nullptr;
+            other.cursor_ = nullptr;
+        }
+
+        Subscriber& operator=(Subscriber&& other) noexcept {
+            if (this != &other) {
+                unsubscribe();
+                ring_ = other.ring_;
+                cursor_ = other.cursor_;
+                other.ring_ = nullptr;
+                other.cursor_ = nullptr;
+            }
+            return *this;
+        }
+
+        ~Subscriber() { unsubscribe(); }
+
+        // Stops gating the writer. Called by the destructor.
+        void unsubscribe() {
+            if (cursor_) {
+                cursor_->active.store(false, std::memory_order_seq_cst);
+                ring_->wake_writer();
+                cursor_ = nullptr;
+                ring_ = nullptr;
+            }
+        }
+
+        // Messages published but not yet read by this subscriber.
+        size_t available() const {
+            return static_cast<size_t>(
+                ring_->published() -
+                cursor_->next.load(std::memory_order_relaxed));
+        }
+
+        bool try_read(T& out) {
+            return read_batch([&out](const T& v) { out = v; }, 1) == 1;
+        }
+
+        // Hands up to max available messages to f(const T&) in place and
+        // releases their slots with one cursor store. Does not wait.
+        template <typename F>
+        size_t read_batch(F&& f, size_t max =
+                              std::numeric_limits<size_t>::max()) {
+            const uint64_t from = cursor_->next.load(std::memory_order_relaxed);
+            uint64_t to = ring_->published_.load(std::memory_order_acquire);
+            if (to - from > max) {
+                to = from + max;
+            }
+            for (uint64_t seq = from; seq != to; ++seq) {
+                f(static_cast<const T&>(ring_->slots_[seq & ring_->mask_]));
+            }
+            if (to != from) {
+                ring_->advance(cursor_, to);
+            }
+            return static_cast<size_t>(to - from);
+        }
+
+        // As read_batch, but waits per the ring's strategy until at least
+        // one message is available. Returns 0 only once the ring is
+        // closed and drained.
+        template <typename F>
+        size_t wait_batch(F&& f, size_t max =
+                              std::numeric_limits<size_t>::max()) {
+            for (;;) {
+                const size_t n = read_batch(f, max);
+                if (n || !ring_->wait_for_data(cursor_)) {
+                    return n;
+                }
+            }
+        }
+
+        // Blocking single read. Returns false once closed and drained.
+        bool read(T& out) {
+            return wait_batch([&out](const T& v) { out = v; }, 1) == 1;
+        }
+
+        explicit operator bool() const { return cursor_ != nullptr; }
+
+    private:
+        friend class BroadcastRing;
+
+        Subscriber(BroadcastRing* ring, Cursor* cursor)
+            : ring_(ring), cursor_(cursor) {}
+
+        BroadcastRing* ring_;
+        Cursor* cursor_;
+    };
+
+private:
+    struct alignas(64) Cursor : detail::CacheAligned {
+        std::atomic<uint64_t> next;  // First sequence not yet read.
+        std::atomic<bool> active;
+        Cursor* link;  // Cursors are only ever added, never unlinked.
+
+        Cursor() : next(0), active(false), link(nullptr) {}
+    };
+
+    // Spins before a Block waiter parks.
+    static constexpr int kSpinLimit = 128;
+
+    static size_t round_up(size_t n) {
+        if (n == 0) {
+            detail::raise(
+                std::invalid_argument("BroadcastRing capacity must be > 0"));
+        }
+        size_t size = 1;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    // Slowest active cursor, or limit if nobody is subscribed.
+    uint64_t min_cursor(uint64_t limit) const {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t min = limit;
+        for (Cursor* c = cursors_.load(std::memory_order_acquire); c;
+             c = c->link) {
+            if (c->active.load(std::memory_order_seq_cst)) {
+                const uint64_t next = c->next.load(std::memory_order_acquire);
+                if (next < min) {
+                    min = next;
+                }
+            }
+        }
+        return min;
+    }
+
+    // The writer rescans the cursors only when its cached minimum says
+    // the ring might be full.
+    bool slot_free(uint64_t seq) {
+        if (seq - gate_cache_ < slots_.size()) {
+            return true;
+        }
+        gate_cache_ = min_cursor(seq);
+        return seq - gate_cache_ < slots_.size();
+    }
+
+    void wait_for_slot(uint64_t seq) {
+        for (int spins = 0; !slot_free(seq); ++spins) {
+            if (wait_ == WaitStrategy::Yield ||
+                (wait_ == WaitStrategy::Block && spins < kSpinLimit)) {
+                std::this_thread::yield();
+            } else if (wait_ == WaitStrategy::Block) {
+                writer_waiting_.store(true, std::memory_order_seq_cst);
+                detail::ParkingLot::park(&cursors_, [this, seq] {
+                    return seq - min_cursor(seq) >= slots_.size();
+                });
+                writer_waiting_.store(false, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void commit(uint64_t published) {
+        if (wait_ == WaitStrategy::Block) {
+            // Pairs with the waiter registration in wait_for_data().
+            published_.store(published, std::memory_order_seq_cst);
+            if (reader_waiters_.load(std::memory_order_seq_cst) != 0) {
+                detail::ParkingLot::unpark_all(&published_);
+            }
+        } else {
+            published_.store(published, std::memory_order_release);
+        }
+    }
+
+    void advance(Cursor* cursor, uint64_t to) {
+        if (wait_ == WaitStrategy::Block) {
+            cursor->next.store(to, std::memory_order_seq_cst);
+            wake_writer();
+        } else {
+            cursor->next.store(to, std::memory_order_release);
+        }
+    }
+
+    void wake_writer() {
+        if (writer_waiting_.load(std::memory_order_seq_cst)) {
+            detail::ParkingLot::unpark_all(&cursors_);
+        }
+    }
+
+    // Returns false if the ring is closed and nothing is left to read.
+    bool wait_for_data(Cursor* cursor) {
+        const uint64_t next = cursor->next.load(std::memory_order_relaxed);
+        for (int spins = 0;; ++spins) {
+            if (published_.load(std::memory_order_acquire) != next) {
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                return published_.load(std::memory_order_acquire) != next;
+            }
+            if (wait_ == WaitStrategy::Yield ||
+                (wait_ == WaitStrategy::Block && spins < kSpinLimit)) {
+                std::this_thread::yield();
+            } else if (wait_ == WaitStrategy::Block) {
+                reader_waiters_.fetch_add(1, std::memory_order_seq_cst);
+                detail::ParkingLot::park(&published_, [this, next] {
+                    return published_.load(std::memory_order_seq_cst) == next &&
+                           !closed_.load(std::memory_order_seq_cst);
+                });
+                reader_waiters_.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::vector<T> slots_;
+    const size_t mask_;
+    const WaitStrategy wait_;
+    alignas(64) std::atomic<uint64_t> published_;
+    std::atomic<unsigned> reader_waiters_;
+    std::atomic<bool> closed_;
+    alignas(64) std::atomic<Cursor*> cursors_;
+    // Writer-owned.
+    std::atomic<bool> writer_waiting_;
+    uint64_t gate_cache_;
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_BROADCAST_RING_HPP
@@ -0,0 +1,66 @@
+#ifndef LOCKFREE_CACHE_ALIGNED_HPP
+#define LOCKFREE_CACHE_ALIGNED_HPP
+
+#include "exceptions.hpp"
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace lockfree {
+namespace detail {
+
+// Base for the alignas(64) types that end up on the heap, whether the
+// library creates them or a caller writes new HashMap. Before C++17,
+// new only guarantees alignof(std::max_align_t), so a padded object
+// could still start mid-line and share it with its neighbour. Deriving
+// gives the type an operator new that honours the line; types that only
+// ever live inside another object do without it:
+//
+//   struct alignas(64) Shard : detail::CacheAligned { ... };
+struct CacheAligned {
+    static constexpr std::size_t kAlignment = 64;
+
+    static void* operator new(std::size_t size) {
+        void* p = allocate(size);
+        if (!p) {
+            raise(std::bad_alloc());
+        }
+        return p;
+    }
+    static void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+        return allocate(size);
+    }
+    static void* operator new(std::size_t, void* where) noexcept { return where; }
+
+    static void operator delete(void* p) noexcept { release(p); }
+    static void operator delete(void* p, const std::nothrow_t&) noexcept {
+        release(p);
+    }
+    static void operator delete(void*, void*) noexcept {}
+
+private:
+    static void* allocate(std::size_t size) noexcept {
+#if defined(_WIN32)
+        return _aligned_malloc(size, kAlignment);
+#else
+        void* p = nullptr;
+        return posix_memalign(&p, kAlignment, size) == 0 ? p : nullptr;
+#endif
+    }
+
+    static void release(void* p) noexcept {
+#if defined(_WIN32)
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+};
+
+} // namespace detail
+} // namespace lockfree
+
+#endif // LOCKFREE_CACHE_ALIGNED_HPP
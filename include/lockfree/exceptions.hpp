@@ -0,0 +1,52 @@
+#ifndef LOCKFREE_EXCEPTIONS_HPP
+#define LOCKFREE_EXCEPTIONS_HPP
+
+#include <cstdlib>
+
+// Lets the queues, the pool and its tasks build with -fno-exceptions.
+// Cleanup-and-rethrow blocks are written
+//
+//   LOCKFREE_TRY {
+//       construct();
+//   } LOCKFREE_CATCH_ALL {
+//       undo();
+//       LOCKFREE_RETHROW;
+//   }
+//
+// which without exceptions keeps the try body and drops the handler.
+// Errors that would throw abort instead; callers that must not die use
+// the status-returning entry points such as ThreadPool::try_post().
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define LOCKFREE_HAS_EXCEPTIONS 1
+#else
+#define LOCKFREE_HAS_EXCEPTIONS 0
+#endif
+
+#if LOCKFREE_HAS_EXCEPTIONS
+#define LOCKFREE_TRY try
+#define LOCKFREE_CATCH_ALL catch (...)
+#define LOCKFREE_RETHROW throw
+#else
+#define LOCKFREE_TRY if (true)
+#define LOCKFREE_CATCH_ALL else
+#define LOCKFREE_RETHROW ((void)0)
+#endif
+
+namespace lockfree {
+namespace detail {
+
+// throw e, or abort in builds without exceptions.
+template <typename E>
+[[noreturn]] inline void raise(const E& e) {
+#if LOCKFREE_HAS_EXCEPTIONS
+    throw e;
+#else
+    (void)e;
+    std::abort();
+#endif
+}
+
+} // namespace detail
+} // namespace lockfree
+
+#endif // LOCKFREE_EXCEPTIONS_HPP
@@ -0,0 +1,620 @@
+#ifndef LOCKFREE_HASH_MAP_HPP
+#define LOCKFREE_HASH_MAP_HPP
+
+#include "backoff.hpp"
+#include "cache_aligned.hpp"
+#include "hazard_pointer.hpp"
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace lockfree {
+
+// Concurrent hash map for lookup state shared between pool tasks.
+//
+// Open addressing with linear probing over 8-byte slots. A slot holds a
+// pointer to an immutable (key, value) node with the top bits of the
+// key's hash packed above it, so a probe rejects most non-matching slots
+// without touching the node. Reads are lock-free: they protect the node
+// they compare with a hazard pointer and never write shared memory.
+// Writers take one of kLockStripes spinlocks chosen by hash, which
+// serializes writers of the same key only, and claim free slots with a
+// CAS. Updates publish a new node and retire the old one through the
+// hazard pointer domain the queues use.
+//
+// Growing is incremental. When a table passes half full, a writer
+// installs a successor and every later write first moves one chunk of
+// kMigrateChunk slots across. Migrated slots are sealed so no writer can
+// touch them again. Lookups read the old table first, then the new one.
+// The old table is retired once its last chunk has moved. Writes into
+// the new table hold off while it has no room to spare for the nodes
+// still to come, so the move never runs out of slots.
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>>
+class HashMap : public detail::CacheAligned {
+public:
+    // Slots moved to the new table per write while a resize is running.
+    static constexpr size_t kMigrateChunk = 64;
+    static constexpr size_t kLockStripes = 64;
+
+    // Sized so that expected_size entries fit without a resize.
+    explicit HashMap(size_t expected_size = 0, const Hash& hash = Hash(),
+                     const KeyEqual& equal = KeyEqual())
+        : hash_(hash), equal_(equal), size_(0) {
+        root_.store(new Table(capacity_for(expected_size)),
+                    std::memory_order_release);
+    }
+
+    ~HashMap() {
+        Table* t = root_.load(std::memory_order_acquire);
+        while (t) {
+            for (size_t i = 0; i < t->capacity(); ++i) {
+                const uint64_t w = t->slots[i].load(std::memory_order_relaxed);
+                if (is_node(w)) {
+                    delete pointer(w);
+                }
+            }
+            Table* next = t->next.load(std::memory_order_relaxed);
+            delete t;
+            t = next;
+        }
+    }
+
+    HashMap(const HashMap&) = delete;
+    HashMap& operator=(const HashMap&) = delete;
+
+    // Copies the value out. Returns false if key is absent.
+    bool find(const K& key, V& value) const {
+        return visit(key, [&value](const V& v) { value = v; });
+    }
+
+    bool contains(const K& key) const {
+        return visit(key, [](const V&) {});
+    }
+
+    // Calls f(const V&) on the current value without copying it. The
+    // value stays valid for the duration of the call even if a writer
+    // replaces or erases it meanwhile.
+    template <typename F>
+    bool visit(const K& key, F&& f) const {
+        const uint64_t h = hash_of(key);
+        detail::HazardPointer hp_table, hp_node;
+        Table* t = hp_table.protect(root_);
+        Node* node = find_in(*t, h, key, hp_node);
+        if (node) {
+            f(static_cast<const V&>(node->value));
+            return true;
+        }
+        // Checked after the scan: a key missing from t was moved to, or
+        // inserted into, a successor installed before.
+        if (!t->next.load(std::memory_order_acquire)) {
+            return false;
+        }
+        return visit_resizing(h, key, f, hp_table, hp_node);
+    }
+
+    // Inserts if key is absent. Returns false, leaving the map
+    // unchanged, if it was present.
+    bool insert(const K& key, const V& value) {
+        const uint64_t h = hash_of(key);
+        std::unique_ptr<Node> node(new Node(h, key, value));
+        bool inserted = false;
+        write(h, key, [&](Table& t, const Probe& probe) {
+            if (probe.node) {
+                return Step::Done;
+            }
+            Step step = claim(t, probe, node.get());
+            if (step == Step::Done) {
+                node.release();
+                inserted = true;
+            }
+            return step;
+        });
+        return inserted;
+    }
+
+    // Returns true if key was inserted, false if its value was replaced.
+    bool insert_or_assign(const K& key, const V& value) {
+        const uint64_t h = hash_of(key);
+        std::unique_ptr<Node> node(new Node(h, key, value));
+        bool inserted = false;
+        write(h, key, [&](Table& t, const Probe& probe) {
+            if (probe.node) {
+                replace(t, probe, node.release());
+                return Step::Done;
+            }
+            Step step = claim(t, probe, node.get());
+            if (step == Step::Done) {
+                node.release();
+                inserted = true;
+            }
+            return step;
+        });
+        return inserted;
+    }
+
+    // Applies f(V&) to a copy of the value and publishes the result, so
+    // readers see either the old or the new value, never a torn one.
+    // Writers of the same key are serialized. Returns false if absent.
+    template <typename F>
+    bool update(const K& key, F f) {
+        const uint64_t h = hash_of(key);
+        bool updated = false;
+        write(h, key, [&](Table& t, const Probe& probe) {
+            if (probe.node) {
+                std::unique_ptr<Node> node(
+                    new Node(h, probe.node->key, probe.node->value));
+                f(node->value);
+                replace(t, probe, node.release());
+                updated = true;
+            }
+            return Step::Done;
+        });
+        return updated;
+    }
+
+    bool erase(const K& key) {
+        const uint64_t h = hash_of(key);
+        bool erased = false;
+        write(h, key, [&](Table& t, const Probe& probe) {
+            if (probe.node) {
+                t.slots[probe.index].store(kTombstone,
+                                           std::memory_order_release);
+                detail::hazard_retire(probe.node);
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                erased = true;
+            }
+            return Step::Done;
+        });
+        return erased;
+    }
+
+    // Approximate under concurrent writes.
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+    bool empty() const { return size() == 0; }
+
+    // Slots in the current table.
+    size_t capacity() const {
+        detail::HazardPointer hp;
+        return hp.protect(root_)->capacity();
+    }
+
+private:
+    struct Node {
+        const uint64_t hash;
+        const K key;
+        V value;
+
+        Node(uint64_t h, const K& k, const V& v) : hash(h), key(k), value(v) {}
+    };
+
+    struct Table : detail::CacheAligned {
+        explicit Table(size_t capacity)
+            : mask(capacity - 1),
+              slots(new std::atomic<uint64_t>[capacity]),
+              next(nullptr),
+              used(0),
+              migrate_next(0),
+              migrate_done(0) {
+            for (size_t i = 0; i < capacity; ++i) {
+                slots[i].store(kEmpty, std::memory_order_relaxed);
+            }
+        }
+
+        ~Table() { delete[] slots; }
+
+        size_t capacity() const { return mask + 1; }
+
+        const size_t mask;
+        std::atomic<uint64_t>* const slots;
+        // Set once, when a resize starts.
+        std::atomic<Table*> next;
+        // Slots ever claimed from kEmpty; tombstones keep counting.
+        alignas(64) std::atomic<size_t> used;
+        alignas(64) std::atomic<size_t> migrate_next;
+        std::atomic<size_t> migrate_done;
+    };
+
+    struct alignas(64) Stripe {
+        std::atomic<bool> locked;
+
+        Stripe() : locked(false) {}
+
+        void lock() {
+            Backoff backoff{BackoffPolicy()};
+            while (locked.exchange(true, std::memory_order_acquire)) {
+                do {
+                    backoff.pause();
+                } while (locked.load(std::memory_order_relaxed));
+            }
+        }
+
+        void unlock() { locked.store(false, std::memory_order_release); }
+    };
+
+    // Where a key is, or where it would go, in one table.
+    struct Probe {
+        Node* node;          // The key's node, or null if absent.
+        size_t index;        // Its slot.
+        size_t free;         // First claimable slot, or npos.
+        uint64_t free_word;  // What that slot held: kEmpty or kTombstone.
+    };
+
+    enum class Status { Found, Absent, Sealed };
+    enum class Step { Done, Rescan, Restart };
+
+    // Slot words. Anything else is a node pointer with a hash tag on top.
+    static constexpr uint64_t kEmpty = 0;
+    static constexpr uint64_t kTombstone = 1;
+    // Sealed by a resize: held a node or tombstone, or was empty. Only
+    // kMovedEmpty still ends a probe sequence.
+    static constexpr uint64_t kMoved = 2;
+    static constexpr uint64_t kMovedEmpty = 3;
+
+    // User-space addresses fit in 48 bits on x86-64 and AArch64.
+    static constexpr unsigned kTagShift = sizeof(void*) == 8 ? 48 : 32;
+    static constexpr uint64_t kPointerMask = (uint64_t(1) << kTagShift) - 1;
+    static constexpr size_t kMinCapacity = kMigrateChunk;
+    static constexpr size_t npos = ~size_t(0);
+
+    static bool is_node(uint64_t w) { return w > kMovedEmpty; }
+
+    static Node* pointer(uint64_t w) {
+        return reinterpret_cast<Node*>(static_cast<uintptr_t>(w & kPointerMask));
+    }
+
+    static uint64_t tag(uint64_t h) { return h >> kTagShift; }
+
+    static uint64_t pack(Node* node) {
+        return (tag(node->hash) << kTagShift) |
+               static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node));
+    }
+
+    static size_t capacity_for(size_t entries) {
+        size_t capacity = kMinCapacity;
+        while (capacity < entries * 4) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    uint64_t hash_of(const K& key) const {
+        // std::hash is the identity for integers; mix so that both the
+        // low bits (slot) and the high bits (tag, stripe) vary.
+        uint64_t h = static_cast<uint64_t>(hash_(key));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    Stripe& stripe(uint64_t h) { return stripes_[(h >> 40) % kLockStripes]; }
+
+    // visit() across a resize: the key may be in any table from the
+    // root on.
+    template <typename F>
+    bool visit_resizing(uint64_t h, const K& key, F& f,
+                        detail::HazardPointer& hp_first,
+                        detail::HazardPointer& hp_node) const {
+        detail::HazardPointer hp_second;
+        for (;;) {
+            detail::HazardPointer* hp_table = &hp_first;
+            detail::HazardPointer* hp_next = &hp_second;
+            Table* t = hp_table->protect(root_);
+            for (;;) {
+                Node* node = find_in(*t, h, key, hp_node);
+                if (node) {
+                    f(static_cast<const V&>(node->value));
+                    return true;
+                }
+                Table* next = t->next.load(std::memory_order_acquire);
+                if (!next) {
+                    return false;
+                }
+                hp_next->set(next);
+                Table* root = root_.load(std::memory_order_acquire);
+                if (root != t && root != next) {
+                    break;  // next may already be retired
+                }
+                t = next;
+                std::swap(hp_table, hp_next);
+            }
+        }
+    }
+
+    // Lock-free probe for readers.
+    Node* find_in(const Table& t, uint64_t h, const K& key,
+                  detail::HazardPointer& hp) const {
+        size_t i = h & t.mask;
+        for (size_t probed = 0; probed <= t.mask;) {
+            const uint64_t w = t.slots[i].load(std::memory_order_acquire);
+            if (w == kEmpty || w == kMovedEmpty) {
+                return nullptr;
+            }
+            if (is_node(w) && tag(w) == tag(h)) {
+                Node* node = pointer(w);
+                hp.set(node);
+                if (t.slots[i].load(std::memory_order_acquire) != w) {
+                    continue;  // Changed under us; look at it again.
+                }
+                if (node->hash == h && equal_(node->key, key)) {
+                    return node;
+                }
+            }
+            i = (i + 1) & t.mask;
+            ++probed;
+        }
+        return nullptr;
+    }
+
+    // Same probe for writers holding key's stripe, also noting the first
+    // claimable slot. The key's node cannot change while the stripe is
+    // held; every other slot still can.
+    Status locate(const Table& t, uint64_t h, const K& key,
+                  detail::HazardPointer& hp, Probe& probe) const {
+        probe.node = nullptr;
+        probe.free = npos;
+        size_t i = h & t.mask;
+        for (size_t probed = 0; probed <= t.mask;) {
+            const uint64_t w = t.slots[i].load(std::memory_order_acquire);
+            if (w == kMoved || w == kMovedEmpty) {
+                return Status::Sealed;
+            }
+            if (w == kEmpty || w == kTombstone) {
+                if (probe.free == npos) {
+                    probe.free = i;
+                    probe.free_word = w;
+                }
+                if (w == kEmpty) {
+                    return Status::Absent;
+                }
+            } else if (tag(w) == tag(h)) {
+                Node* node = pointer(w);
+                hp.set(node);
+                if (t.slots[i].load(std::memory_order_acquire) != w) {
+                    continue;
+                }
+                if (node->hash == h && equal_(node->key, key)) {
+                    probe.node = node;
+                    probe.index = i;
+                    return Status::Found;
+                }
+            }
+            i = (i + 1) & t.mask;
+            ++probed;
+        }
+        return Status::Absent;
+    }
+
+    // Runs op(table, probe) under key's stripe on the table that owns
+    // key, after helping any resize along. op returns Rescan after losing
+    // a slot claim to another stripe and Restart if the table cannot take
+    // the key.
+    template <typename Op>
+    void write(uint64_t h, const K& key, Op op) {
+        detail::HazardPointer hp_table, hp_next, hp_node;
+        Backoff backoff{BackoffPolicy()};
+        for (;;) {
+            Table* t = hp_table.protect(root_);
+            Table* next = t->next.load(std::memory_order_acquire);
+            if (next) {
+                // Helping takes stripes, so it happens before we hold ours.
+                if (migrate_chunk(t, next, hp_node)) {
+                    continue;
+                }
+                hp_next.set(next);
+                if (root_.load(std::memory_order_acquire) != t) {
+                    continue;
+                }
+                if (!has_room(*t, *next)) {
+                    // Every chunk is taken; wait for their movers
+                    // rather than fill the slots their nodes need.
+                    backoff.pause();
+                    continue;
+                }
+            } else if (t->used.load(std::memory_order_relaxed) * 2 >
+                       t->capacity()) {
+                start_resize(t);
+                continue;
+            }
+
+            std::lock_guard<Stripe> lock(stripe(h));
+            Table* target = t;
+            if (next) {
+                // Writers of a resizing map work in the new table only,
+                // so key's node moves there first.
+                if (!evacuate(*t, *next, h, key, hp_node)) {
+                    continue;
+                }
+                target = next;
+            }
+            for (;;) {
+                Probe probe;
+                if (locate(*target, h, key, hp_node, probe) == Status::Sealed) {
+                    break;
+                }
+                const Step step = op(*target, probe);
+                if (step == Step::Done) {
+                    return;
+                }
+                if (step == Step::Restart) {
+                    break;
+                }
+            }
+        }
+    }
+
+    Step claim(Table& t, const Probe& probe, Node* node) {
+        if (probe.free == npos) {
+            return Step::Restart;  // Full; the next pass resizes.
+        }
+        uint64_t expected = probe.free_word;
+        if (!t.slots[probe.free].compare_exchange_strong(
+                expected, pack(node), std::memory_order_acq_rel,
+                std::memory_order_relaxed)) {
+            return Step::Rescan;
+        }
+        if (probe.free_word == kEmpty) {
+            t.used.fetch_add(1, std::memory_order_relaxed);
+        }
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return Step::Done;
+    }
+
+    void replace(Table& t, const Probe& probe, Node* node) {
+        t.slots[probe.index].store(pack(node), std::memory_order_release);
+        detail::hazard_retire(probe.node);
+    }
+
+    // The successor is never smaller than t: a table that filled up with
+    // tombstones is rebuilt at its own size, since the writes that go on
+    // during the move land in the successor too.
+    void start_resize(Table* t) {
+        const size_t entries = std::max(
+            size_.load(std::memory_order_relaxed) + 1, t->capacity() / 4);
+        Table* next = new Table(capacity_for(entries));
+        Table* expected = nullptr;
+        if (!t->next.compare_exchange_strong(expected, next,
+                                             std::memory_order_acq_rel)) {
+            delete next;
+        }
+    }
+
+    // Moves one chunk of t into next. Returns true if that finished the
+    // resize and next is now the root.
+    bool migrate_chunk(Table* t, Table* next, detail::HazardPointer& hp) {
+        const size_t capacity = t->capacity();
+        const size_t begin =
+            t->migrate_next.fetch_add(kMigrateChunk, std::memory_order_relaxed);
+        if (begin >= capacity) {
+            return false;
+        }
+        for (size_t i = begin; i < begin + kMigrateChunk; ++i) {
+            seal(*t, *next, i, hp);
+        }
+        if (t->migrate_done.fetch_add(kMigrateChunk, std::memory_order_acq_rel) +
+                kMigrateChunk == capacity) {
+            root_.store(next, std::memory_order_release);
+            detail::hazard_retire(t);
+            return true;
+        }
+        return false;
+    }
+
+    // Moves slot i of t into next and seals it.
+    void seal(Table& t, Table& next, size_t i, detail::HazardPointer& hp) {
+        std::atomic<uint64_t>& slot = t.slots[i];
+        Backoff backoff{BackoffPolicy()};
+        for (;;) {
+            uint64_t w = slot.load(std::memory_order_acquire);
+            if (w == kMoved || w == kMovedEmpty) {
+                return;
+            }
+            if (!is_node(w)) {
+                if (slot.compare_exchange_strong(
+                        w, w == kEmpty ? kMovedEmpty : kMoved,
+                        std::memory_order_acq_rel)) {
+                    return;
+                }
+                continue;
+            }
+            Node* node = pointer(w);
+            hp.set(node);
+            if (slot.load(std::memory_order_acquire) != w) {
+                continue;
+            }
+            {
+                std::lock_guard<Stripe> lock(stripe(node->hash));
+                if (slot.load(std::memory_order_acquire) != w) {
+                    continue;
+                }
+                if (move(slot, next, node)) {
+                    return;
+                }
+            }
+            // next is full. The slot stays unsealed, with its node, until
+            // an erase in next makes room.
+            backoff.pause();
+        }
+    }
+
+    // Whether next can take another write from outside the resize and
+    // still hold every node left in t. t.used bounds those nodes.
+    static bool has_room(const Table& t, const Table& next) {
+        return next.used.load(std::memory_order_relaxed) +
+                   t.used.load(std::memory_order_relaxed) <
+               next.capacity();
+    }
+
+    // Moves key's node, if t still has it, into next. Caller holds the
+    // key's stripe. Returns false if next turned out to be sealed too, or
+    // full.
+    bool evacuate(Table& t, Table& next, uint64_t h, const K& key,
+                  detail::HazardPointer& hp) {
+        size_t i = h & t.mask;
+        for (size_t probed = 0; probed <= t.mask;) {
+            const uint64_t w = t.slots[i].load(std::memory_order_acquire);
+            if (w == kEmpty || w == kMovedEmpty) {
+                return true;
+            }
+            if (is_node(w) && tag(w) == tag(h)) {
+                Node* node = pointer(w);
+                hp.set(node);
+                if (t.slots[i].load(std::memory_order_acquire) != w) {
+                    continue;
+                }
+                if (node->hash == h && equal_(node->key, key)) {
+                    return move(t.slots[i], next, node);
+                }
+            }
+            i = (i + 1) & t.mask;
+            ++probed;
+        }
+        return true;
+    }
+
+    // Links node into next, then seals its old slot. Readers that find
+    // the slot sealed go on to next and find the node there. Returns
+    // false, leaving the slot alone, if next is sealed or full; write()
+    // stops filling next before it runs out of room for t's nodes.
+    bool move(std::atomic<uint64_t>& from, Table& next, Node* node) {
+        size_t i = node->hash & next.mask;
+        for (size_t probed = 0; probed <= next.mask;) {
+            uint64_t w = next.slots[i].load(std::memory_order_acquire);
+            if (w == kMoved || w == kMovedEmpty) {
+                return false;
+            }
+            if (w == kEmpty || w == kTombstone) {
+                if (next.slots[i].compare_exchange_strong(
+                        w, pack(node), std::memory_order_acq_rel)) {
+                    if (w == kEmpty) {
+                        next.used.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    from.store(kMoved, std::memory_order_release);
+                    return true;
+                }
+                continue;
+            }
+            i = (i + 1) & next.mask;
+            ++probed;
+        }
+        return false;
+    }
+
+    const Hash hash_;
+    const KeyEqual equal_;
+    std::atomic<Table*> root_;
+    alignas(64) std::atomic<size_t> size_;
+    Stripe stripes_[kLockStripes];
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_HASH_MAP_HPP
@@ -0,0 +1,254 @@
+#ifndef LOCKFREE_HAZARD_POINTER_HPP
+#define LOCKFREE_HAZARD_POINTER_HPP
+
+#include "cache_aligned.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace lockfree {
+namespace detail {
+
+// Hazard pointer domain shared by every lock-free structure in the
+// library. A node unlinked by one thread is retired instead of deleted
+// and only freed once no thread has it published in a hazard slot.
+class HazardDomain {
+public:
+    static constexpr size_t kSlotsPerRecord = 8;
+
+    struct alignas(64) Record : CacheAligned {
+        std::atomic<const void*> slots[kSlotsPerRecord];
+        std::atomic<bool> active;
+        Record* next;
+
+        Record() : active(true), next(nullptr) {
+            for (auto& slot : slots) {
+                slot.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+    };
+
+    // Leaked on purpose: retired nodes may outlive every static object.
+    static HazardDomain& instance() {
+        static HazardDomain* domain = new HazardDomain;
+        return *domain;
+    }
+
+    Record* acquire_record() {
+        for (Record* r = records_.load(std::memory_order_acquire); r;
+             r = r->next) {
+            bool expected = false;
+            if (!r->active.load(std::memory_order_relaxed) &&
+                r->active.compare_exchange_strong(expected, true,
+                                                  std::memory_order_acquire)) {
+                return r;
+            }
+        }
+        Record* r = new Record;
+        Record* head = records_.load(std::memory_order_relaxed);
+        do {
+            r->next = head;
+        } while (!records_.compare_exchange_weak(head, r,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+        record_count_.fetch_add(1, std::memory_order_relaxed);
+        return r;
+    }
+
+    void release_record(Record* r) {
+        for (auto& slot : r->slots) {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+        r->active.store(false, std::memory_order_release);
+    }
+
+    size_t scan_threshold() const {
+        return 2 * kSlotsPerRecord *
+               record_count_.load(std::memory_order_relaxed) + 64;
+    }
+
+    // Frees every entry of retired that is not currently hazardous and
+    // leaves the rest in place.
+    void scan(std::vector<Retired>& retired) {
+        adopt_orphans(retired);
+
+        std::vector<const void*> hazards;
+        for (Record* r = records_.load(std::memory_order_acquire); r;
+             r = r->next) {
+            for (auto& slot : r->slots) {
+                const void* p = slot.load(std::memory_order_seq_cst);
+                if (p) {
+                    hazards.push_back(p);
+                }
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        size_t kept = 0;
+        for (size_t i = 0; i < retired.size(); ++i) {
+            if (std::binary_search(hazards.begin(), hazards.end(),
+                                   static_cast<const void*>(retired[i].ptr))) {
+                retired[kept++] = retired[i];
+            } else {
+                retired[i].deleter(retired[i].ptr);
+            }
+        }
+        retired.resize(kept);
+    }
+
+    // Called from exiting threads whose nodes are still protected.
+    void orphan(std::vector<Retired>& retired) {
+        if (retired.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(orphans_mutex_);
+        orphans_.insert(orphans_.end(), retired.begin(), retired.end());
+        has_orphans_.store(true, std::memory_order_release);
+        retired.clear();
+    }
+
+private:
+    HazardDomain() : records_(nullptr), record_count_(0), has_orphans_(false) {}
+
+    void adopt_orphans(std::vector<Retired>& retired) {
+        if (!has_orphans_.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(orphans_mutex_, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return;
+        }
+        retired.insert(retired.end(), orphans_.begin(), orphans_.end());
+        orphans_.clear();
+        has_orphans_.store(false, std::memory_order_relaxed);
+    }
+
+    std::atomic<Record*> records_;
+    std::atomic<size_t> record_count_;
+    std::atomic<bool> has_orphans_;
+    std::mutex orphans_mutex_;
+    std::vector<Retired> orphans_;
+};
+
+// Per-thread hazard records and retire list.
+class HazardThreadState {
+public:
+    static HazardThreadState& local() {
+        static thread_local HazardThreadState state;
+        return state;
+    }
+
+    std::atomic<const void*>* acquire_slot() {
+        for (size_t i = 0; i < records_.size(); ++i) {
+            if (~used_[i] & kAllSlots) {
+                unsigned bit = 0;
+                while (used_[i] & (1u << bit)) {
+                    ++bit;
+                }
+                used_[i] |= 1u << bit;
+                return &records_[i]->slots[bit];
+            }
+        }
+        // Nested guards exhausted the current records; take another one.
+        records_.push_back(HazardDomain::instance().acquire_record());
+        used_.push_back(1u);
+        return &records_.back()->slots[0];
+    }
+
+    void release_slot(std::atomic<const void*>* slot) {
+        slot->store(nullptr, std::memory_order_release);
+        for (size_t i = 0; i < records_.size(); ++i) {
+            std::atomic<const void*>* first = &records_[i]->slots[0];
+            if (slot >= first && slot < first + HazardDomain::kSlotsPerRecord) {
+                used_[i] &= ~(1u << (slot - first));
+                return;
+            }
+        }
+    }
+
+    void retire(void* ptr, void (*deleter)(void*)) {
+        HazardDomain::Retired r = {ptr, deleter};
+        retired_.push_back(r);
+        HazardDomain& domain = HazardDomain::instance();
+        if (retired_.size() >= domain.scan_threshold()) {
+            domain.scan(retired_);
+        }
+    }
+
+    void reclaim() { HazardDomain::instance().scan(retired_); }
+
+    ~HazardThreadState() {
+        HazardDomain& domain = HazardDomain::instance();
+        for (auto* r : records_) {
+            domain.release_record(r);
+        }
+        domain.scan(retired_);
+        domain.orphan(retired_);
+    }
+
+private:
+    static constexpr unsigned kAllSlots =
+        (1u << HazardDomain::kSlotsPerRecord) - 1;
+
+    HazardThreadState() {}
+
+    std::vector<HazardDomain::Record*> records_;
+    std::vector<unsigned> used_;
+    std::vector<HazardDomain::Retired> retired_;
+};
+
+// RAII hazard slot. protect() publishes a pointer loaded from src and
+// re-validates it, after which the pointee cannot be freed until the
+// slot is reset or the guard goes out of scope.
+class HazardPointer {
+public:
+    HazardPointer() : slot_(HazardThreadState::local().acquire_slot()) {}
+    ~HazardPointer() { HazardThreadState::local().release_slot(slot_); }
+
+    HazardPointer(const HazardPointer&) = delete;
+    HazardPointer& operator=(const HazardPointer&) = delete;
+
+    template <typename T>
+    T* protect(const std::atomic<T*>& src) {
+        T* p = src.load(std::memory_order_relaxed);
+        for (;;) {
+            slot_->store(p, std::memory_order_seq_cst);
+            T* q = src.load(std::memory_order_acquire);
+            if (q == p) {
+                return p;
+            }
+            p = q;
+        }
+    }
+
+    // Publishes p without validation; the caller re-checks whatever
+    // guarantees p is still reachable.
+    void set(const void* p) { slot_->store(p, std::memory_order_seq_cst); }
+    void reset() { slot_->store(nullptr, std::memory_order_release); }
+
+private:
+    std::atomic<const void*>* slot_;
+};
+
+template <typename T>
+void hazard_retire(T* ptr) {
+    HazardThreadState::local().retire(
+        ptr, [](void* p) { delete static_cast<T*>(p); });
+}
+
+// Frees whatever the calling thread has retired and nobody protects.
+inline void hazard_reclaim() {
+    HazardThreadState::local().reclaim();
+}
+
+} // namespace detail
+} // namespace lockfree
+
+#endif // LOCKFREE_HAZARD_POINTER_HPP
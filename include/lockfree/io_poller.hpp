@@ -0,0 +1,46 @@
+#ifndef LOCKFREE_IO_POLLER_HPP
+#define LOCKFREE_IO_POLLER_HPP
+
+#include "task.hpp"
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace lockfree {
+namespace detail {
+
+// An AsyncIo as the workers of its ThreadPool see it: a source of
+// completion tasks they reap on their idle path, next to the timers, and
+// possibly something one idle worker can block in instead of parking.
+class IoPoller {
+public:
+    virtual ~IoPoller() {}
+
+    // Appends up to max completion tasks to out, which must have room
+    // for them, and submits operations queued for a worker. Any thread
+    // may call it; concurrent callers return 0 rather than wait.
+    virtual size_t reap(std::vector<Task>& out, size_t max) = 0;
+
+    // Completions or submissions waiting for a reap().
+    virtual bool ready() const = 0;
+
+    // Operations are in flight and no worker is blocked waiting for
+    // them, so an idle worker should come and take that role.
+    virtual bool needs_waiter() const = 0;
+
+    // Claims the waiter role; false if the backend cannot wait, nothing
+    // is in flight or another worker already waits. A successful claim
+    // is followed by wait_until(), unless the caller finds work first,
+    // and then by end_wait().
+    virtual bool begin_wait() = 0;
+    virtual void wait_until(std::chrono::steady_clock::time_point deadline) = 0;
+    virtual void end_wait() = 0;
+
+    // Cuts the current waiter's wait short.
+    virtual void wake() = 0;
+};
+
+} // namespace detail
+} // namespace lockfree
+
+#endif // LOCKFREE_IO_POLLER_HPP
@@ -0,0 +1,142 @@
+#ifndef LOCKFREE_JOB_DEQUE_HPP
+#define LOCKFREE_JOB_DEQUE_HPP
+
+#include "exceptions.hpp"
+#include "task.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+namespace lockfree {
+namespace detail {
+
+// Completion state of one TaskGroup, shared with its jobs.
+struct JobGroup {
+    std::atomic<size_t> pending{0};
+    std::atomic<bool> failed{false};
+    // Written once, by the first job to fail, before its pending
+    // decrement; read by sync() after pending reaches zero.
+    std::exception_ptr error;
+
+    void fail(std::exception_ptr e) {
+        if (!failed.exchange(true, std::memory_order_relaxed)) {
+            error = e;
+        }
+    }
+};
+
+// A child spawned by TaskGroup::spawn(). Lives in the group's own
+// storage, never on the heap, and only its address travels through the
+// deques.
+struct Job {
+    Task fn;
+    JobGroup* group = nullptr;
+
+    void run() {
+        LOCKFREE_TRY {
+            fn();
+        } LOCKFREE_CATCH_ALL {
+            group->fail(std::current_exception());
+        }
+        fn = nullptr;
+        group->pending.fetch_sub(1, std::memory_order_release);
+    }
+};
+
+// Chase-Lev work-stealing deque of fixed capacity, in the C11 form of
+// Le et al. (PPoPP'13). The owning worker pushes and pops at the bottom,
+// newest first; thieves take from the top, oldest first, which for a
+// recursive spawn tree are the biggest pieces of work. Slots hold only
+// pointers, so a thief racing the owner never sees a torn element.
+class JobDeque {
+public:
+    static constexpr int64_t kCapacity = 512;
+
+    JobDeque() : top_(0), bottom_(0) {
+        for (auto& slot : slots_) {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    JobDeque(const JobDeque&) = delete;
+    JobDeque& operator=(const JobDeque&) = delete;
+
+    // Owner only. False when full; the caller runs the job itself.
+    bool push(Job* job) {
+        const int64_t b = bottom_.load(std::memory_order_relaxed);
+        const int64_t t = top_.load(std::memory_order_acquire);
+        if (b - t >= kCapacity) {
+            return false;
+        }
+        slots_[b & (kCapacity - 1)].store(job, std::memory_order_relaxed);
+        // A release store rather than the paper's fence: same code on
+        // x86, and visible to ThreadSanitizer.
+        bottom_.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner only: the newest job, if it belongs to group. Jobs of an
+    // enclosing group further down are left for that group's sync().
+    Job* pop(const JobGroup* group) {
+        const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        if (b < top_.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        // Thieves never write slots, so peeking before the claim is safe.
+        Job* job = slots_[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+        if (job->group != group) {
+            return nullptr;
+        }
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        if (t == b) {
+            // Last job: race the thieves for it.
+            if (!top_.compare_exchange_strong(t, t + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                job = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // Any thread. Null if empty or another thief won the race.
+    Job* steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        Job* job = slots_[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(t, t + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return job;
+    }
+
+    bool empty() const {
+        return bottom_.load(std::memory_order_acquire) <=
+               top_.load(std::memory_order_acquire);
+    }
+
+private:
+    // Thieves CAS top_, the owner moves bottom_.
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    alignas(64) std::atomic<Job*> slots_[kCapacity];
+};
+
+} // namespace detail
+} // namespace lockfree
+
+#endif // LOCKFREE_JOB_DEQUE_HPP
@@ -0,0 +1,369 @@
+#ifndef LOCKFREE_OBJECT_POOL_HPP
+#define LOCKFREE_OBJECT_POOL_HPP
+
+#include "backoff.hpp"
+#include "cache_aligned.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace lockfree {
+namespace detail {
+
+// Treiber stack whose head carries a modification tag in the pointer's
+// unused high bits, so a pop that raced with pop/push/pop of the same
+// node fails its CAS instead of installing a stale next. Nodes must stay
+// allocated while any thread may still be popping; the tag only guards
+// against reuse, not against reclamation.
+template <typename Node>
+class TaggedStack {
+public:
+    TaggedStack() : head_(0) {}
+
+    TaggedStack(const TaggedStack&) = delete;
+    TaggedStack& operator=(const TaggedStack&) = delete;
+
+    void push(Node* node) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t desired;
+        do {
+            node->next.store(pointer(head), std::memory_order_relaxed);
+            desired = pack(node, tag(head) + 1);
+        } while (!head_.compare_exchange_weak(head, desired,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    Node* pop() {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        Backoff backoff{BackoffPolicy()};
+        for (;;) {
+            Node* node = pointer(head);
+            if (!node) {
+                return nullptr;
+            }
+            // May read the next of a node another thread has already
+            // popped; the tag makes the CAS below fail in that case.
+            Node* next = node->next.load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, pack(next, tag(head) + 1),
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+                return node;
+            }
+            backoff.pause();
+        }
+    }
+
+private:
+    // User-space addresses fit in 48 bits on x86-64 and AArch64.
+    static constexpr unsigned kTagShift = sizeof(void*) == 8 ? 48 : 32;
+    static constexpr uint64_t kPointerMask = (uint64_t(1) << kTagShift) - 1;
+
+    static Node* pointer(uint64_t word) {
+        return reinterpret_cast<Node*>(
+            static_cast<uintptr_t>(word & kPointerMask));
+    }
+
+    static uint64_t tag(uint64_t word) { return word >> kTagShift; }
+
+    static uint64_t pack(Node* node, uint64_t tag) {
+        return (tag << kTagShift) |
+               static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node));
+    }
+
+    alignas(64) std::atomic<uint64_t> head_;
+};
+
+// Live pool ids. Pools register here so an exiting thread can tell
+// whether the pool behind each of its caches still exists. Leaked on
+// purpose: thread_local tables may be destroyed after every static.
+class PoolRegistry {
+public:
+    static PoolRegistry& instance() {
+        static PoolRegistry* registry = new PoolRegistry;
+        return *registry;
+    }
+
+    uint64_t add() {
+        std::lock_guard<std::mutex> lock(mutex);
+        const uint64_t id = ++last_id_;
+        live.insert(id);
+        return id;
+    }
+
+    void remove(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        live.erase(id);
+    }
+
+    std::mutex mutex;
+    std::unordered_set<uint64_t> live;
+
+private:
+    PoolRegistry() : last_id_(0) {}
+
+    uint64_t last_id_;
+};
+
+// Per-thread map from pool id to that thread's cache in the pool. Ids are
+// never reused, so an entry for a destroyed pool simply never matches
+// again and is pruned the next time this thread attaches to a pool.
+class PoolThreadTable {
+public:
+    typedef void (*DetachFn)(void* pool, void* cache);
+
+    static PoolThreadTable& local() {
+        static thread_local PoolThreadTable table;
+        return table;
+    }
+
+    void* find(uint64_t id) const {
+        for (const Entry& e : entries_) {
+            if (e.id == id) {
+                return e.cache;
+            }
+        }
+        return nullptr;
+    }
+
+    void add(uint64_t id, void* pool, void* cache, DetachFn detach) {
+        PoolRegistry& registry = PoolRegistry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        size_t kept = 0;
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            if (registry.live.count(entries_[i].id)) {
+                entries_[kept++] = entries_[i];
+            }
+        }
+        entries_.resize(kept);
+        Entry e = {id, pool, cache, detach};
+        entries_.push_back(e);
+    }
+
+    // Holding the registry lock keeps each live pool from being destroyed
+    // while its cache is handed back.
+    ~PoolThreadTable() {
+        PoolRegistry& registry = PoolRegistry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const Entry& e : entries_) {
+            if (registry.live.count(e.id)) {
+                e.detach(e.pool, e.cache);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        uint64_t id;
+        void* pool;
+        void* cache;
+        DetachFn detach;
+    };
+
+    PoolThreadTable() {}
+
+    std::vector<Entry> entries_;
+};
+
+} // namespace detail
+
+// Concurrent pool of reusable T objects, for things that are expensive
+// to build (buffers, parser state) and cycle between threads.
+//
+// Each thread keeps two magazines of up to kMagazineSize idle objects
+// and serves acquire/release from them without touching shared memory.
+// Only when both are empty (or full) does it trade a whole magazine with
+// the global depot, a pair of tagged-pointer Treiber stacks of full and
+// empty magazines, so depot traffic is one CAS per kMagazineSize
+// operations. When the depot is empty acquire() falls back to new T().
+//
+// Objects are handed back as they were released; callers reset any
+// state they care about. A pool must outlive every object taken from it,
+// and it deletes all idle objects when destroyed.
+template <typename T>
+class ObjectPool : public detail::CacheAligned {
+public:
+    static constexpr size_t kMagazineSize = 32;
+
+    // max_cached bounds the idle objects held by the depot; releases that
+    // would exceed it delete a magazine's worth of objects instead. Each
+    // thread may hold up to 2 * kMagazineSize more. 0 means unbounded.
+    explicit ObjectPool(size_t max_cached = 0)
+        : max_cached_(max_cached),
+          cached_(0),
+          caches_(nullptr),
+          id_(detail::PoolRegistry::instance().add()) {}
+
+    ~ObjectPool() {
+        // After this no exiting thread will detach into the pool.
+        detail::PoolRegistry::instance().remove(id_);
+        while (Magazine* m = full_.pop()) {
+            destroy(m);
+        }
+        while (Magazine* m = empty_.pop()) {
+            delete m;
+        }
+        while (ThreadCache* c = caches_) {
+            caches_ = c->next;
+            destroy(c->loaded);
+            destroy(c->previous);
+            delete c;
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    T* acquire() {
+        ThreadCache& c = local();
+        if (c.loaded->count == 0) {
+            if (c.previous->count > 0) {
+                std::swap(c.loaded, c.previous);
+            } else if (Magazine* full = full_.pop()) {
+                cached_.fetch_sub(full->count, std::memory_order_relaxed);
+                empty_.push(c.previous);
+                c.previous = c.loaded;
+                c.loaded = full;
+            } else {
+                return new T();
+            }
+        }
+        return c.loaded->objects[--c.loaded->count];
+    }
+
+    void release(T* obj) {
+        if (!obj) {
+            return;
+        }
+        ThreadCache& c = local();
+        if (c.loaded->count == kMagazineSize) {
+            if (c.previous->count < kMagazineSize) {
+                std::swap(c.loaded, c.previous);
+            } else {
+                publish(c.previous);
+                c.previous = c.loaded;
+                c.loaded = take_empty();
+            }
+        }
+        c.loaded->objects[c.loaded->count++] = obj;
+    }
+
+    // Idle objects in the depot; per-thread magazines are not counted.
+    size_t cached() const {
+        return cached_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Magazine {
+        std::atomic<Magazine*> next;
+        size_t count;
+        T* objects[kMagazineSize];
+
+        Magazine() : next(nullptr), count(0) {}
+    };
+
+    struct alignas(64) ThreadCache : detail::CacheAligned {
+        Magazine* loaded;
+        Magazine* previous;
+        ThreadCache* next;
+        bool in_use;
+    };
+
+    ThreadCache& local() {
+        void* cache = detail::PoolThreadTable::local().find(id_);
+        if (!cache) {
+            cache = attach();
+        }
+        return *static_cast<ThreadCache*>(cache);
+    }
+
+    // First use of the pool on this thread: reuse the cache of an exited
+    // thread if there is one.
+    ThreadCache* attach() {
+        ThreadCache* cache = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(caches_mutex_);
+            for (ThreadCache* c = caches_; c; c = c->next) {
+                if (!c->in_use) {
+                    cache = c;
+                    break;
+                }
+            }
+            if (!cache) {
+                cache = new ThreadCache();
+                cache->next = caches_;
+                caches_ = cache;
+            }
+            cache->in_use = true;
+        }
+        cache->loaded = take_empty();
+        cache->previous = take_empty();
+        // Not under caches_mutex_: add() takes the registry lock, which
+        // the thread-exit path holds while calling detach().
+        detail::PoolThreadTable::local().add(id_, this, cache, &detach);
+        return cache;
+    }
+
+    // Called with the registry lock held as the owning thread exits.
+    static void detach(void* pool, void* cache) {
+        ObjectPool* self = static_cast<ObjectPool*>(pool);
+        ThreadCache* c = static_cast<ThreadCache*>(cache);
+        self->publish(c->loaded);
+        self->publish(c->previous);
+        c->loaded = nullptr;
+        c->previous = nullptr;
+        std::lock_guard<std::mutex> lock(self->caches_mutex_);
+        c->in_use = false;
+    }
+
+    // Hands a magazine to the depot, or frees its objects if that would
+    // take the depot over max_cached_.
+    void publish(Magazine* m) {
+        if (m->count == 0) {
+            empty_.push(m);
+            return;
+        }
+        const size_t before = cached_.fetch_add(m->count,
+                                                std::memory_order_relaxed);
+        if (max_cached_ && before + m->count > max_cached_) {
+            cached_.fetch_sub(m->count, std::memory_order_relaxed);
+            while (m->count) {
+                delete m->objects[--m->count];
+            }
+            empty_.push(m);
+            return;
+        }
+        full_.push(m);
+    }
+
+    Magazine* take_empty() {
+        Magazine* m = empty_.pop();
+        return m ? m : new Magazine();
+    }
+
+    static void destroy(Magazine* m) {
+        if (!m) {
+            return;
+        }
+        while (m->count) {
+            delete m->objects[--m->count];
+        }
+        delete m;
+    }
+
+    detail::TaggedStack<Magazine> full_;
+    detail::TaggedStack<Magazine> empty_;
+    const size_t max_cached_;
+    alignas(64) std::atomic<size_t> cached_;
+    std::mutex caches_mutex_;
+    ThreadCache* caches_;
+    const uint64_t id_;
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_OBJECT_POOL_HPP
@@ -0,0 +1,74 @@
+#ifndef LOCKFREE_PARKING_LOT_HPP
+#define LOCKFREE_PARKING_LOT_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace lockfree {
+namespace detail {
+
+// Address-keyed parking for blocking waits. Threads park on a bucket
+// selected by hashing the key, so a waitable object only needs an
+// atomic waiter count of its own instead of a mutex/condvar pair.
+class ParkingLot {
+public:
+    // Parks the caller while should_park() holds. should_park is evaluated
+    // under the bucket lock, so an unpark() issued after the waker's state
+    // change can never be lost.
+    template <typename Pred>
+    static void park(const void* key, Pred should_park) {
+        Bucket& b = bucket(key);
+        std::unique_lock<std::mutex> lock(b.mutex);
+        while (should_park()) {
+            b.cv.wait(lock);
+        }
+    }
+
+    // Same as park() but gives up at deadline. Returns false on timeout.
+    template <typename Pred, typename Clock, typename Duration>
+    static bool park_until(const void* key, Pred should_park,
+                           const std::chrono::time_point<Clock, Duration>& deadline) {
+        Bucket& b = bucket(key);
+        std::unique_lock<std::mutex> lock(b.mutex);
+        while (should_park()) {
+            if (b.cv.wait_until(lock, deadline) == std::cv_status::timeout) {
+                return !should_park();
+            }
+        }
+        return true;
+    }
+
+    // Wakes every thread parked on key. Buckets are shared between keys,
+    // so this is notify_all; waiters re-check their own predicate.
+    static void unpark_all(const void* key) {
+        Bucket& b = bucket(key);
+        {
+            std::lock_guard<std::mutex> lock(b.mutex);
+        }
+        b.cv.notify_all();
+    }
+
+private:
+    static constexpr size_t kBuckets = 64;
+
+    struct alignas(64) Bucket {
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+
+    static Bucket& bucket(const void* key) {
+        static Bucket buckets[kBuckets];
+        uintptr_t k = reinterpret_cast<uintptr_t>(key);
+        k ^= k >> 17;
+        k *= 0x9e3779b97f4a7c15ull;
+        return buckets[(k >> 32) % kBuckets];
+    }
+};
+
+} // namespace detail
+} // namespace lockfree
+
+#endif // LOCKFREE_PARKING_LOT_HPP
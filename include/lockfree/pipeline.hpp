@@ -0,0 +1,551 @@
+#ifndef LOCKFREE_PIPELINE_HPP
+#define LOCKFREE_PIPELINE_HPP
+
+#include "cache_aligned.hpp"
+#include "exceptions.hpp"
+#include "object_pool.hpp"
+#include "strand.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lockfree {
+
+// How a pipeline stage may run its items.
+enum class StageMode {
+    // One item at a time, in the order the source produced them.
+    SerialInOrder,
+    // One item at a time, in whatever order they arrive.
+    SerialOutOfOrder,
+    // Any number of items at once; the stage function must be
+    // thread-safe.
+    Parallel
+};
+
+// Handed to the source function; stop() ends the input. The value the
+// source returns on the call that stops is discarded.
+class FlowControl {
+public:
+    FlowControl() : stopped_(false) {}
+
+    void stop() { stopped_ = true; }
+    bool stopped() const { return stopped_; }
+
+private:
+    bool stopped_;
+};
+
+struct StageStats {
+    StageMode mode;
+    size_t items;
+    // Time spent inside the stage function, summed over all workers.
+    std::chrono::nanoseconds busy;
+    // busy / elapsed: the average number of workers in the stage. Near 1
+    // on a serial stage means it is the bottleneck.
+    double occupancy;
+    // Most items ever waiting to enter the stage.
+    size_t max_queued;
+};
+
+struct PipelineStats {
+    size_t items;
+    std::chrono::nanoseconds elapsed;
+    double items_per_second;
+    size_t max_in_flight;
+    // The source first, then every stage in order.
+    std::vector<StageStats> stages;
+};
+
+namespace detail {
+
+// A stage's current output, type-erased so that tokens can be reused
+// across stages of different types. Small values are stored inline.
+class PipelineValue {
+public:
+    static constexpr size_t kInlineSize = 48;
+
+    PipelineValue() : ptr_(nullptr), destroy_(nullptr) {}
+    ~PipelineValue() { reset(); }
+
+    PipelineValue(const PipelineValue&) = delete;
+    PipelineValue& operator=(const PipelineValue&) = delete;
+
+    template <typename T>
+    void emplace(T&& value) {
+        typedef typename std::decay<T>::type U;
+        reset();
+        construct<U>(std::forward<T>(value),
+                     std::integral_constant<bool,
+                         sizeof(U) <= kInlineSize &&
+                         alignof(U) <= alignof(std::max_align_t)>());
+    }
+
+    template <typename T>
+    T& get() { return *static_cast<T*>(ptr_); }
+
+    void reset() {
+        if (destroy_) {
+            destroy_(ptr_);
+            destroy_ = nullptr;
+            ptr_ = nullptr;
+        }
+    }
+
+private:
+    template <typename U, typename T>
+    void construct(T&& value, std::true_type /*fits inline*/) {
+        ptr_ = ::new (static_cast<void*>(&storage_)) U(std::forward<T>(value));
+        destroy_ = &destroy_inline<U>;
+    }
+
+    template <typename U, typename T>
+    void construct(T&& value, std::false_type /*fits inline*/) {
+        ptr_ = new U(std::forward<T>(value));
+        destroy_ = &destroy_boxed<U>;
+    }
+
+    template <typename U>
+    static void destroy_inline(void* p) { static_cast<U*>(p)->~U(); }
+
+    template <typename U>
+    static void destroy_boxed(void* p) { delete static_cast<U*>(p); }
+
+    typename std::aligned_storage<kInlineSize>::type storage_;
+    void* ptr_;
+    void (*destroy_)(void*);
+};
+
+// Owns everything a running pipeline touches; Pipeline and its builders
+// only hand it along.
+class PipelineCore : public CacheAligned {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Token {
+        std::atomic<Token*> next;
+        uint64_t seq;
+        bool cancelled;
+        PipelineValue value;
+
+        Token() : next(nullptr), seq(0), cancelled(false) {}
+    };
+
+    struct alignas(64) Stage : CacheAligned {
+        StageMode mode;
+        // Returns false if the item produced nothing (source stopped).
+        std::function<bool(PipelineValue&)> fn;
+        std::unique_ptr<Strand> strand;
+        // SerialInOrder only, owned by the strand: the next sequence to
+        // run and early arrivals parked at seq % max_tokens.
+        uint64_t next_seq;
+        std::vector<Token*> reorder;
+        std::atomic<size_t> items;
+        std::atomic<int64_t> busy_ns;
+        std::atomic<size_t> queued;
+        std::atomic<size_t> max_queued;
+
+        Stage() : mode(StageMode::Parallel), next_seq(0), items(0),
+                  busy_ns(0), queued(0), max_queued(0) {}
+    };
+
+    PipelineCore(ThreadPool& pool, size_t max_tokens)
+        : pool_(pool),
+          max_tokens_(max_tokens),
+          tokens_(max_tokens),
+          issued_(0),
+          input_done_(false),
+          outstanding_(0),
+          in_flight_(0),
+          max_in_flight_(0),
+          parked_(false),
+          failed_(false),
+          finished_(false) {
+        if (max_tokens == 0) {
+            raise(std::invalid_argument("Pipeline max_tokens must be > 0"));
+        }
+    }
+
+    void add_stage(StageMode mode, std::function<bool(PipelineValue&)> fn) {
+        stages_.emplace_back(new Stage);
+        Stage& stage = *stages_.back();
+        stage.mode = mode;
+        stage.fn = std::move(fn);
+        if (mode != StageMode::Parallel) {
+            stage.strand.reset(new Strand(pool_));
+        }
+        if (mode == StageMode::SerialInOrder) {
+            stage.reorder.assign(max_tokens_, nullptr);
+        }
+    }
+
+    PipelineStats run() {
+        reset();
+        const Clock::time_point start = Clock::now();
+        stages_[0]->strand->post([this] { pump(); });
+        {
+            std::unique_lock<std::mutex> lock(finish_mutex_);
+            finish_cv_.wait(lock, [this] { return finished_; });
+        }
+        const Clock::duration elapsed = Clock::now() - start;
+        // A strand whose task finished the run may still be unwinding its
+        // drain.
+        for (auto& stage : stages_) {
+            while (stage->strand && !stage->strand->idle()) {
+                std::this_thread::yield();
+            }
+        }
+        if (error_) {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+        return stats(elapsed);
+    }
+
+private:
+    void reset() {
+        while (free_.pop()) {
+        }
+        for (auto& token : tokens_) {
+            token.cancelled = false;
+            free_.push(&token);
+        }
+        for (auto& stage : stages_) {
+            stage->next_seq = 0;
+            stage->items.store(0, std::memory_order_relaxed);
+            stage->busy_ns.store(0, std::memory_order_relaxed);
+            stage->queued.store(0, std::memory_order_relaxed);
+            stage->max_queued.store(0, std::memory_order_relaxed);
+        }
+        issued_ = 0;
+        input_done_ = false;
+        // One for the source until it stops, one per item in flight.
+        outstanding_.store(1, std::memory_order_relaxed);
+        in_flight_.store(0, std::memory_order_relaxed);
+        max_in_flight_.store(0, std::memory_order_relaxed);
+        parked_.store(false, std::memory_order_relaxed);
+        failed_.store(false, std::memory_order_relaxed);
+        finished_ = false;
+    }
+
+    // Runs on the source's strand. Produces items while tokens are free;
+    // when they run out it parks and the next completion reschedules it.
+    void pump() {
+        Stage& source = *stages_[0];
+        for (size_t produced = 0; produced < max_tokens_; ++produced) {
+            if (input_done_) {
+                return;
+            }
+            if (failed_.load(std::memory_order_acquire)) {
+                finish_input();
+                return;
+            }
+            Token* token = free_.pop();
+            if (!token) {
+                parked_.store(true, std::memory_order_seq_cst);
+                token = free_.pop();
+                if (!token) {
+                    return;
+                }
+                // A completion may still repost us; the strand keeps the
+                // extra pump serial and it finds nothing to do.
+                parked_.store(false, std::memory_order_relaxed);
+            }
+            if (!invoke(source, *token)) {
+                token->value.reset();
+                free_.push(token);
+                finish_input();
+                return;
+            }
+            token->seq = issued_++;
+            outstanding_.fetch_add(1, std::memory_order_relaxed);
+            const size_t in_flight =
+                in_flight_.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (in_flight > max_in_flight_.load(std::memory_order_relaxed)) {
+                max_in_flight_.store(in_flight, std::memory_order_relaxed);
+            }
+            dispatch(1, token);
+        }
+        // Let other pool work in before producing the next round.
+        source.strand->post([this] { pump(); });
+    }
+
+    void finish_input() {
+        input_done_ = true;
+        release();
+    }
+
+    void dispatch(size_t index, Token* token) {
+        if (index == stages_.size()) {
+            complete(token);
+            return;
+        }
+        Stage& stage = *stages_[index];
+        const size_t queued =
+            stage.queued.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t max = stage.max_queued.load(std::memory_order_relaxed);
+        while (queued > max &&
+               !stage.max_queued.compare_exchange_weak(
+                   max, queued, std::memory_order_relaxed)) {
+        }
+        switch (stage.mode) {
+        case StageMode::Parallel:
+            pool_.post([this, index, token] { process(index, token); });
+            break;
+        case StageMode::SerialOutOfOrder:
+            stage.strand->post([this, index, token] { process(index, token); });
+            break;
+        case StageMode::SerialInOrder:
+            stage.strand->post([this, index, token] { reorder(index, token); });
+            break;
+        }
+    }
+
+    // In-flight sequences span less than max_tokens, so an early arrival's
+    // slot in the reorder ring is always free.
+    void reorder(size_t index, Token* token) {
+        Stage& stage = *stages_[index];
+        if (token->seq != stage.next_seq) {
+            stage.reorder[token->seq % max_tokens_] = token;
+            return;
+        }
+        for (;;) {
+            ++stage.next_seq;
+            process(index, token);
+            Token*& next = stage.reorder[stage.next_seq % max_tokens_];
+            if (!next) {
+                return;
+            }
+            token = next;
+            next = nullptr;
+        }
+    }
+
+    void process(size_t index, Token* token) {
+        Stage& stage = *stages_[index];
+        stage.queued.fetch_sub(1, std::memory_order_relaxed);
+        // After a failure items still flow, so that in-order stages see
+        // every sequence, but no more work is done on them.
+        if (!token->cancelled && !failed_.load(std::memory_order_relaxed)) {
+            invoke(stage, *token);
+        } else {
+            token->cancelled = true;
+        }
+        dispatch(index + 1, token);
+    }
+
+    bool invoke(Stage& stage, Token& token) {
+        bool produced = false;
+        const Clock::time_point begin = Clock::now();
+        LOCKFREE_TRY {
+            produced = stage.fn(token.value);
+        } LOCKFREE_CATCH_ALL {
+            if (!failed_.exchange(true)) {
+                error_ = std::current_exception();
+            }
+            token.cancelled = true;
+            produced = &stage != stages_[0].get();
+        }
+        stage.busy_ns.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - begin).count(),
+            std::memory_order_relaxed);
+        stage.items.fetch_add(1, std::memory_order_relaxed);
+        return produced;
+    }
+
+    void complete(Token* token) {
+        token->value.reset();
+        token->cancelled = false;
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        free_.push(token);
+        if (parked_.exchange(false, std::memory_order_seq_cst)) {
+            stages_[0]->strand->post([this] { pump(); });
+        }
+        release();
+    }
+
+    // Whoever drops outstanding_ to zero ends the run. Nothing touches
+    // the pipeline after its own decrement except through a strand,
+    // which run() waits out.
+    void release() {
+        if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            finish();
+        }
+    }
+
+    void finish() {
+        std::lock_guard<std::mutex> lock(finish_mutex_);
+        finished_ = true;
+        finish_cv_.notify_all();
+    }
+
+    PipelineStats stats(Clock::duration elapsed) const {
+        PipelineStats result;
+        result.items = static_cast<size_t>(issued_);
+        result.elapsed =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+        const double seconds =
+            std::chrono::duration<double>(elapsed).count();
+        result.items_per_second = seconds > 0 ? result.items / seconds : 0;
+        result.max_in_flight = max_in_flight_.load();
+        for (const auto& stage : stages_) {
+            StageStats s;
+            s.mode = stage->mode;
+            s.items = stage->items.load();
+            s.busy = std::chrono::nanoseconds(stage->busy_ns.load());
+            s.occupancy = result.elapsed.count() > 0
+                ? static_cast<double>(s.busy.count()) / result.elapsed.count()
+                : 0;
+            s.max_queued = stage->max_queued.load();
+            result.stages.push_back(s);
+        }
+        return result;
+    }
+
+    ThreadPool& pool_;
+    const size_t max_tokens_;
+    std::vector<std::unique_ptr<Stage>> stages_;
+    std::vector<Token> tokens_;
+    TaggedStack<Token> free_;
+    // Source-owned.
+    uint64_t issued_;
+    bool input_done_;
+    std::atomic<size_t> outstanding_;
+    std::atomic<size_t> in_flight_;
+    std::atomic<size_t> max_in_flight_;
+    std::atomic<bool> parked_;
+    std::atomic<bool> failed_;
+    std::exception_ptr error_;
+    std::mutex finish_mutex_;
+    std::condition_variable finish_cv_;
+    bool finished_;
+};
+
+} // namespace detail
+
+template <typename T>
+class PipelineBuilder;
+
+// A chain of stages run on a shared ThreadPool, after TBB's
+// parallel_pipeline. A serial source produces items; each stage maps an
+// item to the next stage's input and runs serially in order, serially
+// out of order, or in parallel. At most max_tokens items are in flight
+// at once, which bounds every inter-stage queue and the memory held by
+// items in transit.
+//
+//   lockfree::Pipeline pipeline = lockfree::Pipeline::source(pool, 64,
+//           [&](lockfree::FlowControl& fc) { ... return line; })
+//       .stage(lockfree::StageMode::Parallel, parse)
+//       .sink(lockfree::StageMode::SerialInOrder, aggregate);
+//   lockfree::PipelineStats stats = pipeline.run();
+//
+// Stages are tasks on the pool and never block a worker waiting for
+// input; serial stages run on their own Strand.
+class Pipeline {
+public:
+    // f(FlowControl&) returns the next item, or calls stop().
+    template <typename F>
+    static PipelineBuilder<typename std::decay<
+        typename std::result_of<F(FlowControl&)>::type>::type>
+    source(ThreadPool& pool, size_t max_tokens, F f);
+
+    Pipeline(Pipeline&&) = default;
+    Pipeline& operator=(Pipeline&&) = default;
+
+    // Runs until the source stops and every item has left the sink. The
+    // first exception thrown by a stage stops the source, cancels the
+    // items in flight and is rethrown here. Must not be called from a
+    // task on the pool, which has to keep running until run() returns.
+    // A pipeline can be run again once run() has returned.
+    PipelineStats run() { return core_->run(); }
+
+private:
+    template <typename T>
+    friend class PipelineBuilder;
+
+    explicit Pipeline(std::unique_ptr<detail::PipelineCore> core)
+        : core_(std::move(core)) {}
+
+    std::unique_ptr<detail::PipelineCore> core_;
+};
+
+// Stages added so far; T is the type the next stage receives.
+template <typename T>
+class PipelineBuilder {
+public:
+    // f(T&) returns the next stage's input.
+    template <typename F>
+    PipelineBuilder<typename std::decay<
+        typename std::result_of<F(T&)>::type>::type>
+    stage(StageMode mode, F f) {
+        typedef typename std::decay<
+            typename std::result_of<F(T&)>::type>::type Out;
+        static_assert(!std::is_void<Out>::value,
+                      "the last stage must be added with sink()");
+        core_->add_stage(mode, [f](detail::PipelineValue& value) mutable {
+            Out out(f(value.get<T>()));
+            value.emplace(std::move(out));
+            return true;
+        });
+        return PipelineBuilder<Out>(std::move(core_));
+    }
+
+    // f(T&) consumes the item.
+    template <typename F>
+    Pipeline sink(StageMode mode, F f) {
+        core_->add_stage(mode, [f](detail::PipelineValue& value) mutable {
+            f(value.get<T>());
+            return true;
+        });
+        return Pipeline(std::move(core_));
+    }
+
+private:
+    friend class Pipeline;
+    template <typename U>
+    friend class PipelineBuilder;
+
+    explicit PipelineBuilder(std::unique_ptr<detail::PipelineCore> core)
+        : core_(std::move(core)) {}
+
+    std::unique_ptr<detail::PipelineCore> core_;
+};
+
+template <typename F>
+PipelineBuilder<typename std::decay<
+    typename std::result_of<F(FlowControl&)>::type>::type>
+Pipeline::source(ThreadPool& pool, size_t max_tokens, F f) {
+    typedef typename std::decay<
+        typename std::result_of<F(FlowControl&)>::type>::type Out;
+    std::unique_ptr<detail::PipelineCore> core(
+        new detail::PipelineCore(pool, max_tokens));
+    core->add_stage(StageMode::SerialInOrder,
+                    [f](detail::PipelineValue& value) mutable {
+        FlowControl fc;
+        Out out(f(fc));
+        if (fc.stopped()) {
+            return false;
+        }
+        value.emplace(std::move(out));
+        return true;
+    });
+    return PipelineBuilder<Out>(std::move(core));
+}
+
+} // namespace lockfree
+
+#endif // LOCKFREE_PIPELINE_HPP
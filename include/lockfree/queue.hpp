@@ -1,23 +1,61 @@
 #ifndef LOCKFREE_QUEUE_H
 #define LOCKFREE_QUEUE_H
 
+#include "backoff.hpp"
+#include "cache_aligned.hpp"
+#include "exceptions.hpp"
+#include "hazard_pointer.hpp"
+#include "schedule_point.hpp"
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 namespace lockfree {
 
 template <typename T>
-class Queue {
+class Queue : public detail::CacheAligned {
 public:
     Queue();
+    // policy paces CAS retries and the spin before a blocking pop parks.
+    explicit Queue(const BackoffPolicy& policy);
     ~Queue();
 
     // Disable copying
     Queue(const Queue&) = delete;
     Queue& operator=(const Queue&) = delete;
 
-    void push(T value);
+    void push(const T& value);
+    void push(T&& value);
     bool pop(T& value);
+
+    // Constructs the element directly inside its node.
+    template <typename... Args>
+    void emplace(Args&&... args);
+
+    // Pops the front element and hands it to f(T&) while it still lives in
+    // its node, then destroys it. Returns false if the queue was empty.
+    template <typename F>
+    bool consume(F&& f);
+
+    // Links [first, last) with a single tail exchange.
+    template <typename It>
+    void push_bulk(It first, It last);
+
+    // Moves up to max front elements into out with a single head CAS.
+    // Returns the number of elements appended.
+    size_t pop_bulk(std::vector<T>& out, size_t max);
+
+    // Blocking pops: back off per the queue's policy, then park until an
+    // element arrives.
+    // Both return false if the queue is cleared while waiting;
+    // pop_wait_for also returns false once the timeout expires.
+    bool pop_wait(T& value);
+    template <typename Rep, typename Period>
+    bool pop_wait_for(T& value,
+                      const std::chrono::duration<Rep, Period>& timeout);
+
     bool empty() const;
     size_t size() const;
     
@@ -26,22 +64,57 @@ public:
     static void force_release_nodes();
 
 private:
+    // The element lives in raw storage so the sentinel never holds a T.
+    // Whoever pops a node's successor destroys that successor's element;
+    // the node memory itself is reclaimed through hazard pointers.
     struct Node {
-        T data;
         std::atomic<Node*> next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
         static std::atomic<size_t> active_nodes;
 
-        Node(T value) : data(std::move(value)), next(nullptr) {
+        Node() : next(nullptr) {
             active_nodes.fetch_add(1, std::memory_order_relaxed);
         }
         ~Node() {
             active_nodes.fetch_sub(1, std::memory_order_relaxed);
         }
+
+        T* value() { return reinterpret_cast<T*>(&storage); }
+    };
+
+    // Destroys the popped element and retires the old sentinel, also when
+    // the caller's move or visitor throws.
+    struct PopGuard {
+        Queue* queue;
+        Node* old_head;
+        Node* next;
+
+        ~PopGuard() {
+            next->value()->~T();
+            queue->size_.fetch_sub(1, std::memory_order_relaxed);
+            detail::hazard_retire(old_head);
+        }
     };
 
-    std::atomic<Node*> head_;
-    std::atomic<Node*> tail_;
-    std::atomic<size_t> size_;
+    // Consumers CAS head_ and producers swing tail_, so each gets its own
+    // cache line; otherwise every push invalidates the line every pop
+    // reads. size_ is written by both sides and keeps to a third line,
+    // together with waiters_ and the budget, which push and pop read
+    // while they already own it.
+    alignas(64) std::atomic<Node*> head_;
+    alignas(64) std::atomic<Node*> tail_;
+    alignas(64) std::atomic<size_t> size_;
+    std::atomic<unsigned> waiters_;
+    BackoffState backoff_;
+
+    void link(Node* new_node);
+    void link_chain(Node* first, Node* last, size_t count);
+    bool claim_front(detail::HazardPointer& hp_head,
+                     detail::HazardPointer& hp_next,
+                     Node*& old_head, Node*& next);
+    bool spin_pop(T& value);
+    bool should_park() const;
+    void wake_waiters();
 };
 
 } // namespace lockfree
@@ -1,60 +1,320 @@
 #ifndef LOCKFREE_QUEUE_IPP
 #define LOCKFREE_QUEUE_IPP
 
+#include "parking_lot.hpp"
 #include <iostream>
+#include <new>
+#include <thread>
+#include <utility>
 
 namespace lockfree {
 
 template <typename T>
-Queue<T>::Queue() : 
-    head_(new Node(T{})), 
+Queue<T>::Queue() : Queue(BackoffPolicy()) {}
+
+template <typename T>
+Queue<T>::Queue(const BackoffPolicy& policy) :
+    head_(new Node),
     tail_(head_.load()),
-    size_(0) {}
+    size_(0),
+    waiters_(0),
+    backoff_(policy) {}
 
 template <typename T>
 Queue<T>::~Queue() {
-    while (Node* node = head_.load()) {
-        head_.store(node->next);
+    Node* node = head_.load();
+    if (!node) return;
+    // The first node is the sentinel; every node after it owns an element.
+    Node* next = node->next.load();
+    delete node;
+    while ((node = next)) {
+        next = node->next.load();
+        node->value()->~T();
         delete node;
     }
 }
 
 template <typename T>
-void Queue<T>::push(T value) {
-    Node* new_node = new Node(std::move(value));
-    Node* old_tail = tail_.exchange(new_node, std::memory_order_acq_rel);
-    old_tail->next.store(new_node, std::memory_order_release);
-    size_.fetch_add(1, std::memory_order_relaxed);
+void Queue<T>::push(const T& value) {
+    emplace(value);
+}
+
+template <typename T>
+void Queue<T>::push(T&& value) {
+    emplace(std::move(value));
+}
+
+template <typename T>
+template <typename... Args>
+void Queue<T>::emplace(Args&&... args) {
+    Node* new_node = new Node;
+    LOCKFREE_TRY {
+        ::new (static_cast<void*>(new_node->value()))
+            T(std::forward<Args>(args)...);
+    } LOCKFREE_CATCH_ALL {
+        delete new_node;
+        LOCKFREE_RETHROW;
+    }
+    link(new_node);
+}
+
+template <typename T>
+void Queue<T>::link(Node* new_node) {
+    link_chain(new_node, new_node, 1);
+}
+
+template <typename T>
+void Queue<T>::link_chain(Node* first, Node* last, size_t count) {
+    // seq_cst pairs with the waiter registration in pop_wait(): either the
+    // parked consumer sees the new tail or we see its waiter count.
+    Node* old_tail = tail_.exchange(last, std::memory_order_seq_cst);
+    // Until the link below, every node behind old_tail is unreachable.
+    LOCKFREE_SCHEDULE_POINT();
+    old_tail->next.store(first, std::memory_order_release);
+    size_.fetch_add(count, std::memory_order_relaxed);
+    wake_waiters();
+}
+
+template <typename T>
+template <typename It>
+void Queue<T>::push_bulk(It first, It last) {
+    Node* chain_head = nullptr;
+    Node* chain_tail = nullptr;
+    size_t count = 0;
+    LOCKFREE_TRY {
+        for (; first != last; ++first) {
+            Node* node = new Node;
+            LOCKFREE_TRY {
+                ::new (static_cast<void*>(node->value())) T(*first);
+            } LOCKFREE_CATCH_ALL {
+                delete node;
+                LOCKFREE_RETHROW;
+            }
+            if (chain_tail) {
+                chain_tail->next.store(node, std::memory_order_relaxed);
+            } else {
+                chain_head = node;
+            }
+            chain_tail = node;
+            ++count;
+        }
+    } LOCKFREE_CATCH_ALL {
+        while (chain_head) {
+            Node* next = chain_head->next.load(std::memory_order_relaxed);
+            chain_head->value()->~T();
+            delete chain_head;
+            chain_head = next;
+        }
+        LOCKFREE_RETHROW;
+    }
+    if (count) {
+        link_chain(chain_head, chain_tail, count);
+    }
+}
+
+template <typename T>
+size_t Queue<T>::pop_bulk(std::vector<T>& out, size_t max) {
+    if (max == 0) return 0;
+    detail::HazardPointer hp_head, hp_a, hp_b;
+    Backoff backoff(backoff_.policy());
+    for (;;) {
+        Node* old_head = hp_head.protect(head_);
+        if (!old_head) return 0;
+
+        // Walk hand-over-hand; while head_ has not moved, none of the
+        // nodes behind it can have been retired.
+        detail::HazardPointer* cur = &hp_a;
+        detail::HazardPointer* prev = &hp_b;
+        Node* last = old_head;
+        size_t count = 0;
+        bool moved = false;
+        while (count < max) {
+            Node* next = last->next.load(std::memory_order_acquire);
+            if (!next) break;
+            cur->set(next);
+            if (head_.load(std::memory_order_acquire) != old_head) {
+                moved = true;
+                break;
+            }
+            last = next;
+            ++count;
+            std::swap(cur, prev);
+        }
+        if (moved) continue;
+        if (count == 0) {
+            // Empty only if no link is pending; see claim_front().
+            if (tail_.load(std::memory_order_acquire) == old_head) {
+                return 0;
+            }
+            backoff.pause();
+            continue;
+        }
+
+        out.reserve(out.size() + count);
+        LOCKFREE_SCHEDULE_POINT();
+        if (!head_.compare_exchange_weak(old_head, last,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+            backoff.pause();
+            continue;
+        }
+
+        // Nodes between old_head and last are now ours alone; last is
+        // the new sentinel and still covered by a hazard slot.
+        Node* node = old_head;
+        size_t i = 0;
+        LOCKFREE_TRY {
+            for (; i < count; ++i) {
+                Node* next = node->next.load(std::memory_order_acquire);
+                PopGuard guard = {this, node, next};
+                node = next;
+                out.push_back(std::move(*next->value()));
+            }
+        } LOCKFREE_CATCH_ALL {
+            // Drop the rest of the claimed run so the queue stays sound.
+            for (++i; i < count; ++i) {
+                Node* next = node->next.load(std::memory_order_acquire);
+                PopGuard guard = {this, node, next};
+                node = next;
+            }
+            LOCKFREE_RETHROW;
+        }
+        return count;
+    }
+}
+
+template <typename T>
+bool Queue<T>::claim_front(detail::HazardPointer& hp_head,
+                           detail::HazardPointer& hp_next,
+                           Node*& old_head, Node*& next) {
+    Backoff backoff(backoff_.policy());
+    for (;;) {
+        old_head = hp_head.protect(head_);
+        if (!old_head) return false;  // Queue is in shutdown state
+
+        LOCKFREE_SCHEDULE_POINT();
+        next = old_head->next.load(std::memory_order_acquire);
+        hp_next.set(next);
+        // next cannot have been retired while head_ still points before it
+        if (head_.load(std::memory_order_acquire) != old_head) {
+            continue;
+        }
+        if (!next) {
+            if (tail_.load(std::memory_order_acquire) == old_head) {
+                return false;
+            }
+            // A producer has swung tail_ but not linked yet; pushes
+            // that completed after it sit behind that link, so reporting
+            // empty here would lose them. Wait for the link.
+            backoff.pause();
+            continue;
+        }
+
+        LOCKFREE_SCHEDULE_POINT();
+        if (head_.compare_exchange_weak(old_head, next,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+            return true;
+        }
+        // Lost the race to another consumer; let the line settle before
+        // retrying instead of bouncing it straight back.
+        backoff.pause();
+    }
 }
 
 template <typename T>
 bool Queue<T>::pop(T& value) {
-    Node* old_head = head_.load(std::memory_order_acquire);
-    if (!old_head) return false;  // Queue is in shutdown state
-    
-    Node* next_node;
-    do {
-        next_node = old_head->next.load(std::memory_order_acquire);
-        if (!next_node) return false;
-        
-        // Validate pointers before access
-        if (!old_head || !next_node) {
+    detail::HazardPointer hp_head, hp_next;
+    Node* old_head;
+    Node* next;
+    if (!claim_front(hp_head, hp_next, old_head, next)) {
+        return false;
+    }
+
+    PopGuard guard = {this, old_head, next};
+    value = std::move(*next->value());
+    return true;
+}
+
+template <typename T>
+template <typename F>
+bool Queue<T>::consume(F&& f) {
+    detail::HazardPointer hp_head, hp_next;
+    Node* old_head;
+    Node* next;
+    if (!claim_front(hp_head, hp_next, old_head, next)) {
+        return false;
+    }
+
+    PopGuard guard = {this, old_head, next};
+    f(*next->value());
+    return true;
+}
+
+template <typename T>
+bool Queue<T>::spin_pop(T& value) {
+    Backoff backoff(backoff_);
+    for (;;) {
+        if (pop(value)) {
+            backoff.succeeded();
+            return true;
+        }
+        if (!backoff.pause()) {
+            return false;
+        }
+    }
+}
+
+template <typename T>
+bool Queue<T>::should_park() const {
+    // head == tail means only the sentinel is left. A null head means the
+    // queue was cleared and waiters must give up.
+    Node* head = head_.load(std::memory_order_seq_cst);
+    return head && head == tail_.load(std::memory_order_seq_cst);
+}
+
+template <typename T>
+void Queue<T>::wake_waiters() {
+    // The only cost producers pay when nobody waits: a plain load on x86.
+    if (waiters_.load(std::memory_order_seq_cst) != 0) {
+        detail::ParkingLot::unpark_all(this);
+    }
+}
+
+template <typename T>
+bool Queue<T>::pop_wait(T& value) {
+    for (;;) {
+        if (spin_pop(value)) {
+            return true;
+        }
+        if (!head_.load(std::memory_order_acquire)) {
             return false;
         }
-    } while (!head_.compare_exchange_weak(
-        old_head, next_node,
-        std::memory_order_acq_rel,
-        std::memory_order_acquire));
-
-    try {
-        value = std::move(next_node->data);
-        delete old_head;
-        size_.fetch_sub(1, std::memory_order_relaxed);
-        return true;
-    } catch (...) {
-        // Ensure we don't leak memory if move fails
-        delete old_head;
-        throw;
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        detail::ParkingLot::park(this, [this] { return should_park(); });
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+template <typename Rep, typename Period>
+bool Queue<T>::pop_wait_for(T& value,
+                            const std::chrono::duration<Rep, Period>& timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+        if (spin_pop(value)) {
+            return true;
+        }
+        if (!head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        bool woken = detail::ParkingLot::park_until(
+            this, [this] { return should_park(); }, deadline);
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+        if (!woken) {
+            return pop(value);
+        }
     }
 }
 
@@ -76,11 +336,15 @@ void Queue<T>::clear() {
     Node* old_head = head_.exchange(nullptr, std::memory_order_seq_cst);
     tail_.store(nullptr, std::memory_order_seq_cst);
     size_.store(0, std::memory_order_relaxed);
-    
-    Node* current = old_head;
+    wake_waiters();
+    if (!old_head) return;
+
+    Node* current = old_head->next.load(std::memory_order_acquire);
+    detail::hazard_retire(old_head);
     while (current) {
-        Node* next = current->next.load(std::memory_order_relaxed);
-        delete current;
+        Node* next = current->next.load(std::memory_order_acquire);
+        current->value()->~T();
+        detail::hazard_retire(current);
         current = next;
     }
 }
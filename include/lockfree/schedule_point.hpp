@@ -0,0 +1,120 @@
+#ifndef LOCKFREE_SCHEDULE_POINT_HPP
+#define LOCKFREE_SCHEDULE_POINT_HPP
+
+#include "backoff.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Schedule points mark the windows inside a lock-free operation where
+// another thread slipping in is what the algorithm has to survive:
+// between the tail exchange and the link that publishes the node,
+// between reading head_ and the CAS that claims it. Built with
+// LOCKFREE_STRESS defined (the LOCKFREE_STRESS CMake option) each point
+// may yield, spin or sleep, as drawn from a seeded generator, which
+// widens those windows from nanoseconds to scheduler quanta. Otherwise
+// the macro expands to nothing and the code below is never called.
+#ifdef LOCKFREE_STRESS
+#define LOCKFREE_SCHEDULE_POINT() ::lockfree::stress::schedule_point()
+#else
+#define LOCKFREE_SCHEDULE_POINT() ((void)0)
+#endif
+
+namespace lockfree {
+namespace stress {
+
+#ifdef LOCKFREE_STRESS
+constexpr bool kEnabled = true;
+#else
+constexpr bool kEnabled = false;
+#endif
+
+namespace detail {
+
+struct Settings {
+    std::atomic<uint64_t> seed{0};
+    std::atomic<uint32_t> per_mille{0};
+    // Bumped by configure(); threads reseed when they notice.
+    std::atomic<uint64_t> generation{0};
+    std::atomic<uint64_t> threads{0};
+    std::atomic<uint64_t> injected{0};
+};
+
+inline Settings& settings() {
+    static Settings instance;
+    return instance;
+}
+
+// splitmix64: turns (seed, thread number) into independent streams.
+inline uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+} // namespace detail
+
+// Perturbs per_mille of every thousand schedule points; 0 turns
+// injection off. Each thread draws from its own stream, derived from
+// seed and the order in which threads reach their first schedule point
+// after this call, so a failing seed replays the same decisions per
+// thread even though the OS interleaving differs run to run.
+inline void configure(uint64_t seed, uint32_t per_mille) {
+    detail::Settings& s = detail::settings();
+    s.seed.store(seed, std::memory_order_relaxed);
+    s.per_mille.store(per_mille, std::memory_order_relaxed);
+    s.threads.store(0, std::memory_order_relaxed);
+    s.injected.store(0, std::memory_order_relaxed);
+    s.generation.fetch_add(1, std::memory_order_release);
+}
+
+// Perturbations since the last configure(); stays 0 unless compiled in.
+inline uint64_t injected() {
+    return detail::settings().injected.load(std::memory_order_relaxed);
+}
+
+inline void schedule_point() {
+    detail::Settings& s = detail::settings();
+    const uint32_t per_mille = s.per_mille.load(std::memory_order_relaxed);
+    if (per_mille == 0) {
+        return;
+    }
+    static thread_local uint64_t generation = 0;
+    static thread_local uint64_t state = 0;
+    const uint64_t current = s.generation.load(std::memory_order_acquire);
+    if (generation != current) {
+        generation = current;
+        state = detail::mix(s.seed.load(std::memory_order_relaxed) +
+                            s.threads.fetch_add(1, std::memory_order_relaxed));
+    }
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    if (state % 1000 >= per_mille) {
+        return;
+    }
+    s.injected.fetch_add(1, std::memory_order_relaxed);
+    // Mostly yields and short spins; one in sixteen sleeps, long enough
+    // for every other thread to run through its own window.
+    const uint64_t r = state >> 10;
+    switch (r % 16) {
+    case 0:
+        std::this_thread::sleep_for(std::chrono::microseconds(r % 200));
+        break;
+    case 1: case 2: case 3: case 4: case 5: case 6: case 7:
+        std::this_thread::yield();
+        break;
+    default:
+        for (uint64_t i = (r >> 4) % 512; i > 0; --i) {
+            ::lockfree::detail::cpu_relax();
+        }
+        break;
+    }
+}
+
+} // namespace stress
+} // namespace lockfree
+
+#endif // LOCKFREE_SCHEDULE_POINT_HPP
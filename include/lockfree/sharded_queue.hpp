@@ -0,0 +1,268 @@
+#ifndef LOCKFREE_SHARDED_QUEUE_HPP
+#define LOCKFREE_SHARDED_QUEUE_HPP
+
+#include "cache_aligned.hpp"
+#include "exceptions.hpp"
+#include "queue.hpp"
+#include "schedule_point.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lockfree {
+
+enum class ShardOrder {
+    // Producers push to their home shard, consumers start at theirs and
+    // steal from the others. Only per-producer FIFO order is kept.
+    Relaxed,
+    // Pushes and pops take tickets from two shared counters and map them
+    // round-robin onto the shards; each shard links and hands out its
+    // elements in ticket order, so the whole queue is FIFO. Costs one
+    // contended fetch_add per operation, and a push or pop may briefly
+    // spin for the holder of the shard's previous ticket.
+    Strict
+};
+
+namespace detail {
+
+// Stable per-thread index used to spread threads over shards.
+inline size_t shard_home_slot() {
+    static std::atomic<size_t> next_slot{0};
+    static thread_local size_t slot =
+        next_slot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+} // namespace detail
+
+// MPMC queue built from independent shards so that producers do not all
+// serialize on one tail_ exchange: Queue shards when Relaxed, ticketed
+// lanes when Strict.
+template <typename T>
+class ShardedQueue : public detail::CacheAligned {
+public:
+    explicit ShardedQueue(
+        size_t shards = std::thread::hardware_concurrency(),
+        ShardOrder order = ShardOrder::Relaxed,
+        const BackoffPolicy& backoff = BackoffPolicy())
+        : order_(order), backoff_(backoff), enq_ticket_(0), deq_ticket_(0) {
+        if (shards == 0) shards = 1;
+        if (order_ == ShardOrder::Strict) {
+            lanes_.reserve(shards);
+            for (size_t i = 0; i < shards; ++i) {
+                lanes_.emplace_back(new Lane);
+            }
+            return;
+        }
+        shards_.reserve(shards);
+        for (size_t i = 0; i < shards; ++i) {
+            shards_.emplace_back(new Shard(backoff));
+        }
+    }
+
+    ~ShardedQueue() {
+        for (const auto& lane : lanes_) {
+            // The first node is the sentinel; every node after it owns
+            // an element.
+            LaneNode* node = lane->head;
+            LaneNode* next = node->next.load(std::memory_order_relaxed);
+            delete node;
+            while ((node = next)) {
+                next = node->next.load(std::memory_order_relaxed);
+                node->value()->~T();
+                delete node;
+            }
+        }
+    }
+
+    ShardedQueue(const ShardedQueue&) = delete;
+    ShardedQueue& operator=(const ShardedQueue&) = delete;
+
+    void push(const T& value) { emplace(value); }
+    void push(T&& value) { emplace(std::move(value)); }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        if (order_ == ShardOrder::Strict) {
+            emplace_strict(std::forward<Args>(args)...);
+            return;
+        }
+        const size_t index = detail::shard_home_slot() % shards_.size();
+        shards_[index]->queue.emplace(std::forward<Args>(args)...);
+    }
+
+    bool pop(T& value) {
+        return consume([&value](T& front) { value = std::move(front); });
+    }
+
+    template <typename F>
+    bool consume(F&& f) {
+        if (order_ == ShardOrder::Strict) {
+            return consume_strict(f);
+        }
+
+        const size_t n = shards_.size();
+        const size_t home = detail::shard_home_slot() % n;
+        for (size_t i = 0; i < n; ++i) {
+            Queue<T>& q = shards_[(home + i) % n]->queue;
+            // size() is a relaxed counter read; skip the hazard-protected
+            // probe on shards that look empty.
+            if (!q.empty() && q.consume(f)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t size() const {
+        if (order_ == ShardOrder::Strict) {
+            // Pushes that hold a ticket count even before they link.
+            const uint64_t popped = deq_ticket_.load(std::memory_order_acquire);
+            const uint64_t pushed = enq_ticket_.load(std::memory_order_acquire);
+            return pushed > popped ? static_cast<size_t>(pushed - popped) : 0;
+        }
+        size_t total = 0;
+        for (const auto& shard : shards_) {
+            total += shard->queue.size();
+        }
+        return total;
+    }
+
+    size_t shard_count() const {
+        return order_ == ShardOrder::Strict ? lanes_.size() : shards_.size();
+    }
+    ShardOrder order() const { return order_; }
+
+private:
+    struct alignas(64) Shard : detail::CacheAligned {
+        explicit Shard(const BackoffPolicy& backoff) : queue(backoff) {}
+        Queue<T> queue;
+    };
+
+    // A Strict shard. Ticket t belongs to lane t % n as that lane's turn
+    // t / n; pushes link and pops unlink strictly by turn, so every lane
+    // is an ordered list and a popped turn finds exactly its element at
+    // the front. Only the holder of a turn touches tail (pushes) or head
+    // (pops), which is also what makes freeing the old head safe.
+    struct LaneNode {
+        std::atomic<LaneNode*> next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        LaneNode() : next(nullptr) {}
+        T* value() { return reinterpret_cast<T*>(&storage); }
+    };
+
+    // Producers and consumers each keep to their own line.
+    struct alignas(64) Lane : detail::CacheAligned {
+        Lane() : enq_turn(0), tail(new LaneNode), deq_turn(0), head(tail) {}
+
+        std::atomic<uint64_t> enq_turn;
+        LaneNode* tail;
+        alignas(64) std::atomic<uint64_t> deq_turn;
+        LaneNode* head;
+    };
+
+    // Destroys the popped element and frees the old sentinel, also when
+    // the visitor throws, then passes the turn on.
+    struct LanePopGuard {
+        Lane* lane;
+        LaneNode* old_head;
+        LaneNode* next;
+        uint64_t turn;
+
+        ~LanePopGuard() {
+            next->value()->~T();
+            delete old_head;
+            lane->deq_turn.store(turn + 1, std::memory_order_release);
+        }
+    };
+
+    // Everything that can throw happens before the ticket is taken, so a
+    // ticket handed out is always linked and no pop waits on it forever.
+    template <typename... Args>
+    void emplace_strict(Args&&... args) {
+        LaneNode* node = new LaneNode;
+        LOCKFREE_TRY {
+            ::new (static_cast<void*>(node->value()))
+                T(std::forward<Args>(args)...);
+        } LOCKFREE_CATCH_ALL {
+            delete node;
+            LOCKFREE_RETHROW;
+        }
+
+        const uint64_t ticket =
+            enq_ticket_.fetch_add(1, std::memory_order_acq_rel);
+        Lane& lane = *lanes_[ticket % lanes_.size()];
+        const uint64_t turn = ticket / lanes_.size();
+        // Until the link below, pops of this ticket wait on us.
+        LOCKFREE_SCHEDULE_POINT();
+        Backoff backoff(backoff_);
+        while (lane.enq_turn.load(std::memory_order_acquire) != turn) {
+            backoff.pause();
+        }
+        LaneNode* prev = lane.tail;
+        lane.tail = node;
+        prev->next.store(node, std::memory_order_release);
+        lane.enq_turn.store(turn + 1, std::memory_order_release);
+    }
+
+    template <typename F>
+    bool consume_strict(F& f) {
+        uint64_t ticket;
+        if (!claim_ticket(ticket)) {
+            return false;
+        }
+        Lane& lane = *lanes_[ticket % lanes_.size()];
+        const uint64_t turn = ticket / lanes_.size();
+        Backoff backoff(backoff_);
+        while (lane.deq_turn.load(std::memory_order_acquire) != turn) {
+            backoff.pause();
+        }
+        LaneNode* old_head = lane.head;
+        LaneNode* next;
+        // The ticket's producer may still be waiting for its turn.
+        while (!(next = old_head->next.load(std::memory_order_acquire))) {
+            backoff.pause();
+        }
+        lane.head = next;
+        LanePopGuard guard = {&lane, old_head, next, turn};
+        f(*next->value());
+        return true;
+    }
+
+    // Takes the next dequeue ticket if a producer already holds it.
+    bool claim_ticket(uint64_t& ticket) {
+        ticket = deq_ticket_.load(std::memory_order_acquire);
+        Backoff backoff(backoff_);
+        for (;;) {
+            if (ticket >= enq_ticket_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (deq_ticket_.compare_exchange_weak(ticket, ticket + 1,
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_acquire)) {
+                return true;
+            }
+            backoff.pause();
+        }
+    }
+
+    // Relaxed uses shards_, Strict lanes_; the other stays empty.
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    const ShardOrder order_;
+    const BackoffPolicy backoff_;
+    alignas(64) std::atomic<uint64_t> enq_ticket_;
+    alignas(64) std::atomic<uint64_t> deq_ticket_;
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_SHARDED_QUEUE_HPP
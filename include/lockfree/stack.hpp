@@ -0,0 +1,192 @@
+#ifndef LOCKFREE_STACK_HPP
+#define LOCKFREE_STACK_HPP
+
+#include "cache_aligned.hpp"
+#include "exceptions.hpp"
+#include "hazard_pointer.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace lockfree {
+
+// Lock-free LIFO stack (Treiber) for work where the most recently
+// produced item is the one still hot in cache.
+//
+// Popped nodes are reclaimed through hazard pointers, so a pop that
+// loaded a head which was popped, freed and reallocated meanwhile cannot
+// succeed with a stale next pointer (ABA). Under contention a push whose
+// CAS fails offers its node in an elimination slot for a short while, and
+// a pop whose CAS fails looks for such an offer: a matched pair completes
+// without touching head_ at all.
+template <typename T>
+class Stack : public detail::CacheAligned {
+public:
+    // Exchange slots for elimination backoff.
+    static constexpr size_t kEliminationSlots = 8;
+
+    Stack() : head_(nullptr), size_(0) {
+        for (auto& slot : slots_) {
+            slot.offer.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~Stack() {
+        Node* node = head_.load(std::memory_order_relaxed);
+        while (node) {
+            Node* next = node->next.load(std::memory_order_relaxed);
+            node->value()->~T();
+            delete node;
+            node = next;
+        }
+    }
+
+    Stack(const Stack&) = delete;
+    Stack& operator=(const Stack&) = delete;
+
+    void push(const T& value) { emplace(value); }
+    void push(T&& value) { emplace(std::move(value)); }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        Node* node = new Node;
+        LOCKFREE_TRY {
+            ::new (static_cast<void*>(node->value()))
+                T(std::forward<Args>(args)...);
+        } LOCKFREE_CATCH_ALL {
+            delete node;
+            LOCKFREE_RETHROW;
+        }
+        size_.fetch_add(1, std::memory_order_relaxed);
+
+        Node* head = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            node->next.store(head, std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, node,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+            if (offer(node)) {
+                return;
+            }
+            head = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool pop(T& value) {
+        detail::HazardPointer hp;
+        for (;;) {
+            Node* head = hp.protect(head_);
+            if (!head) {
+                return false;
+            }
+            Node* next = head->next.load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, next,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+                hp.reset();
+                take(head, value);
+                detail::hazard_retire(head);
+                return true;
+            }
+            hp.reset();
+            if (Node* node = claim_offer()) {
+                // An offered node was never linked, so no other thread
+                // can hold a reference to it.
+                take(node, value);
+                delete node;
+                return true;
+            }
+        }
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // Approximate while pushes and pops are in flight.
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+private:
+    struct Node {
+        std::atomic<Node*> next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        Node() : next(nullptr) {}
+
+        T* value() { return reinterpret_cast<T*>(&storage); }
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<Node*> offer;
+    };
+
+    // Spin iterations a pusher leaves its node on offer.
+    static constexpr int kOfferSpins = 64;
+
+    void take(Node* node, T& value) {
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        T* item = node->value();
+        struct Destroy {
+            T* item;
+            ~Destroy() { item->~T(); }
+        } destroy = {item};
+        value = std::move(*item);
+    }
+
+    // Returns true if a pop took node while it was on offer.
+    bool offer(Node* node) {
+        Slot& slot = slots_[slot_index()];
+        Node* expected = nullptr;
+        if (!slot.offer.compare_exchange_strong(expected, node,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+            return false;
+        }
+        for (int i = 0; i < kOfferSpins; ++i) {
+            if (slot.offer.load(std::memory_order_acquire) != node) {
+                return true;
+            }
+        }
+        // Withdraw; failing means a pop claimed the node in the meantime.
+        expected = node;
+        return !slot.offer.compare_exchange_strong(expected, nullptr,
+                                                   std::memory_order_acquire,
+                                                   std::memory_order_acquire);
+    }
+
+    Node* claim_offer() {
+        Slot& slot = slots_[slot_index()];
+        Node* node = slot.offer.load(std::memory_order_acquire);
+        if (node && slot.offer.compare_exchange_strong(
+                        node, nullptr, std::memory_order_acq_rel,
+                        std::memory_order_relaxed)) {
+            return node;
+        }
+        return nullptr;
+    }
+
+    // Per-thread xorshift spreading colliding threads over the slots.
+    static size_t slot_index() {
+        static thread_local uint32_t state = static_cast<uint32_t>(
+            std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state % kEliminationSlots;
+    }
+
+    alignas(64) std::atomic<Node*> head_;
+    alignas(64) std::atomic<size_t> size_;
+    Slot slots_[kEliminationSlots];
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_STACK_HPP
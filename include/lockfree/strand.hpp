@@ -0,0 +1,242 @@
+#ifndef LOCKFREE_STRAND_HPP
+#define LOCKFREE_STRAND_HPP
+
+#include "exceptions.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace lockfree {
+
+// Serial executor on top of a ThreadPool. Tasks posted to one strand run
+// one at a time and in posting order; different strands run in parallel.
+// No worker ever blocks on a strand: the first post into an empty strand
+// schedules a single drain task, which runs up to kMaxBatch tasks and
+// then reschedules itself behind other pool work if more are queued.
+//
+// An idle strand is just its queue pointers and a counter, so keeping
+// one per connection or key is cheap. A strand must outlive the tasks
+// posted to it.
+//
+// If the pool refuses a drain, because it has shut down or is out of
+// memory, nothing would ever run what the strand holds: those tasks are
+// dropped unrun, as the pool's shutdown drops its own queued tasks, and
+// the post() that found the pool gone throws what ThreadPool::post()
+// would. The strand stays usable; it simply has nowhere to run.
+class Strand {
+public:
+    // Tasks run per drain before the strand yields its worker.
+    static constexpr size_t kMaxBatch = 64;
+
+    explicit Strand(ThreadPool& pool)
+        : pool_(&pool), head_(&stub_), tail_(&stub_), pending_(0) {}
+
+    ~Strand() {
+        // Anything left was posted while a drain was still queued, i.e.
+        // the strand did not outlive its tasks; destroy it without running.
+        while (Node* node = pop()) {
+            delete static_cast<TaskNode*>(node);
+        }
+    }
+
+    Strand(const Strand&) = delete;
+    Strand& operator=(const Strand&) = delete;
+
+    // Exceptions escaping f are caught and logged, as the pool's workers
+    // do for ThreadPool::post().
+    template <typename F>
+    void post(F&& f) {
+        push(new TaskNode(std::forward<F>(f)));
+        if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+            const SubmitStatus status = schedule();
+            if (status == SubmitStatus::Shutdown) {
+                detail::raise(std::runtime_error("ThreadPool is shutdown"));
+            } else if (status != SubmitStatus::Ok) {
+                detail::raise(std::bad_alloc());
+            }
+        }
+    }
+
+    template <typename F>
+    auto submit(F&& f) -> std::future<decltype(f())> {
+        using ReturnType = decltype(f());
+        auto task = std::make_shared<std::packaged_task<ReturnType()>>(
+            std::forward<F>(f));
+        std::future<ReturnType> future = task->get_future();
+        post([task]() { (*task)(); });
+        return future;
+    }
+
+    // True if no task is queued or running.
+    bool idle() const {
+        return pending_.load(std::memory_order_acquire) == 0;
+    }
+
+    ThreadPool& pool() const { return *pool_; }
+
+private:
+    struct Node {
+        std::atomic<Node*> next;
+        Node() : next(nullptr) {}
+    };
+
+    struct TaskNode : Node {
+        template <typename F>
+        explicit TaskNode(F&& f) : fn(std::forward<F>(f)) {}
+        Task fn;
+    };
+
+    // The drain as a pool task. Refused by try_post() or dropped unrun
+    // by a pool shutdown, it empties the strand, which nothing would
+    // drain any more.
+    class DrainTask {
+    public:
+        explicit DrainTask(Strand* strand) : strand_(strand) {}
+        DrainTask(DrainTask&& other) : strand_(other.strand_) {
+            other.strand_ = nullptr;
+        }
+        DrainTask(const DrainTask&) = delete;
+        DrainTask& operator=(const DrainTask&) = delete;
+
+        ~DrainTask() {
+            if (strand_) {
+                strand_->drop_queued();
+            }
+        }
+
+        void operator()() {
+            Strand* strand = strand_;
+            strand_ = nullptr;
+            strand->drain();
+        }
+
+    private:
+        Strand* strand_;
+    };
+
+    // Hands the strand to a new drain task. Called by whoever took
+    // pending_ off zero, or by a drain leaving work behind.
+    SubmitStatus schedule() noexcept {
+        return pool_->try_post(DrainTask(this));
+    }
+
+    // Runs one posted task. Whatever escapes it is logged like a failed
+    // pool task; submit() reports through its future instead.
+    static void run(TaskNode* task) noexcept {
+#if LOCKFREE_HAS_EXCEPTIONS
+        try {
+            task->fn();
+        } catch (const std::exception& e) {
+            std::cerr << "Strand task exception: " << e.what() << "\n";
+        } catch (...) {
+            std::cerr << "Strand unknown task exception\n";
+        }
+#else
+        task->fn();
+#endif
+    }
+
+    // Next counted task; one is always coming, so wait out a producer
+    // that has swapped head_ but not linked its node yet.
+    TaskNode* next_task(Backoff& link_wait) {
+        Node* node;
+        while (!(node = pop())) {
+            link_wait.pause();
+        }
+        link_wait.reset();
+        return static_cast<TaskNode*>(node);
+    }
+
+    // Destroys every queued task unrun, with the same ownership as
+    // drain(); posts landing meanwhile are dropped too, since none of
+    // them scheduled a drain.
+    void drop_queued() noexcept {
+        size_t count = pending_.load(std::memory_order_acquire);
+        Backoff link_wait(pool_->backoff_policy());
+        for (;;) {
+            for (size_t i = 0; i < count; ++i) {
+                delete next_task(link_wait);
+            }
+            const size_t before =
+                pending_.fetch_sub(count, std::memory_order_acq_rel);
+            if (before == count) {
+                return;
+            }
+            count = before - count;
+        }
+    }
+
+    // Runs with exclusive ownership of the strand: pending_ was non-zero
+    // when this drain was scheduled and nobody else schedules one until
+    // it drops back to zero.
+    void drain() {
+        // Only run tasks already counted, so the fetch_sub below can never
+        // take pending_ past a producer that has pushed but not counted.
+        size_t budget = pending_.load(std::memory_order_acquire);
+        if (budget > kMaxBatch) budget = kMaxBatch;
+        size_t ran = 0;
+        Backoff link_wait(pool_->backoff_policy());
+        while (ran < budget) {
+            TaskNode* task = next_task(link_wait);
+            run(task);
+            delete task;
+            ++ran;
+        }
+        if (pending_.fetch_sub(ran, std::memory_order_acq_rel) != ran) {
+            schedule();
+        }
+    }
+
+    // Vyukov intrusive MPSC queue: one exchange per push, consumer-only
+    // tail, stub node recycled to keep the queue non-empty.
+    void push(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    Node* pop() {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return nullptr;  // Producer between exchange and link.
+        }
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    ThreadPool* pool_;
+    std::atomic<Node*> head_;
+    Node* tail_;
+    Node stub_;
+    std::atomic<size_t> pending_;
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_STRAND_HPP
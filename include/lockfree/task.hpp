@@ -0,0 +1,198 @@
+#ifndef LOCKFREE_TASK_HPP
+#define LOCKFREE_TASK_HPP
+
+#include "exceptions.hpp"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace lockfree {
+
+// Move-only void() callable with inline storage. Callables up to
+// kInlineSize bytes that are nothrow-movable live inside the Task itself,
+// so submitting them does not allocate; larger ones go to the heap, or to
+// the allocator passed with std::allocator_arg.
+class Task {
+public:
+    static constexpr size_t kInlineSize = 64;
+
+    Task() noexcept : ops_(nullptr) {}
+    Task(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, Task>::value &&
+                  !std::is_same<typename std::decay<F>::type,
+                                std::nullptr_t>::value>::type>
+    Task(F&& f) : ops_(nullptr) {
+        init(std::forward<F>(f), std::allocator<char>());
+    }
+
+    template <typename F, typename Alloc>
+    Task(std::allocator_arg_t, const Alloc& alloc, F&& f) : ops_(nullptr) {
+        init(std::forward<F>(f), alloc);
+    }
+
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops_) {
+                other.ops_->move(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    void operator()() {
+        if (!ops_) {
+            detail::raise(std::bad_function_call());
+        }
+        ops_->invoke(&storage_);
+    }
+
+    // True if a callable of type F would be stored without allocating.
+    template <typename F>
+    static constexpr bool stored_inline() {
+        return sizeof(F) <= kInlineSize &&
+               alignof(F) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<F>::value;
+    }
+
+private:
+    using Storage = typename std::aligned_storage<
+        kInlineSize, alignof(std::max_align_t)>::type;
+
+    struct Ops {
+        void (*invoke)(void* storage);
+        // Move-constructs into dst and destroys src.
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* storage);
+    };
+
+    template <typename F>
+    struct InlineOps {
+        static void invoke(void* s) { (*static_cast<F*>(s))(); }
+        static void move(void* dst, void* src) {
+            F* from = static_cast<F*>(src);
+            new (dst) F(std::move(*from));
+            from->~F();
+        }
+        static void destroy(void* s) { static_cast<F*>(s)->~F(); }
+        static const Ops ops;
+    };
+
+    // Out-of-line callable together with the allocator that owns it.
+    template <typename F, typename Alloc>
+    struct Boxed {
+        using BoxAlloc = typename std::allocator_traits<Alloc>::template
+            rebind_alloc<Boxed>;
+
+        template <typename G>
+        Boxed(G&& g, const Alloc& a) : fn(std::forward<G>(g)), alloc(a) {}
+
+        F fn;
+        BoxAlloc alloc;
+    };
+
+    template <typename F, typename Alloc>
+    struct BoxedOps {
+        using Box = Boxed<F, Alloc>;
+        using Traits = std::allocator_traits<typename Box::BoxAlloc>;
+
+        static Box*& ptr(void* s) { return *static_cast<Box**>(s); }
+        static void invoke(void* s) { ptr(s)->fn(); }
+        static void move(void* dst, void* src) {
+            new (dst) Box*(ptr(src));
+        }
+        static void destroy(void* s) {
+            Box* box = ptr(s);
+            typename Box::BoxAlloc alloc(box->alloc);
+            Traits::destroy(alloc, box);
+            Traits::deallocate(alloc, box, 1);
+        }
+        static const Ops ops;
+    };
+
+    template <typename G, typename Alloc>
+    void init(G&& g, const Alloc& alloc) {
+        typedef typename std::decay<G>::type F;
+        store(std::forward<G>(g), alloc,
+              std::integral_constant<bool, stored_inline<F>()>());
+    }
+
+    template <typename G, typename Alloc>
+    void store(G&& g, const Alloc&, std::true_type) {
+        typedef typename std::decay<G>::type F;
+        new (&storage_) F(std::forward<G>(g));
+        ops_ = &InlineOps<F>::ops;
+    }
+
+    template <typename G, typename Alloc>
+    void store(G&& g, const Alloc& a, std::false_type) {
+        typedef typename std::decay<G>::type F;
+        typedef Boxed<F, Alloc> Box;
+        typedef std::allocator_traits<typename Box::BoxAlloc> Traits;
+        typename Box::BoxAlloc alloc(a);
+        Box* box = Traits::allocate(alloc, 1);
+        LOCKFREE_TRY {
+            Traits::construct(alloc, box, std::forward<G>(g), a);
+        } LOCKFREE_CATCH_ALL {
+            Traits::deallocate(alloc, box, 1);
+            LOCKFREE_RETHROW;
+        }
+        new (&storage_) Box*(box);
+        ops_ = &BoxedOps<F, Alloc>::ops;
+    }
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;
+    const Ops* ops_;
+};
+
+template <typename F>
+const Task::Ops Task::InlineOps<F>::ops = {
+    &Task::InlineOps<F>::invoke,
+    &Task::InlineOps<F>::move,
+    &Task::InlineOps<F>::destroy
+};
+
+template <typename F, typename Alloc>
+const Task::Ops Task::BoxedOps<F, Alloc>::ops = {
+    &Task::BoxedOps<F, Alloc>::invoke,
+    &Task::BoxedOps<F, Alloc>::move,
+    &Task::BoxedOps<F, Alloc>::destroy
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_TASK_HPP
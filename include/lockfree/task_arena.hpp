@@ -0,0 +1,418 @@
+#ifndef LOCKFREE_TASK_ARENA_HPP
+#define LOCKFREE_TASK_ARENA_HPP
+
+#include "arena_budget.hpp"
+#include "backoff.hpp"
+#include "cache_aligned.hpp"
+#include "exceptions.hpp"
+#include "queue.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace lockfree {
+
+struct ArenaOptions {
+    // Share of contended workers relative to the pool's other arenas.
+    uint32_t weight;
+    // Most workers the arena occupies at once; 0 for the whole pool.
+    size_t max_concurrency;
+    // Workers held back for this arena alone, even while it is idle.
+    size_t reserved;
+
+    ArenaOptions() : weight(1), max_concurrency(0), reserved(0) {}
+
+    ArenaOptions(uint32_t w, size_t max = 0, size_t reserve = 0)
+        : weight(w ? w : 1), max_concurrency(max), reserved(reserve) {}
+};
+
+// A logical executor on a shared ThreadPool, so several workloads (I/O
+// callbacks, request handling, background compaction) can share one set
+// of threads sized to the machine instead of one pool each.
+//
+//   ThreadPool pool(4);
+//   TaskArena requests(pool, ArenaOptions(4, 0, 1)); // one worker reserved
+//   TaskArena compaction(pool, ArenaOptions(1, 1));  // never above one
+//
+// Each arena queues its own tasks and runs them through drain tasks on
+// the pool, one drain per worker it occupies. A worker is either one of
+// the arena's reserved ones, which no other arena touches, or one of the
+// pool's shared ones (the workers nobody reserved). Reservations always
+// leave at least one worker shared, so arenas without one still run. A
+// drain gives its worker back after kMaxBatch tasks or kSliceMicros,
+// whichever comes first; the freed worker then goes to the waiting arena
+// with the least busy time per unit of weight, so under contention
+// arenas split the shared workers in proportion to their weights.
+//
+// Arenas only budget the work posted through them; tasks posted to the
+// pool directly compete with every arena. A pool holds at most
+// ArenaBudget::kMaxArenas arenas, and must outlive them. An arena waits
+// for its tasks when destroyed, and always for the drains the pool holds.
+class TaskArena : public detail::CacheAligned {
+public:
+    // Tasks a drain runs before giving its worker back.
+    static constexpr size_t kMaxBatch = 64;
+    // Longest a drain keeps its worker while other tasks are queued.
+    static constexpr int64_t kSliceMicros = 500;
+
+    explicit TaskArena(ThreadPool& pool,
+                       const ArenaOptions& options = ArenaOptions())
+        : pool_(&pool), budget_(&pool.arena_budget_), options_(options),
+          queue_(pool.backoff_policy()), slot_(nullptr) {
+        const size_t workers = budget_->capacity;
+        if (options_.weight == 0) {
+            options_.weight = 1;
+        }
+        if (options_.max_concurrency == 0 ||
+            options_.max_concurrency > workers) {
+            options_.max_concurrency = workers;
+        }
+        if (options_.reserved > options_.max_concurrency) {
+            detail::raise(std::invalid_argument(
+                "TaskArena reservation exceeds its concurrency limit"));
+        }
+        if (!budget_->reserve(options_.reserved)) {
+            detail::raise(std::invalid_argument(
+                "TaskArena reservations must leave a shared worker"));
+        }
+        consumed_.store(budget_->virtual_now.load(std::memory_order_relaxed) *
+                            options_.weight,
+                        std::memory_order_relaxed);
+        for (auto& slot : budget_->arenas) {
+            TaskArena* expected = nullptr;
+            if (slot.compare_exchange_strong(expected, this,
+                                             std::memory_order_seq_cst)) {
+                slot_ = &slot;
+                return;
+            }
+        }
+        budget_->unreserve(options_.reserved);
+        detail::raise(
+            std::length_error("too many TaskArenas on one ThreadPool"));
+    }
+
+    // Waits for queued tasks unless the pool has stopped; those left
+    // behind then are destroyed without running. Drains the pool still
+    // holds refer to the arena, so those are waited for either way: a
+    // stopping pool runs them (Drain) or drops them (Abort).
+    ~TaskArena() {
+        wait();
+        Backoff backoff(pool_->backoff_policy());
+        while (active_.load(std::memory_order_acquire) != 0) {
+            if (!backoff.pause()) {
+                std::this_thread::yield();
+            }
+        }
+        slot_->store(nullptr, std::memory_order_seq_cst);
+        while (budget_->walkers.load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+        budget_->unreserve(options_.reserved);
+    }
+
+    TaskArena(const TaskArena&) = delete;
+    TaskArena& operator=(const TaskArena&) = delete;
+
+    template <typename F>
+    void post(F&& f) {
+        if (!pool_->running()) {
+            detail::raise(std::runtime_error("ThreadPool is shutdown"));
+        }
+        Task task(std::forward<F>(f));
+        if (unfinished_.fetch_add(1, std::memory_order_relaxed) == 0) {
+            catch_up();
+        }
+        queued_.fetch_add(1, std::memory_order_seq_cst);
+        LOCKFREE_TRY {
+            queue_.push(std::move(task));
+        } LOCKFREE_CATCH_ALL {
+            // No node, so nothing will count the task out.
+            queued_.fetch_sub(1, std::memory_order_seq_cst);
+            unfinished_.fetch_sub(1, std::memory_order_release);
+            LOCKFREE_RETHROW;
+        }
+        try_start();
+    }
+
+    template <typename F>
+    auto submit(F&& f) -> std::future<decltype(f())> {
+        using ReturnType = decltype(f());
+        auto task = std::make_shared<std::packaged_task<ReturnType()>>(
+            std::forward<F>(f));
+        std::future<ReturnType> future = task->get_future();
+        post([task]() { (*task)(); });
+        return future;
+    }
+
+    // Returns once every task posted so far has run. Must not be called
+    // from a task running on the pool.
+    void wait() {
+        Backoff backoff(pool_->backoff_policy());
+        while (unfinished_.load(std::memory_order_acquire) != 0 ||
+               active_.load(std::memory_order_acquire) != 0) {
+            if (!pool_->running()) {
+                return;
+            }
+            if (!backoff.pause()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+    }
+
+    const ArenaOptions& options() const { return options_; }
+
+    // Tasks posted and not yet finished.
+    size_t pending_tasks() const {
+        return unfinished_.load(std::memory_order_relaxed);
+    }
+    // Workers running this arena's tasks right now.
+    size_t active_workers() const {
+        return active_.load(std::memory_order_relaxed);
+    }
+    size_t tasks_executed() const {
+        return executed_.load(std::memory_order_relaxed);
+    }
+    // Worker time spent in this arena's drains.
+    std::chrono::nanoseconds busy_time() const {
+        return std::chrono::nanoseconds(busy_ns_.load(std::memory_order_relaxed));
+    }
+
+private:
+    // A drain handed to the pool. If the pool drops it unrun, it still
+    // gives back its worker and its count in active_.
+    class DrainTask {
+    public:
+        DrainTask(TaskArena* arena, bool shared)
+            : arena_(arena), shared_(shared) {}
+        DrainTask(DrainTask&& other)
+            : arena_(other.arena_), shared_(other.shared_) {
+            other.arena_ = nullptr;
+        }
+        DrainTask(const DrainTask&) = delete;
+        DrainTask& operator=(const DrainTask&) = delete;
+
+        ~DrainTask() {
+            if (arena_) {
+                arena_->finish(shared_);
+            }
+        }
+
+        void operator()() {
+            TaskArena* arena = arena_;
+            arena_ = nullptr;
+            arena->drain(shared_);
+        }
+
+    private:
+        TaskArena* arena_;
+        bool shared_;
+    };
+
+    // Busy nanoseconds per unit of weight; the arena furthest behind
+    // gets the next shared worker.
+    uint64_t vruntime() const {
+        return consumed_.load(std::memory_order_relaxed) / options_.weight;
+    }
+
+    // More queued tasks than drains, and room for another drain.
+    bool runnable() const {
+        const size_t active = active_.load(std::memory_order_seq_cst);
+        return active < options_.max_concurrency &&
+               active < queued_.load(std::memory_order_seq_cst);
+    }
+
+    // Waking from idle: skip the virtual time the arena slept through.
+    void catch_up() {
+        const uint64_t floor =
+            budget_->virtual_now.load(std::memory_order_relaxed) *
+            options_.weight;
+        uint64_t consumed = consumed_.load(std::memory_order_relaxed);
+        while (consumed < floor &&
+               !consumed_.compare_exchange_weak(consumed, floor,
+                                                std::memory_order_relaxed)) {
+        }
+    }
+
+    // Starts one more drain if the arena has work for it and a worker
+    // to run it on. A failed attempt rechecks the budget after backing
+    // out, because a worker released meanwhile may have been offered to
+    // this arena while the attempt still counted as a drain.
+    bool try_start() {
+        for (;;) {
+            size_t active = active_.load(std::memory_order_seq_cst);
+            do {
+                if (active >= options_.max_concurrency ||
+                    active >= queued_.load(std::memory_order_seq_cst)) {
+                    return false;
+                }
+            } while (!active_.compare_exchange_weak(
+                active, active + 1, std::memory_order_seq_cst));
+
+            bool shared = false;
+            if (!take_reserved()) {
+                if (!budget_->try_acquire_shared()) {
+                    active_.fetch_sub(1, std::memory_order_seq_cst);
+                    if (budget_->shared_available() || reserved_available()) {
+                        continue;
+                    }
+                    return false;
+                }
+                shared = true;
+                advance_virtual_now();
+            }
+            if (pool_->try_post(DrainTask(this, shared)) != SubmitStatus::Ok) {
+                // The pool is shutting down; queued tasks stay behind.
+                // The refused DrainTask gave its worker back.
+                return false;
+            }
+            return true;
+        }
+    }
+
+    bool take_reserved() {
+        size_t used = reserved_in_use_.load(std::memory_order_seq_cst);
+        do {
+            if (used >= options_.reserved) {
+                return false;
+            }
+        } while (!reserved_in_use_.compare_exchange_weak(
+            used, used + 1, std::memory_order_seq_cst));
+        return true;
+    }
+
+    bool reserved_available() const {
+        return reserved_in_use_.load(std::memory_order_seq_cst) <
+               options_.reserved;
+    }
+
+    void release(bool shared) {
+        if (shared) {
+            budget_->release_shared();
+        } else {
+            reserved_in_use_.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+
+    // Ends a drain's hold on its worker. Once active_ drops, the
+    // destructor may return and this arena die.
+    void finish(bool shared) {
+        release(shared);
+        active_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void advance_virtual_now() {
+        const uint64_t now = vruntime();
+        uint64_t seen = budget_->virtual_now.load(std::memory_order_relaxed);
+        while (seen < now &&
+               !budget_->virtual_now.compare_exchange_weak(
+                   seen, now, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Runs one posted task. Whatever escapes it is logged like a failed
+    // pool task; submit() reports through its future instead.
+    static void run(Task& task) noexcept {
+#if LOCKFREE_HAS_EXCEPTIONS
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "TaskArena task exception: " << e.what() << "\n";
+        } catch (...) {
+            std::cerr << "TaskArena unknown task exception\n";
+        }
+#else
+        task();
+#endif
+    }
+
+    void drain(bool shared) {
+        typedef std::chrono::steady_clock Clock;
+        const int64_t slice = kSliceMicros;
+        const Clock::time_point start = Clock::now();
+        const Clock::time_point end = start + std::chrono::microseconds(slice);
+        Clock::time_point now = start;
+        size_t ran = 0;
+        Task task;
+        while (ran < kMaxBatch && now < end && queue_.pop(task)) {
+            queued_.fetch_sub(1, std::memory_order_seq_cst);
+            run(task);
+            task = nullptr;
+            ++ran;
+            now = Clock::now();
+            unfinished_.fetch_sub(1, std::memory_order_release);
+        }
+        const uint64_t busy = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - start)
+                .count());
+        consumed_.fetch_add(busy, std::memory_order_relaxed);
+        busy_ns_.fetch_add(busy, std::memory_order_relaxed);
+        executed_.fetch_add(ran, std::memory_order_relaxed);
+
+        detail::ArenaBudget* budget = budget_;
+        finish(shared);
+        // Only the budget is touched from here on.
+        dispatch(*budget);
+    }
+
+    // Offers the pool's free workers to the runnable arenas, furthest
+    // behind their weighted share first. Runs after every drain, so a
+    // drain's own arena competes for the worker it just gave back.
+    static void dispatch(detail::ArenaBudget& budget) {
+        budget.walkers.fetch_add(1, std::memory_order_seq_cst);
+        TaskArena* runnable[detail::ArenaBudget::kMaxArenas];
+        uint64_t vruntimes[detail::ArenaBudget::kMaxArenas];
+        size_t n = 0;
+        for (auto& slot : budget.arenas) {
+            TaskArena* arena = slot.load(std::memory_order_seq_cst);
+            if (!arena || !arena->runnable()) {
+                continue;
+            }
+            // Insertion sort; there are at most kMaxArenas.
+            const uint64_t v = arena->vruntime();
+            size_t i = n++;
+            for (; i > 0 && vruntimes[i - 1] > v; --i) {
+                runnable[i] = runnable[i - 1];
+                vruntimes[i] = vruntimes[i - 1];
+            }
+            runnable[i] = arena;
+            vruntimes[i] = v;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            runnable[i]->try_start();
+        }
+        budget.walkers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    ThreadPool* pool_;
+    detail::ArenaBudget* budget_;
+    ArenaOptions options_;
+    Queue<Task> queue_;
+    std::atomic<TaskArena*>* slot_;
+
+    // Posted and not yet run to the end; queued and not yet popped.
+    std::atomic<size_t> unfinished_{0};
+    std::atomic<size_t> queued_{0};
+    // Drains scheduled or running, and how many hold reserved workers.
+    std::atomic<size_t> active_{0};
+    std::atomic<size_t> reserved_in_use_{0};
+    // Busy time, seeded with the budget's virtual time at creation and
+    // on waking from idle; vruntime() divides it by the weight.
+    std::atomic<uint64_t> consumed_{0};
+    std::atomic<uint64_t> busy_ns_{0};
+    std::atomic<size_t> executed_{0};
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_TASK_ARENA_HPP
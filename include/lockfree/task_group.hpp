@@ -0,0 +1,164 @@
+#ifndef LOCKFREE_TASK_GROUP_HPP
+#define LOCKFREE_TASK_GROUP_HPP
+
+#include "backoff.hpp"
+#include "job_deque.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace lockfree {
+
+// Fork-join on a ThreadPool, for recursive algorithms that would
+// otherwise block a worker on a future per child:
+//
+//   int fib(ThreadPool& pool, int n) {
+//       if (n < 2) return n;
+//       int a, b;
+//       TaskGroup group(pool);
+//       group.spawn([&] { a = fib(pool, n - 1); });
+//       b = fib(pool, n - 2);
+//       group.sync();
+//       return a + b;
+//   }
+//
+// On a worker, spawn() pushes the child onto that worker's job deque;
+// idle workers steal from the other end. sync() never blocks while
+// there is work: it runs its own unstolen children inline, newest first,
+// then steals other workers' jobs until the stolen children finish, so
+// recursion depth is not bounded by the thread count. Children are
+// stolen rather than continuations: a library without compiler support
+// cannot move a running frame to another thread.
+//
+// The group lives on the spawner's stack. Its first kInlineJobs children
+// are stored inside it, further ones in blocks the group keeps for its
+// lifetime, so spawning allocates nothing as long as the closure fits in
+// a Task. Spawned from a thread outside the pool, children go through
+// the injection queue instead.
+//
+// spawn() and sync() belong to the thread that created the group. The
+// first exception a child throws is rethrown by sync(), after every
+// child has finished.
+class TaskGroup {
+public:
+    static constexpr size_t kInlineJobs = 4;
+    static constexpr size_t kJobBlock = 32;
+
+    explicit TaskGroup(ThreadPool& pool) : pool_(&pool), used_(0) {}
+
+    // Waits for outstanding children; an exception nobody synced on is
+    // dropped.
+    ~TaskGroup() {
+        wait();
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template <typename F>
+    void spawn(F&& f) {
+        detail::Job* job = allocate();
+        job->fn = Task(std::forward<F>(f));
+        job->group = &state_;
+        state_.pending.fetch_add(1, std::memory_order_relaxed);
+
+        if (detail::JobDeque* deque = pool_->local_jobs()) {
+            if (deque->push(job)) {
+                pool_->wake_idle();
+            } else {
+                // Deque full: the spawn tree is deep enough already.
+                job->run();
+            }
+            return;
+        }
+        // Refused once the pool has shut down: the ExternalJob is then
+        // destroyed unrun and fails the group, as if a shutdown dropped it.
+        pool_->try_post(ExternalJob(job));
+    }
+
+    // Returns once every child spawned so far has finished. Rethrows the
+    // first exception a child threw; the group can then be reused.
+    void sync() {
+        wait();
+        if (state_.failed.load(std::memory_order_relaxed)) {
+            std::exception_ptr error = std::move(state_.error);
+            state_.error = nullptr;
+            state_.failed.store(false, std::memory_order_relaxed);
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    // Carries a child through the injection queue. Destroyed unrun by a
+    // pool shutdown, it fails the group rather than leave sync() waiting.
+    struct ExternalJob {
+        detail::Job* job;
+
+        explicit ExternalJob(detail::Job* j) : job(j) {}
+        ExternalJob(ExternalJob&& other) noexcept : job(other.job) {
+            other.job = nullptr;
+        }
+        ExternalJob(const ExternalJob&) = delete;
+
+        ~ExternalJob() {
+            if (job) {
+                job->fn = nullptr;
+                job->group->fail(std::make_exception_ptr(
+                    std::runtime_error("ThreadPool shutdown")));
+                job->group->pending.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        void operator()() {
+            detail::Job* j = job;
+            job = nullptr;
+            j->run();
+        }
+    };
+
+    detail::Job* allocate() {
+        const size_t index = used_++;
+        if (index < kInlineJobs) {
+            return &inline_jobs_[index];
+        }
+        const size_t block = (index - kInlineJobs) / kJobBlock;
+        if (block == blocks_.size()) {
+            blocks_.emplace_back(new detail::Job[kJobBlock]);
+        }
+        return &blocks_[block][(index - kInlineJobs) % kJobBlock];
+    }
+
+    void wait() {
+        detail::JobDeque* deque = pool_->local_jobs();
+        Backoff backoff(pool_->backoff_policy());
+        while (state_.pending.load(std::memory_order_acquire) != 0) {
+            detail::Job* job = deque ? deque->pop(&state_) : nullptr;
+            if (!job) {
+                job = pool_->steal_job();
+            }
+            if (job) {
+                job->run();
+                backoff.reset();
+                continue;
+            }
+            // Every remaining child is running elsewhere.
+            backoff.pause();
+        }
+        used_ = 0;
+    }
+
+    ThreadPool* pool_;
+    detail::JobGroup state_;
+    size_t used_;
+    detail::Job inline_jobs_[kInlineJobs];
+    std::vector<std::unique_ptr<detail::Job[]>> blocks_;
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_TASK_GROUP_HPP
@@ -1,304 +1,559 @@
 #ifndef LOCKFREE_THREAD_POOL_HPP
 #define LOCKFREE_THREAD_POOL_HPP
 
+#include "arena_budget.hpp"
+#include "backoff.hpp"
+#include "cache_aligned.hpp"
+#include "exceptions.hpp"
+#include "io_poller.hpp"
+#include "job_deque.hpp"
 #include "queue.hpp"
+#include "schedule_point.hpp"
+#include "task.hpp"
+#include "timer_wheel.hpp"
+#include "trace.hpp"
 #include <vector>
 #include <thread>
 #include <functional>
 #include <atomic>
+#include <chrono>
 #include <future>
 #include <memory>
-#include <random>
 #include <iostream>
 #include <mutex>
+#include <ostream>
+#include <stdexcept>
 
 namespace lockfree {
 
-class ThreadPool {
+// Instantiated once in liblockfree (src/thread_pool.cpp) instead of in
+// every translation unit that includes this header.
+extern template Queue<Task>::Queue();
+extern template Queue<Task>::Queue(const BackoffPolicy&);
+extern template Queue<Task>::~Queue();
+extern template void Queue<Task>::push(Task&&);
+extern template bool Queue<Task>::pop(Task&);
+extern template size_t Queue<Task>::pop_bulk(std::vector<Task>&, size_t);
+extern template bool Queue<Task>::pop_wait(Task&);
+extern template void Queue<Task>::clear();
+extern template size_t Queue<Task>::get_active_nodes();
+extern template void Queue<Task>::force_release_nodes();
+extern template void Queue<Task>::link(Node*);
+extern template void Queue<Task>::link_chain(Node*, Node*, size_t);
+extern template bool Queue<Task>::claim_front(detail::HazardPointer&,
+                                              detail::HazardPointer&,
+                                              Node*&, Node*&);
+extern template bool Queue<Task>::spin_pop(Task&);
+extern template bool Queue<Task>::should_park() const;
+extern template void Queue<Task>::wake_waiters();
+
+enum class ShutdownMode {
+    // Finish queued tasks in parallel, up to a deadline.
+    Drain,
+    // Drop queued tasks and fail their futures.
+    Abort
+};
+
+// Order in which a worker runs the tasks it spawns itself.
+enum class SchedulingMode {
+    // Oldest first, like every other queue in the pool.
+    Fifo,
+    // The newest spawn goes into the worker's LIFO slot and runs next,
+    // while whatever it touched is still in L1. The task it displaces
+    // joins the local queue, which thieves still drain oldest first.
+    // The slot itself is never stolen, so a task must not block waiting
+    // on a task it spawned.
+    Lifo
+};
+
+// Outcome of the non-throwing submission calls.
+enum class SubmitStatus {
+    Ok,
+    // Shut down, or draining and the caller is not one of its workers.
+    Shutdown,
+    // Allocating the task or its queue node failed; nothing was queued.
+    NoMemory
+};
+
+class AsyncIo;
+class TaskArena;
+class TaskGroup;
+
+class ThreadPool : public detail::CacheAligned {
 public:
-    using Task = std::function<void()>;
+    // Move-only; closures up to Task::kInlineSize bytes are stored inline.
+    using Task = ::lockfree::Task;
 
 private:
-    struct alignas(64) Worker {  // Cache line alignment
+    friend class AsyncIo;
+    friend class TaskArena;
+    friend class TaskGroup;
+
+    struct alignas(64) Worker : detail::CacheAligned {  // Cache line alignment
+        // Thieves touch only the head_ and size_ lines; see Queue.
         Queue<Task> local_queue;
         std::atomic<bool> idle;
         std::thread thread;
-        std::atomic<bool> valid{true};
-        
-        Worker() : idle(false) {
-            std::cerr << "Worker constructor called\n";
-        }
+        // Owned by the worker thread: victim of the last successful steal
+        // and scratch space for stolen batches.
+        size_t last_victim;
+        std::vector<Task> steal_buffer;
+        // SchedulingMode::Lifo only: the worker's most recent spawn.
+        Task lifo_slot;
+        // Children spawned by TaskGroups running on this worker.
+        detail::JobDeque jobs;
+        // Paces the idle path from spinning to yielding to parking; the
+        // budget adapts to how soon this worker tends to find work.
+        BackoffState idle_backoff;
+        Backoff idle_wait;
+        // This worker's shard of the pool counters. Only the worker
+        // writes them, through bump(), and readers sum over all workers,
+        // so finishing a task costs two plain stores to a line nobody
+        // else writes instead of two locked adds on a shared one.
+        std::atomic<size_t> spawned;    // tasks it queued, due timers included
+        std::atomic<size_t> completed;  // tasks it ran to the end
+        std::atomic<size_t> executed;   // ... that did not throw
+        std::atomic<size_t> stolen;
+        std::atomic<size_t> steal_attempts;
+
+        explicit Worker(const BackoffPolicy& policy)
+            : local_queue(policy), idle(false), last_victim(0),
+              idle_backoff(policy), idle_wait(idle_backoff), spawned(0),
+              completed(0), executed(0), stolen(0), steal_attempts(0) {}
+        // Queued tasks are destroyed, never run, so their futures fail.
         ~Worker() {
-            std::cerr << "Worker destructor started\n";
-            valid.store(false, std::memory_order_release);
-            
-            // Ensure thread is stopped
-            if (thread.joinable()) {
-                std::cerr << "Joining worker thread...\n";
-                try {
-                    thread.join();
-                    std::cerr << "Worker thread joined successfully\n";
-                } catch (...) {
-                    std::cerr << "Error joining worker thread\n";
-                }
-            }
-            
-            // Safe queue clearing
-            std::cerr << "Clearing worker queue...\n";
-            try {
-                Task task;
-                while (true) {
-                    std::cerr << "Attempting to pop task...\n";
-                    if (!local_queue.pop(task)) {
-                        std::cerr << "Queue empty, stopping\n";
-                        break;
-                    }
-                    std::cerr << "Popped task\n";
-                    if (task) {
-                        try {
-                            std::cerr << "Executing task\n";
-                            task();
-                        } catch (...) {
-                            std::cerr << "Task execution error\n";
-                        }
-                    }
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "Queue clearing error: " << e.what() << "\n";
-            } catch (...) {
-                std::cerr << "Unknown queue clearing error\n";
-            }
-            
-            std::cerr << "Worker destructor completed\n";
-        }
-        
-        bool is_valid() const {
-            return valid.load(std::memory_order_acquire);
-        }
-        
-        void stop() {
-            valid.store(false, std::memory_order_release);
-            // Wake up the worker if it's waiting
-            local_queue.push([]{}); // Push empty task
             if (thread.joinable()) {
                 thread.join();
             }
         }
+
+        // Single-writer increment: a load and a release store, no lock
+        // prefix. Only valid on the counters above, from this worker.
+        static void bump(std::atomic<size_t>& counter, size_t n = 1) {
+            counter.store(counter.load(std::memory_order_relaxed) + n,
+                          std::memory_order_release);
+        }
     };
 
+    // Identifies the pool worker running on the current thread, if any.
+    struct WorkerContext {
+        const ThreadPool* pool;
+        size_t index;
+    };
+
+    static WorkerContext& current_worker() {
+        static thread_local WorkerContext context = {nullptr, 0};
+        return context;
+    }
+
+    // Upper bound on tasks a worker moves from the injector per refill.
+    static constexpr size_t kInjectorBatch = 32;
+    // Random victims a thief probes before going back to its idle path.
+    static constexpr size_t kMaxStealAttempts = 4;
+    // Loop iterations between timer and injector polls on a worker that
+    // never runs out of local work.
+    static constexpr size_t kPollInterval = 64;
+    // Consecutive LIFO slot runs before the local queue gets a turn, so
+    // a task that keeps respawning itself cannot starve older work.
+    static constexpr size_t kMaxLifoRuns = 3;
+    // Longest an idle worker parks before rechecking on its own, unless
+    // the timer wheel comes due sooner: a safety net behind the wake-ups
+    // push_task() and the wheel send.
+    static constexpr std::chrono::milliseconds kIdleParkInterval{50};
+
+    // Read-mostly state, checked on every submit and every worker loop
+    // pass but written only at construction, shutdown and when tracing
+    // is toggled. The members after it start new cache lines, so the
+    // counters below never invalidate it.
+    const SchedulingMode mode_;
+    const BackoffPolicy backoff_;
     std::vector<std::shared_ptr<Worker>> workers_;
-    Queue<Task> global_queue_;
+    // running_ gates external submissions. While a Drain is in progress
+    // draining_ still admits tasks spawned by workers; stop_ makes the
+    // workers exit.
     std::atomic<bool> running_{true};
-    std::atomic<int> active_tasks_{0};
-    // Performance counters
-    std::atomic<size_t> tasks_executed_{0};
-    std::atomic<size_t> tasks_stolen_{0};
-    std::atomic<size_t> steal_attempts_{0};
-    struct PromiseHolder {
-        virtual ~PromiseHolder() = default;
-        virtual void set_exception(std::exception_ptr e) = 0;
+    std::atomic<bool> draining_{false};
+    std::atomic<bool> stop_{false};
+    // Null unless tracing is enabled; rings 0..n-1 belong to the workers,
+    // ring n to submitters outside the pool.
+    std::atomic<Tracer*> tracer_{nullptr};
+
+    // Injection queue for submissions from threads outside the pool.
+    Queue<Task> global_queue_;
+    // Delayed and periodic tasks, advanced by workers on their idle path.
+    TimerWheel timers_;
+    // Tasks submitted from outside the pool. Together with the workers'
+    // spawned and completed shards it gives active_tasks().
+    alignas(64) std::atomic<size_t> injected_{0};
+    // Idle workers still looking for work, and idle workers parked. A
+    // submission wakes the parked ones only when nobody is looking.
+    alignas(64) std::atomic<size_t> searching_{0};
+    std::atomic<size_t> sleepers_{0};
+    std::unique_ptr<Tracer> trace_storage_;
+    // Shared by the TaskArenas on this pool.
+    detail::ArenaBudget arena_budget_;
+    // The attached AsyncIo, if any, and threads currently using it; it
+    // clears io_ and waits for users to leave before it dies.
+    std::atomic<detail::IoPoller*> io_{nullptr};
+    mutable std::atomic<size_t> io_users_{0};
+
+    // Shared state of a submitted task's future. A task destroyed without
+    // running, because shutdown dropped it, fails the future instead of
+    // leaving it to report broken_promise.
+    template <typename R>
+    struct TaskPromise {
+        std::promise<R> promise;
+        bool done = false;
+
+        template <typename Alloc>
+        TaskPromise(std::allocator_arg_t, const Alloc& alloc)
+            : promise(std::allocator_arg, alloc) {}
+
+        ~TaskPromise() {
+            if (!done) {
+                LOCKFREE_TRY {
+                    promise.set_exception(std::make_exception_ptr(
+                        std::runtime_error("ThreadPool shutdown")));
+                } LOCKFREE_CATCH_ALL {
+                }
+            }
+        }
     };
 
-    template<typename T>
-    struct TypedPromiseHolder : PromiseHolder {
-        std::shared_ptr<std::promise<T>> promise;
-        
-        explicit TypedPromiseHolder(std::shared_ptr<std::promise<T>> p) : promise(p) {}
-        
-        void set_exception(std::exception_ptr e) override {
-            try {
-                promise->set_exception(e);
-            } catch (...) {
-                // Ignore set_exception errors
+    // The task body submit() enqueues: runs func and fulfils the promise.
+    template <typename R, typename F>
+    struct PromiseTask {
+        std::shared_ptr<TaskPromise<R>> state;
+        F func;
+
+        template <typename G>
+        PromiseTask(std::shared_ptr<TaskPromise<R>> s, G&& g)
+            : state(std::move(s)), func(std::forward<G>(g)) {}
+
+        void operator()() {
+            LOCKFREE_TRY {
+                fulfil(std::is_void<R>());
+            } LOCKFREE_CATCH_ALL {
+                LOCKFREE_TRY {
+                    state->promise.set_exception(std::current_exception());
+                } LOCKFREE_CATCH_ALL {
+                    // Ignore set_exception errors
+                }
             }
+            state->done = true;
         }
+
+        void fulfil(std::true_type) {
+            func();
+            state->promise.set_value();
+        }
+
+        void fulfil(std::false_type) { state->promise.set_value(func()); }
     };
 
-    std::mutex pending_promises_mutex_;
-    std::vector<std::unique_ptr<PromiseHolder>> pending_promises_;
+    // Serializes shutdown() callers; workers are joined exactly once.
+    std::mutex shutdown_mutex_;
 
 public:
-    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency());
+    // backoff paces the pool's queues and idle workers; see BackoffPolicy.
+    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency(),
+                        SchedulingMode mode = SchedulingMode::Fifo,
+                        const BackoffPolicy& backoff = BackoffPolicy());
     
+    // Same as shutdown(ShutdownMode::Abort).
     ~ThreadPool() {
-        std::cerr << "ThreadPool destructor called\n";
-        try {
-            if (running_.exchange(false, std::memory_order_release)) {
-                std::cerr << "Shutting down workers...\n";
-                
-                // Phase 1: Cancel all pending promises
-                {
-                    auto promises = std::move(pending_promises_);
-                    pending_promises_.clear();
-                    
-                    for (auto it = promises.rbegin(); it != promises.rend(); ++it) {
-                        if (*it) {
-                            try {
-                                (*it)->set_exception(std::make_exception_ptr(
-                                    std::runtime_error("ThreadPool shutdown")));
-                            } catch (...) {
-                                // Ignore any errors
-                            }
-                        }
-                    }
-                }
+        shutdown(ShutdownMode::Abort);
+    }
 
-                // Phase 2: Stop all workers
-                for (auto& worker : workers_) {
-                    if (worker) {
-                        worker->stop();
-                    }
-                }
-                
-                // Phase 3: Clear all queues
-                global_queue_.clear();
-                for (auto& worker : workers_) {
-                    if (worker) {
-                        worker->local_queue.clear();
-                    }
-                }
-                
-                // Phase 4: Safety checks
-                active_tasks_.store(0, std::memory_order_release);
-                size_t remaining_nodes = Queue<Task>::get_active_nodes();
-                if (remaining_nodes > 0) {
-                    std::cerr << "Force releasing " << remaining_nodes << " remaining nodes\n";
-                    Queue<Task>::force_release_nodes();
-                }
-            }
-            
-            std::cerr << "ThreadPool destructor completed\n";
-        } catch (...) {
-            std::cerr << "Exception in ThreadPool destructor\n";
+    // Throwing entry points: std::runtime_error once the pool has shut
+    // down, std::bad_alloc if queueing the task fails. Without exceptions
+    // those abort; use try_post() and try_submit() there.
+    template<typename F>
+    auto submit(F&& f) -> std::future<decltype(f())> {
+        return submit(std::allocator_arg, std::allocator<char>(),
+                      std::forward<F>(f));
+    }
+
+    // Allocator-aware submit. The future's shared state, and the closure
+    // if it does not fit inline in a Task, are allocated from alloc, e.g.
+    // ArenaAllocator<char> to keep submits off the global heap.
+    template<typename Alloc, typename F>
+    auto submit(std::allocator_arg_t, const Alloc& alloc, F&& f)
+        -> std::future<decltype(f())> {
+        if (!accepting()) {
+            detail::raise(std::runtime_error("ThreadPool is shutdown"));
         }
+        std::future<decltype(f())> future;
+        Task task = promise_task(alloc, std::forward<F>(f), future);
+        check(push_task(std::move(task)));
+        return future;
     }
 
+    // Fire-and-forget submit for callers that do not need a result: no
+    // future, no shared promise state. Exceptions escaping f are caught
+    // and logged by the worker.
     template<typename F>
-    auto submit_impl(F&& f, std::true_type) -> std::future<void> {
-        auto promise = std::make_shared<std::promise<void>>();
-        auto future = promise->get_future();
-        
-        // Store promise in pending list before submission
-        {
-            std::unique_lock<std::mutex> lock(pending_promises_mutex_);
-            pending_promises_.emplace_back(
-                new TypedPromiseHolder<void>(promise));
+    void post(F&& f) {
+        if (!accepting()) {
+            detail::raise(std::runtime_error("ThreadPool is shutdown"));
         }
-        
-        auto wrapped_task = [promise, func = std::forward<F>(f)]() {
-            try {
-                func();
-                promise->set_value();
-            } catch (...) {
-                try {
-                    promise->set_exception(std::current_exception());
-                } catch (...) {
-                    // Ignore set_exception errors
-                }
-            }
-        };
-        
-        return submit_task(std::move(wrapped_task), std::move(future));
+        check(push_task(Task(std::forward<F>(f))));
     }
 
+    // Non-throwing post. Shutdown if the pool no longer accepts tasks
+    // from this thread, NoMemory if boxing the closure or queueing it
+    // failed (or the closure's constructor threw); f is then dropped.
     template<typename F>
-    auto submit_impl(F&& f, std::false_type) -> std::future<decltype(f())> {
-        using ReturnType = decltype(f());
-        auto promise = std::make_shared<std::promise<ReturnType>>();
-        auto future = promise->get_future();
-        
-        // Store promise in pending list before submission
-        {
-            std::unique_lock<std::mutex> lock(pending_promises_mutex_);
-            pending_promises_.emplace_back(
-                new TypedPromiseHolder<ReturnType>(promise));
+    SubmitStatus try_post(F&& f) noexcept {
+        if (!accepting()) {
+            return SubmitStatus::Shutdown;
+        }
+        LOCKFREE_TRY {
+            return push_task(Task(std::forward<F>(f)));
+        } LOCKFREE_CATCH_ALL {
+            return SubmitStatus::NoMemory;
         }
-        
-        auto wrapped_task = [promise, func = std::forward<F>(f)]() {
-            try {
-                promise->set_value(func());
-            } catch (...) {
-                try {
-                    promise->set_exception(std::current_exception());
-                } catch (...) {
-                    // Ignore set_exception errors
-                }
-            }
-        };
-        
-        return submit_task(std::move(wrapped_task), std::move(future));
     }
 
+    // Non-throwing submit; future is set only when Ok is returned. A task
+    // that throws still reports through the future, in builds with
+    // exceptions.
     template<typename F>
-    auto submit(F&& f) -> std::future<decltype(f())> {
-        if (!running_.load(std::memory_order_acquire)) {
-            throw std::runtime_error("ThreadPool is shutdown");
+    SubmitStatus try_submit(F&& f, std::future<decltype(f())>& future) noexcept {
+        if (!accepting()) {
+            return SubmitStatus::Shutdown;
+        }
+        LOCKFREE_TRY {
+            std::future<decltype(f())> pending;
+            Task task = promise_task(std::allocator<char>(), std::forward<F>(f),
+                                     pending);
+            const SubmitStatus status = push_task(std::move(task));
+            if (status == SubmitStatus::Ok) {
+                future = std::move(pending);
+            }
+            return status;
+        } LOCKFREE_CATCH_ALL {
+            return SubmitStatus::NoMemory;
         }
-
-        using ReturnType = decltype(f());
-        return submit_impl(std::forward<F>(f), std::is_void<ReturnType>());
     }
 
 private:
-    template<typename Task, typename Future>
-    Future submit_task(Task&& task, Future&& future) {
-        if (!running_.load(std::memory_order_acquire)) {
-            throw std::runtime_error("ThreadPool is shutdown");
+    template<typename Alloc, typename F, typename R>
+    static Task promise_task(const Alloc& alloc, F&& f, std::future<R>& future) {
+        using State = TaskPromise<R>;
+        std::shared_ptr<State> state =
+            std::allocate_shared<State>(alloc, std::allocator_arg, alloc);
+        future = state->promise.get_future();
+        PromiseTask<R, typename std::decay<F>::type> body(
+            std::move(state), std::forward<F>(f));
+        return Task(std::allocator_arg, alloc, std::move(body));
+    }
+
+    static void check(SubmitStatus status) {
+        if (status != SubmitStatus::Ok) {
+            detail::raise(std::bad_alloc());
         }
+    }
 
-        // Distribute tasks more evenly with retry logic
-        for (int attempt = 0; attempt < 3; ++attempt) {
-            try {
-                size_t min_index = 0;
-                size_t min_size = workers_[0]->local_queue.size();
-                for (size_t i = 1; i < workers_.size(); ++i) {
-                    size_t curr_size = workers_[i]->local_queue.size();
-                    if (curr_size < min_size) {
-                        min_size = curr_size;
-                        min_index = i;
-                    }
-                }
-                
-                try {
-                    workers_[min_index]->local_queue.push(std::forward<Task>(task));
-                    active_tasks_.fetch_add(1, std::memory_order_release);
-                    std::cerr << "Task submitted to worker " << min_index << "\n";
-                    return std::move(future);
-                } catch (const std::exception& e) {
-                    std::cerr << "Failed to submit task to worker " << min_index 
-                              << ": " << e.what() << "\n";
-                    active_tasks_.fetch_sub(1, std::memory_order_release);
-                    throw;
+    // The one path every submission takes. The task is counted in before
+    // it becomes visible to a worker and counted back out only if the
+    // push fails, which takes nothing but running out of memory; no
+    // retries, no logging. Callers have checked accepting().
+    SubmitStatus push_task(Task&& task) {
+        // Workers keep their own spawns local; everyone else goes through
+        // the injection queue that idle workers drain in batches.
+        const WorkerContext& context = current_worker();
+        const bool from_worker = context.pool == this;
+        trace(from_worker ? context.index : workers_.size(),
+              TraceEventKind::Submit, from_worker ? 1 : 0);
+
+        if (from_worker && mode_ == SchedulingMode::Lifo) {
+            Worker& self = *workers_[context.index];
+            if (self.lifo_slot) {
+                // The displaced task stays visible to thieves.
+                LOCKFREE_TRY {
+                    self.local_queue.push(std::move(self.lifo_slot));
+                } LOCKFREE_CATCH_ALL {
+                    return SubmitStatus::NoMemory;
                 }
-            } catch (const std::exception& e) {
-                std::cerr << "Task submission attempt " << attempt << " failed: " 
-                          << e.what() << "\n";
-                if (attempt == 2) throw;
             }
-            
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            self.lifo_slot = std::move(task);
+            Worker::bump(self.spawned);
+            wake_idle();
+            return SubmitStatus::Ok;
         }
-        
-        throw std::runtime_error("Failed to submit task after multiple attempts");
+
+        Queue<Task>& target = from_worker
+            ? workers_[context.index]->local_queue
+            : global_queue_;
+        count_queued(from_worker, context.index, 1);
+        LOCKFREE_SCHEDULE_POINT();
+        LOCKFREE_TRY {
+            target.push(std::move(task));
+        } LOCKFREE_CATCH_ALL {
+            count_queued(from_worker, context.index, -1);
+            return SubmitStatus::NoMemory;
+        }
+        wake_idle();
+        return SubmitStatus::Ok;
     }
 
 public:
+    // Runs f on a worker once delay has elapsed (1 ms resolution). The
+    // result is discarded; the handle cancels in O(1). Timers that are
+    // still pending at shutdown are cancelled and do not count towards
+    // wait().
+    template<typename Rep, typename Period, typename F>
+    TimerHandle submit_after(const std::chrono::duration<Rep, Period>& delay,
+                             F&& f) {
+        return submit_at(
+            TimerWheel::Clock::now() +
+                std::chrono::duration_cast<TimerWheel::Clock::duration>(delay),
+            std::forward<F>(f));
+    }
+
+    template<typename F>
+    TimerHandle submit_at(TimerWheel::Clock::time_point when, F&& f) {
+        if (!accepting()) {
+            detail::raise(std::runtime_error("ThreadPool is shutdown"));
+        }
+        return timers_.schedule(when, TimerWheel::Clock::duration::zero(),
+                                Task(std::forward<F>(f)));
+    }
+
+    // Runs f every period, first one period from now. Runs of the same
+    // timer never overlap; periods missed while the pool is saturated
+    // are skipped rather than run back to back.
+    template<typename Rep, typename Period, typename F>
+    TimerHandle submit_every(const std::chrono::duration<Rep, Period>& period,
+                             F&& f) {
+        if (!accepting()) {
+            detail::raise(std::runtime_error("ThreadPool is shutdown"));
+        }
+        const TimerWheel::Clock::duration interval =
+            std::chrono::duration_cast<TimerWheel::Clock::duration>(period);
+        return timers_.schedule(TimerWheel::Clock::now() + interval, interval,
+                                Task(std::forward<F>(f)));
+    }
+
     bool running() const {
         return running_.load(std::memory_order_acquire);
     }
+
+    SchedulingMode scheduling_mode() const { return mode_; }
+    const BackoffPolicy& backoff_policy() const { return backoff_; }
+
+    // Tasks queued or running, timers that have fired included. Summed
+    // over the per-worker shards, so it may briefly overcount while
+    // tasks complete, never undercount.
+    size_t active_tasks() const;
+
+    // Summed over the per-worker shards; exact once the pool is idle.
+    size_t tasks_executed() const {
+        return sum(&Worker::executed);
+    }
+    size_t tasks_stolen() const {
+        return sum(&Worker::stolen);
+    }
+    size_t steal_attempts() const {
+        return sum(&Worker::steal_attempts);
+    }
     
     void wait();
-    void shutdown();
+
+    // Stops accepting external submissions and joins the workers.
+    //
+    // Drain: workers keep running queued tasks, and tasks those spawn, in
+    // parallel until the pool is idle or timeout expires. Whatever is
+    // still queued then is dropped. Returns true if nothing was dropped.
+    //
+    // Abort: queued tasks are dropped right away. Returns true.
+    //
+    // A task already running is always allowed to finish, so teardown is
+    // bounded by timeout plus the longest running task. Dropped tasks
+    // never run; their futures throw std::runtime_error. Calling again
+    // after the pool has stopped is a no-op. Must not be called from a
+    // task running on this pool.
+    bool shutdown(ShutdownMode mode = ShutdownMode::Drain,
+                  std::chrono::steady_clock::duration timeout =
+                      std::chrono::seconds(30));
+
+    // Starts recording submit, task, steal and idle events into per-worker
+    // rings of events_per_thread entries each, keeping the newest events.
+    // Not thread-safe against itself or disable_tracing().
+    void enable_tracing(size_t events_per_thread = 1 << 16);
+    void disable_tracing();
+    // Exports the recorded events as Chrome trace JSON for chrome://tracing
+    // or ui.perfetto.dev. Returns false if tracing was never enabled.
+    bool write_trace(std::ostream& out) const;
 
 private:
-    
+    bool accepting() const {
+        if (running_.load(std::memory_order_acquire)) {
+            return true;
+        }
+        return draining_.load(std::memory_order_acquire) &&
+               current_worker().pool == this;
+    }
+
+    void stop_workers();
+    void drop_queued_tasks();
+
+    size_t sum(std::atomic<size_t> Worker::*counter) const {
+        size_t total = 0;
+        for (const auto& worker : workers_) {
+            total += ((*worker).*counter).load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Counts a task in before it becomes visible to any worker, or back
+    // out (delta -1) when the push failed.
+    void count_queued(bool from_worker, size_t index, int delta) {
+        if (from_worker) {
+            Worker::bump(workers_[index]->spawned, static_cast<size_t>(delta));
+        } else if (delta > 0) {
+            injected_.fetch_add(1, std::memory_order_release);
+        } else {
+            injected_.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void trace(size_t ring, TraceEventKind kind, uint64_t arg = 0) {
+        Tracer* tracer = tracer_.load(std::memory_order_acquire);
+        if (tracer) {
+            tracer->record(ring, kind, arg);
+        }
+    }
+
     void worker_loop(size_t worker_id);
+    bool poll_timers(Worker* self);
+    bool poll_io(Worker* self, std::vector<Task>& batch);
+    bool wait_io(std::chrono::steady_clock::time_point deadline);
+    void wake_io();
+    // Null if no AsyncIo is attached; otherwise pinned until unpin_io().
+    detail::IoPoller* pin_io() const;
+    void unpin_io() const {
+        io_users_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+    void attach_io(detail::IoPoller* io);
+    void detach_io(detail::IoPoller* io);
+    void run_task(Task& task, size_t worker_id);
+    void set_idle(Worker* self, size_t worker_id, bool idle);
+    void park_idle(Worker* self);
+    bool has_queued_work() const;
+    bool io_needs_worker() const;
+    void wake_idle();
+    bool pop_injected(Task& task, std::vector<Task>& batch,
+                      Queue<Task>& local);
     bool steal_task(Task& task, size_t thief_id);
+    // TaskGroup support: the calling worker's job deque (null outside
+    // the pool), and one job taken from another worker's deque.
+    detail::JobDeque* local_jobs() const;
+    detail::Job* steal_job();
     size_t select_victim(size_t thief_id);
 };
 
 } // namespace lockfree
 
-#include "thread_pool.ipp"
-
 #endif // LOCKFREE_THREAD_POOL_HPP
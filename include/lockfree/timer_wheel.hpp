@@ -0,0 +1,691 @@
+#ifndef LOCKFREE_TIMER_WHEEL_HPP
+#define LOCKFREE_TIMER_WHEEL_HPP
+
+#include "cache_aligned.hpp"
+#include "exceptions.hpp"
+#include "task.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace lockfree {
+
+class TimerWheel;
+
+namespace detail {
+
+// One scheduled callable. Lives in exactly one place at a time: the
+// wheel's inbox, a wheel slot, or a fired task; next links the first two.
+// A cancelled node also sits on the wheel's cancel stack until the
+// poller unlinks it from its slot.
+struct TimerNode {
+    enum State : int {
+        Pending,          // waiting in the inbox or a slot
+        Firing,           // handed to a task that is about to run it
+        Done,             // one-shot that has run
+        Cancelled,
+        CancelRequested   // periodic timer cancelled while running
+    };
+
+    Task fn;
+    uint64_t deadline;  // in wheel ticks
+    uint64_t period;    // in wheel ticks, 0 for one-shot
+    TimerNode* next;
+    // While filed in a slot: the pointer that points at this node, and
+    // the slot as level * 256 + index. Owned by the polling thread.
+    TimerNode** pprev;
+    unsigned slot;
+    TimerNode* cancelled_next;
+    std::atomic<TimerNode*>* cancelled;  // the wheel's cancel stack
+    std::atomic<int> state;
+    std::atomic<int> refs;
+
+    TimerNode(Task f, uint64_t d, uint64_t p, std::atomic<TimerNode*>* c)
+        : fn(std::move(f)), deadline(d), period(p), next(nullptr),
+          pprev(nullptr), slot(0), cancelled_next(nullptr), cancelled(c),
+          state(Pending), refs(1) {}
+};
+
+// Intrusive reference to a TimerNode.
+class TimerRef {
+public:
+    TimerRef() : node_(nullptr) {}
+    // Adopts one reference the caller already holds.
+    explicit TimerRef(TimerNode* node) : node_(node) {}
+    TimerRef(const TimerRef& other) : node_(other.node_) {
+        if (node_) node_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    TimerRef(TimerRef&& other) : node_(other.node_) { other.node_ = nullptr; }
+    TimerRef& operator=(TimerRef other) {
+        std::swap(node_, other.node_);
+        return *this;
+    }
+    ~TimerRef() {
+        if (node_ && node_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete node_;
+        }
+    }
+
+    TimerNode* get() const { return node_; }
+    TimerNode* operator->() const { return node_; }
+    explicit operator bool() const { return node_ != nullptr; }
+
+private:
+    TimerNode* node_;
+};
+
+} // namespace detail
+
+// Caller's side of a scheduled timer.
+class TimerHandle {
+public:
+    TimerHandle() {}
+
+    // O(1). Stops every future run and destroys the callable right away
+    // unless a run is in progress, in which case the running task drops
+    // it. The node goes onto the wheel's cancel stack, and the next
+    // poll() unlinks and frees it however far out its deadline was.
+    // Returns false if there was nothing left to cancel, e.g. a one-shot
+    // that already fired.
+    bool cancel() {
+        if (!node_) {
+            return false;
+        }
+        std::atomic<int>& state = node_->state;
+        int s = state.load(std::memory_order_acquire);
+        for (;;) {
+            if (s == detail::TimerNode::Pending) {
+                if (state.compare_exchange_weak(s, detail::TimerNode::Cancelled,
+                                                std::memory_order_acq_rel)) {
+                    node_->fn = nullptr;
+                    push_cancelled();
+                    return true;
+                }
+            } else if (s == detail::TimerNode::Firing && node_->period != 0) {
+                if (state.compare_exchange_weak(
+                        s, detail::TimerNode::CancelRequested,
+                        std::memory_order_acq_rel)) {
+                    return true;
+                }
+            } else {
+                return false;
+            }
+        }
+    }
+
+    // True while the timer may still run.
+    bool active() const {
+        if (!node_) {
+            return false;
+        }
+        int s = node_->state.load(std::memory_order_acquire);
+        return s == detail::TimerNode::Pending ||
+               (s == detail::TimerNode::Firing && node_->period != 0);
+    }
+
+private:
+    friend class TimerWheel;
+    explicit TimerHandle(detail::TimerRef node) : node_(std::move(node)) {}
+
+    // Pending turns Cancelled only once, so the node is pushed at most
+    // once; the stack holds its own reference.
+    void push_cancelled() {
+        detail::TimerNode* node = node_.get();
+        node->refs.fetch_add(1, std::memory_order_relaxed);
+        std::atomic<detail::TimerNode*>& stack = *node->cancelled;
+        detail::TimerNode* head = stack.load(std::memory_order_relaxed);
+        do {
+            node->cancelled_next = head;
+        } while (!stack.compare_exchange_weak(head, node,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    detail::TimerRef node_;
+};
+
+// Hierarchical timing wheel (4 levels of 256 slots, as in the Linux
+// kernel timer wheel). Any thread may schedule or cancel in O(1): new
+// timers go onto a lock-free inbox stack, and cancellation flips the
+// node state and pushes the node onto a second one. A single thread at
+// a time, whoever wins poll()'s try-lock, moves inbox entries into
+// slots, advances the wheel and hands due timers to a fire callback,
+// which is expected to run them through run(). Slots are doubly linked,
+// so the poller unlinks cancelled nodes as soon as it sees them on the
+// cancel stack rather than when their slot comes due.
+class TimerWheel : public detail::CacheAligned {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1),
+                        Clock::time_point origin = Clock::now())
+        : tick_(tick > Clock::duration::zero() ? tick : Clock::duration(1)),
+          origin_(origin), current_(0), inbox_(nullptr), cancelled_(nullptr),
+          pending_(0), next_due_(kNever), polling_(false), wake_(nullptr),
+          wake_context_(nullptr) {
+        for (auto& level : slots_) {
+            for (auto& slot : level) {
+                slot = nullptr;
+            }
+        }
+        reset_counts();
+    }
+
+    ~TimerWheel() { clear(); }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Runs fn once at or after deadline, then every period if period is
+    // non-zero. Times are rounded up to whole ticks.
+    TimerHandle schedule(Clock::time_point deadline, Clock::duration period,
+                         Task fn) {
+        uint64_t period_ticks = 0;
+        if (period > Clock::duration::zero()) {
+            period_ticks = ticks_ceil(period);
+            if (period_ticks == 0) period_ticks = 1;
+        }
+        detail::TimerNode* node = new detail::TimerNode(
+            std::move(fn), deadline_tick(deadline), period_ticks, &cancelled_);
+        node->refs.store(2, std::memory_order_relaxed);  // wheel + handle
+        push_inbox(node);
+        return TimerHandle(detail::TimerRef(node));
+    }
+
+    // Timers scheduled and not yet fired or reclaimed, cancelled ones
+    // included. A relaxed read, cheap enough to gate poll() on.
+    size_t pending() const { return pending_.load(std::memory_order_relaxed); }
+
+    // When poll() next has something to do: a timer coming due, or a
+    // coarser slot to cascade. Never later than the earliest pending
+    // timer; time_point::max() if there is none. Pollers park until then.
+    Clock::time_point next_deadline() const {
+        const uint64_t tick = next_due_.load(std::memory_order_seq_cst);
+        if (tick == kNever) {
+            return Clock::time_point::max();
+        }
+        return origin_ + tick_ * static_cast<Clock::rep>(tick);
+    }
+
+    // Called, from whichever thread scheduled or re-armed the timer,
+    // whenever next_deadline() moves earlier, so a poller parked until
+    // the old deadline can be woken. Set before the wheel is shared.
+    void set_wake(void (*wake)(void*), void* context) {
+        wake_ = wake;
+        wake_context_ = context;
+    }
+
+    // Advances the wheel to now and calls fire(detail::TimerRef) for every
+    // due timer. Returns the number fired, or 0 right away if another
+    // thread is already polling. If fire throws, the exception propagates
+    // and the timers not yet handed out fire on the next poll; fire must
+    // then have dropped its timer through abandon(), as TimerTask does.
+    template <typename Fire>
+    size_t poll(Clock::time_point now, Fire&& fire) {
+        if (pending() == 0 ||
+            polling_.exchange(true, std::memory_order_acquire)) {
+            return 0;
+        }
+        PollGuard guard = {this, nullptr};
+        reclaim_cancelled();
+
+        size_t fired = 0;
+        const uint64_t target = now > origin_ ? ticks_floor(now - origin_) : 0;
+        if (target > current_ && lowest_occupied_level() == kLevels) {
+            current_ = target;  // Nothing in the slots; skip the idle gap.
+        }
+        detail::TimerNode* due = nullptr;
+        drain_inbox(due);
+
+        while (current_ < target) {
+            // Levels below the lowest occupied one are empty, so jump
+            // straight to the next boundary of that level.
+            const unsigned level = lowest_occupied_level();
+            if (level == kLevels) {
+                current_ = target;
+                break;
+            }
+            if (level > 0) {
+                const unsigned shift = kLevelBits * level;
+                const uint64_t boundary = ((current_ >> shift) + 1) << shift;
+                if (boundary > target) {
+                    current_ = target;
+                    break;
+                }
+                current_ = boundary - 1;
+            }
+            ++current_;
+            cascade();
+            detail::TimerNode* list = take(0, current_ & kSlotMask);
+            while (list) {
+                detail::TimerNode* node = list;
+                list = list->next;
+                node->next = due;
+                due = node;
+            }
+        }
+
+        // Cascading and expiry appended in reverse; restore deadline order.
+        detail::TimerNode* ordered = nullptr;
+        while (due) {
+            detail::TimerNode* node = due;
+            due = due->next;
+            node->next = ordered;
+            ordered = node;
+        }
+        while (ordered) {
+            detail::TimerNode* node = ordered;
+            ordered = ordered->next;
+            guard.rest = ordered;
+            node->next = nullptr;
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            int expected = detail::TimerNode::Pending;
+            detail::TimerRef ref(node);  // Takes over the wheel's reference
+            if (node->state.compare_exchange_strong(
+                    expected, detail::TimerNode::Firing,
+                    std::memory_order_acq_rel)) {
+                ++fired;
+                fire(std::move(ref));
+            }
+        }
+        return fired;
+    }
+
+    // Runs a timer handed out by poll() and re-arms it if periodic.
+    void run(const detail::TimerRef& node) {
+        LOCKFREE_TRY {
+            node->fn();
+        } LOCKFREE_CATCH_ALL {
+            finish(node);
+            LOCKFREE_RETHROW;
+        }
+        finish(node);
+    }
+
+    // For a timer poll() handed out whose task is dropped without running,
+    // e.g. by a pool shutting down: it will not run again, so it ends up
+    // cancelled rather than stuck in Firing.
+    static void abandon(const detail::TimerRef& node) {
+        node->fn = nullptr;
+        node->state.store(detail::TimerNode::Cancelled, std::memory_order_release);
+    }
+
+    // Cancels and frees every timer still held by the wheel. Not safe to
+    // call concurrently with poll().
+    void clear() {
+        reclaim_cancelled();
+        detail::TimerNode* list = inbox_.exchange(nullptr, std::memory_order_acquire);
+        for (auto& level : slots_) {
+            for (auto& slot : level) {
+                detail::TimerNode* tail = slot;
+                if (!tail) continue;
+                while (tail->next) tail = tail->next;
+                tail->next = list;
+                list = slot;
+                slot = nullptr;
+            }
+        }
+        while (list) {
+            detail::TimerNode* node = list;
+            list = list->next;
+            node->pprev = nullptr;
+            int expected = detail::TimerNode::Pending;
+            if (node->state.compare_exchange_strong(
+                    expected, detail::TimerNode::Cancelled,
+                    std::memory_order_acq_rel)) {
+                node->fn = nullptr;
+            }
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            detail::TimerRef drop(node);
+        }
+        reset_counts();
+        next_due_.store(kNever, std::memory_order_seq_cst);
+    }
+
+private:
+    static constexpr unsigned kLevelBits = 8;
+    static constexpr size_t kSlots = size_t(1) << kLevelBits;
+    static constexpr uint64_t kSlotMask = kSlots - 1;
+    static constexpr unsigned kLevels = 4;
+    static constexpr size_t kMapWords = kSlots / 64;
+    static constexpr uint64_t kNever = ~uint64_t(0);
+
+    uint64_t ticks_floor(Clock::duration d) const {
+        return static_cast<uint64_t>(d / tick_);
+    }
+
+    uint64_t ticks_ceil(Clock::duration d) const {
+        return static_cast<uint64_t>((d + tick_ - Clock::duration(1)) / tick_);
+    }
+
+    uint64_t deadline_tick(Clock::time_point deadline) const {
+        return deadline > origin_ ? ticks_ceil(deadline - origin_) : 0;
+    }
+
+    // Publishes the next deadline and releases the poll lock. If fire()
+    // threw, the timers after it go back to the inbox, still counted in
+    // pending_, and are due at once.
+    struct PollGuard {
+        TimerWheel* wheel;
+        detail::TimerNode* rest;
+
+        ~PollGuard() {
+            while (rest) {
+                detail::TimerNode* node = rest;
+                rest = rest->next;
+                wheel->link_inbox(node);
+            }
+            wheel->publish_next_due();
+            wheel->polling_.store(false, std::memory_order_release);
+        }
+    };
+
+    void push_inbox(detail::TimerNode* node) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        link_inbox(node);
+        // Pairs with publish_next_due(): either the poller sees this node
+        // in the inbox, or this sees the value it stored.
+        uint64_t due = next_due_.load(std::memory_order_seq_cst);
+        while (node->deadline < due) {
+            if (next_due_.compare_exchange_weak(due, node->deadline,
+                                                std::memory_order_seq_cst)) {
+                if (wake_) {
+                    wake_(wake_context_);
+                }
+                return;
+            }
+        }
+    }
+
+    void link_inbox(detail::TimerNode* node) {
+        detail::TimerNode* head = inbox_.load(std::memory_order_relaxed);
+        do {
+            node->next = head;
+        } while (!inbox_.compare_exchange_weak(head, node,
+                                               std::memory_order_seq_cst,
+                                               std::memory_order_relaxed));
+    }
+
+    // Stores the earliest tick at which the slots need a poll. Anything
+    // left in the inbox is unfiled and may be due, so that means now.
+    void publish_next_due() {
+        uint64_t due = kNever;
+        for (unsigned level = 0; level < kLevels; ++level) {
+            if (level_count_[level] == 0) {
+                continue;
+            }
+            // A level 0 slot expires at its tick; a coarser slot is
+            // cascaded when current_ reaches the start of its range.
+            const unsigned shift = kLevelBits * level;
+            const uint64_t turn = current_ >> shift;
+            const uint64_t tick =
+                (turn + distance_to_occupied(level, turn & kSlotMask)) << shift;
+            if (tick < due) {
+                due = tick;
+            }
+        }
+        next_due_.store(due, std::memory_order_seq_cst);
+        if (inbox_.load(std::memory_order_seq_cst)) {
+            next_due_.store(current_, std::memory_order_seq_cst);
+        }
+    }
+
+    // Steps from slot pos to the next occupied slot of level, 1 to kSlots;
+    // pos itself is a full turn away. The level must not be empty.
+    uint64_t distance_to_occupied(unsigned level, uint64_t pos) const {
+        const uint64_t start = (pos + 1) & kSlotMask;
+        for (uint64_t k = 0; k < kSlots;) {
+            const uint64_t index = (start + k) & kSlotMask;
+            const uint64_t bits = occupied_[level][index / 64] >> (index % 64);
+            if (bits) {
+                return k + 1 + lowest_bit(bits);
+            }
+            k += 64 - index % 64;
+        }
+        return kSlots;
+    }
+
+    static unsigned lowest_bit(uint64_t bits) {
+#if defined(__GNUC__)
+        return static_cast<unsigned>(__builtin_ctzll(bits));
+#else
+        unsigned n = 0;
+        while (!(bits & 1)) {
+            bits >>= 1;
+            ++n;
+        }
+        return n;
+#endif
+    }
+
+    void reset_counts() {
+        for (auto& count : level_count_) {
+            count = 0;
+        }
+        for (auto& level : occupied_) {
+            for (auto& word : level) {
+                word = 0;
+            }
+        }
+    }
+
+    void drain_inbox(detail::TimerNode*& due) {
+        detail::TimerNode* list = inbox_.exchange(nullptr, std::memory_order_acquire);
+        while (list) {
+            detail::TimerNode* node = list;
+            list = list->next;
+            if (node->state.load(std::memory_order_relaxed) ==
+                detail::TimerNode::Cancelled) {
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                detail::TimerRef drop(node);
+                continue;
+            }
+            insert(node, due);
+        }
+    }
+
+    // Frees the cancelled nodes still filed in a slot. Nodes cancelled in
+    // the inbox are dropped by drain_inbox(), and ones already taken for
+    // firing by the loop in poll(); either way the stack's own reference
+    // goes here.
+    void reclaim_cancelled() {
+        detail::TimerNode* list =
+            cancelled_.exchange(nullptr, std::memory_order_acquire);
+        while (list) {
+            detail::TimerNode* node = list;
+            list = list->cancelled_next;
+            if (node->pprev) {
+                unlink(node);
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                detail::TimerRef drop_wheel(node);
+            }
+            detail::TimerRef drop(node);
+        }
+    }
+
+    void link(unsigned level, uint64_t index, detail::TimerNode* node) {
+        detail::TimerNode*& slot = slots_[level][index];
+        node->next = slot;
+        if (slot) {
+            slot->pprev = &node->next;
+        }
+        slot = node;
+        node->pprev = &slot;
+        node->slot = static_cast<unsigned>(level * kSlots + index);
+        ++level_count_[level];
+        occupied_[level][index / 64] |= uint64_t(1) << (index % 64);
+    }
+
+    void unlink(detail::TimerNode* node) {
+        *node->pprev = node->next;
+        if (node->next) {
+            node->next->pprev = node->pprev;
+        }
+        node->pprev = nullptr;
+        node->next = nullptr;
+        const unsigned level = static_cast<unsigned>(node->slot / kSlots);
+        const uint64_t index = node->slot % kSlots;
+        --level_count_[level];
+        if (!slots_[level][index]) {
+            occupied_[level][index / 64] &= ~(uint64_t(1) << (index % 64));
+        }
+    }
+
+    // Files node by how far its deadline is from current_; anything due
+    // now goes straight onto due.
+    void insert(detail::TimerNode* node, detail::TimerNode*& due) {
+        if (node->deadline <= current_) {
+            node->next = due;
+            due = node;
+            return;
+        }
+        const uint64_t delta = node->deadline - current_;
+        unsigned level = 0;
+        while (level + 1 < kLevels &&
+               delta >= (uint64_t(1) << (kLevelBits * (level + 1)))) {
+            ++level;
+        }
+        uint64_t index;
+        if (level + 1 == kLevels &&
+            delta >= (uint64_t(1) << (kLevelBits * kLevels))) {
+            // Beyond the wheel's span: park in the top slot cascaded last
+            // and re-file from there.
+            index = ((current_ >> (kLevelBits * level)) + kSlotMask) & kSlotMask;
+        } else {
+            index = (node->deadline >> (kLevelBits * level)) & kSlotMask;
+        }
+        link(level, index, node);
+    }
+
+    unsigned lowest_occupied_level() const {
+        unsigned level = 0;
+        while (level < kLevels && level_count_[level] == 0) {
+            ++level;
+        }
+        return level;
+    }
+
+    detail::TimerNode* take(unsigned level, uint64_t index) {
+        detail::TimerNode* list = slots_[level][index];
+        slots_[level][index] = nullptr;
+        occupied_[level][index / 64] &= ~(uint64_t(1) << (index % 64));
+        for (detail::TimerNode* n = list; n; n = n->next) {
+            n->pprev = nullptr;
+            --level_count_[level];
+        }
+        return list;
+    }
+
+    // When current_ crosses a level boundary, re-files that level's slot
+    // into the finer levels below it, highest level first.
+    void cascade() {
+        if (current_ & kSlotMask) {
+            return;
+        }
+        unsigned top = 1;
+        while (top + 1 < kLevels &&
+               ((current_ >> (kLevelBits * top)) & kSlotMask) == 0) {
+            ++top;
+        }
+        for (unsigned level = top; level >= 1; --level) {
+            detail::TimerNode* list =
+                take(level, (current_ >> (kLevelBits * level)) & kSlotMask);
+            while (list) {
+                detail::TimerNode* node = list;
+                list = list->next;
+                if (node->state.load(std::memory_order_relaxed) ==
+                    detail::TimerNode::Cancelled) {
+                    pending_.fetch_sub(1, std::memory_order_relaxed);
+                    detail::TimerRef drop(node);
+                    continue;
+                }
+                detail::TimerNode* due = nullptr;
+                insert(node, due);
+                if (due) {
+                    // Deadline is exactly current_; expire with level 0.
+                    link(0, current_ & kSlotMask, due);
+                }
+            }
+        }
+    }
+
+    void finish(const detail::TimerRef& node) {
+        if (node->period == 0) {
+            node->fn = nullptr;
+            node->state.store(detail::TimerNode::Done, std::memory_order_release);
+            return;
+        }
+        // Fixed rate; periods missed while the pool was busy are skipped.
+        const Clock::time_point t = Clock::now();
+        const uint64_t now = t > origin_ ? ticks_floor(t - origin_) : 0;
+        uint64_t next = node->deadline + node->period;
+        if (next <= now) {
+            next += ((now - next) / node->period + 1) * node->period;
+        }
+        node->deadline = next;
+        int expected = detail::TimerNode::Firing;
+        if (node->state.compare_exchange_strong(expected,
+                                                detail::TimerNode::Pending,
+                                                std::memory_order_acq_rel)) {
+            node->refs.fetch_add(1, std::memory_order_relaxed);
+            push_inbox(node.get());
+        } else {
+            node->fn = nullptr;
+            node->state.store(detail::TimerNode::Cancelled,
+                              std::memory_order_release);
+        }
+    }
+
+    const Clock::duration tick_;
+    const Clock::time_point origin_;
+    // Owned by the polling thread.
+    uint64_t current_;
+    size_t level_count_[kLevels];
+    uint64_t occupied_[kLevels][kMapWords];  // a bit per non-empty slot
+    detail::TimerNode* slots_[kLevels][kSlots];
+
+    alignas(64) std::atomic<detail::TimerNode*> inbox_;
+    std::atomic<detail::TimerNode*> cancelled_;
+    std::atomic<size_t> pending_;
+    // In ticks; kNever while nothing is pending.
+    std::atomic<uint64_t> next_due_;
+    std::atomic<bool> polling_;
+    void (*wake_)(void*);
+    void* wake_context_;
+};
+
+namespace detail {
+
+// A timer poll() handed out, as a pool task: runs it once, or abandons it
+// if the task is dropped unrun.
+class TimerTask {
+public:
+    TimerTask(TimerWheel& wheel, TimerRef node)
+        : wheel_(&wheel), node_(std::move(node)) {}
+    TimerTask(TimerTask&& other)
+        : wheel_(other.wheel_), node_(std::move(other.node_)) {}
+    TimerTask(const TimerTask&) = delete;
+    TimerTask& operator=(const TimerTask&) = delete;
+
+    ~TimerTask() {
+        if (node_) {
+            TimerWheel::abandon(node_);
+        }
+    }
+
+    void operator()() {
+        TimerRef node(std::move(node_));
+        wheel_->run(node);
+    }
+
+private:
+    TimerWheel* wheel_;
+    TimerRef node_;
+};
+
+} // namespace detail
+} // namespace lockfree
+
+#endif // LOCKFREE_TIMER_WHEEL_HPP
@@ -0,0 +1,247 @@
+#ifndef LOCKFREE_TRACE_HPP
+#define LOCKFREE_TRACE_HPP
+
+#include "cache_aligned.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace lockfree {
+
+enum class TraceEventKind : uint32_t {
+    Submit,     // arg: 1 if submitted from a pool worker
+    TaskBegin,
+    TaskEnd,
+    Steal,      // arg: victim << 32 | tasks taken
+    ParkBegin,  // worker found no work and went idle
+    ParkEnd
+};
+
+struct TraceEvent {
+    uint64_t timestamp;  // detail::trace_clock() ticks
+    uint64_t arg;
+    TraceEventKind kind;
+};
+
+namespace detail {
+
+// Cheapest monotonic tick source available: the TSC on x86, the virtual
+// counter on AArch64, steady_clock nanoseconds elsewhere. Ticks are
+// converted to wall time only when a trace is exported.
+inline uint64_t trace_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline uint64_t trace_wall_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace detail
+
+// Fixed-size ring of trace events that overwrites its oldest entries.
+// Writers claim a slot with one fetch_add and publish it through a
+// per-slot sequence number, so snapshot() can run concurrently with
+// record() and simply skips slots that are being rewritten.
+class TraceRing : public detail::CacheAligned {
+public:
+    explicit TraceRing(size_t capacity) : head_(0) {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        mask_ = n - 1;
+        slots_.reset(new Slot[n]);
+    }
+
+    TraceRing(const TraceRing&) = delete;
+    TraceRing& operator=(const TraceRing&) = delete;
+
+    void record(TraceEventKind kind, uint64_t arg) {
+        const uint64_t timestamp = detail::trace_clock();
+        const uint64_t index = head_.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots_[index & mask_];
+        slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.timestamp.store(timestamp, std::memory_order_relaxed);
+        slot.arg.store(arg, std::memory_order_relaxed);
+        slot.kind.store(static_cast<uint32_t>(kind), std::memory_order_relaxed);
+        slot.seq.store(2 * index + 2, std::memory_order_release);
+    }
+
+    // Appends the retained events to out, oldest first.
+    void snapshot(std::vector<TraceEvent>& out) const {
+        const uint64_t end = head_.load(std::memory_order_acquire);
+        const uint64_t capacity = mask_ + 1;
+        const uint64_t begin = end > capacity ? end - capacity : 0;
+        for (uint64_t i = begin; i < end; ++i) {
+            const Slot& slot = slots_[i & mask_];
+            if (slot.seq.load(std::memory_order_acquire) != 2 * i + 2) {
+                continue;
+            }
+            TraceEvent event;
+            event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+            event.arg = slot.arg.load(std::memory_order_relaxed);
+            event.kind = static_cast<TraceEventKind>(
+                slot.kind.load(std::memory_order_relaxed));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == 2 * i + 2) {
+                out.push_back(event);
+            }
+        }
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Events recorded so far, including overwritten ones.
+    uint64_t recorded() const { return head_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> timestamp{0};
+        std::atomic<uint64_t> arg{0};
+        std::atomic<uint32_t> kind{0};
+    };
+
+    alignas(64) std::atomic<uint64_t> head_;
+    uint64_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+// A set of named trace rings, one per recording thread, exported as
+// Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+class Tracer {
+public:
+    Tracer(const std::vector<std::string>& thread_names,
+           size_t events_per_thread)
+        : names_(thread_names),
+          origin_ticks_(detail::trace_clock()),
+          origin_ns_(detail::trace_wall_ns()) {
+        rings_.reserve(names_.size());
+        for (size_t i = 0; i < names_.size(); ++i) {
+            rings_.emplace_back(new TraceRing(events_per_thread));
+        }
+    }
+
+    void record(size_t ring, TraceEventKind kind, uint64_t arg = 0) {
+        rings_[ring]->record(kind, arg);
+    }
+
+    size_t ring_count() const { return rings_.size(); }
+    const TraceRing& ring(size_t index) const { return *rings_[index]; }
+
+    // Writes every retained event. One tid per ring; task and park
+    // intervals become B/E slices, submits and steals instant events.
+    void write_chrome_trace(std::ostream& out) const {
+        // Calibrate ticks against steady_clock over the tracer's lifetime.
+        const uint64_t now_ticks = detail::trace_clock();
+        const uint64_t now_ns = detail::trace_wall_ns();
+        double us_per_tick = 1e-3;
+        if (now_ticks > origin_ticks_ && now_ns > origin_ns_) {
+            us_per_tick = 1e-3 * static_cast<double>(now_ns - origin_ns_) /
+                          static_cast<double>(now_ticks - origin_ticks_);
+        }
+
+        const std::ios_base::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        std::vector<TraceEvent> events;
+        for (size_t tid = 0; tid < rings_.size(); ++tid) {
+            separator(out, first);
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                << tid << ",\"args\":{\"name\":\"" << names_[tid] << "\"}}";
+
+            events.clear();
+            rings_[tid]->snapshot(events);
+            // A wrapped ring can start inside a slice; drop the orphaned ends.
+            int task_depth = 0;
+            int park_depth = 0;
+            for (const TraceEvent& e : events) {
+                if (e.timestamp < origin_ticks_) {
+                    continue;
+                }
+                const double ts =
+                    static_cast<double>(e.timestamp - origin_ticks_) * us_per_tick;
+                switch (e.kind) {
+                case TraceEventKind::TaskBegin:
+                    ++task_depth;
+                    write_event(out, first, "task", "B", ts, tid);
+                    out << "}";
+                    break;
+                case TraceEventKind::TaskEnd:
+                    if (task_depth == 0) break;
+                    --task_depth;
+                    write_event(out, first, "task", "E", ts, tid);
+                    out << "}";
+                    break;
+                case TraceEventKind::ParkBegin:
+                    ++park_depth;
+                    write_event(out, first, "idle", "B", ts, tid);
+                    out << "}";
+                    break;
+                case TraceEventKind::ParkEnd:
+                    if (park_depth == 0) break;
+                    --park_depth;
+                    write_event(out, first, "idle", "E", ts, tid);
+                    out << "}";
+                    break;
+                case TraceEventKind::Submit:
+                    write_event(out, first, "submit", "i", ts, tid);
+                    out << ",\"s\":\"t\",\"args\":{\"from_worker\":"
+                        << (e.arg ? "true" : "false") << "}}";
+                    break;
+                case TraceEventKind::Steal:
+                    write_event(out, first, "steal", "i", ts, tid);
+                    out << ",\"s\":\"t\",\"args\":{\"victim\":" << (e.arg >> 32)
+                        << ",\"tasks\":" << (e.arg & 0xffffffffu) << "}}";
+                    break;
+                }
+            }
+        }
+        out << "]}\n";
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    static void separator(std::ostream& out, bool& first) {
+        if (!first) out << ",";
+        first = false;
+    }
+
+    static void write_event(std::ostream& out, bool& first, const char* name,
+                            const char* phase, double ts, size_t tid) {
+        separator(out, first);
+        out << "{\"name\":\"" << name << "\",\"ph\":\"" << phase
+            << "\",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << tid;
+    }
+
+    std::vector<std::string> names_;
+    std::vector<std::unique_ptr<TraceRing>> rings_;
+    const uint64_t origin_ticks_;
+    const uint64_t origin_ns_;
+};
+
+} // namespace lockfree
+
+#endif // LOCKFREE_TRACE_HPP
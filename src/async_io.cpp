@@ -0,0 +1,954 @@
+#include "lockfree/async_io.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+// Waiting with a timeout needs IORING_ENTER_EXT_ARG (Linux 5.11).
+#if defined(__NR_io_uring_setup) && defined(IORING_ENTER_EXT_ARG)
+#define LOCKFREE_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+#ifndef LOCKFREE_HAVE_IO_URING
+#define LOCKFREE_HAVE_IO_URING 0
+#endif
+
+namespace lockfree {
+namespace detail {
+
+// An AsyncIo backend. Both keep in_flight_ from submit() until the
+// operation's completion task has been reaped.
+class IoDevice : public IoPoller {
+public:
+    // False if the operation could not be queued; it is then untouched.
+    virtual bool submit(IoOp* op, bool from_worker) noexcept = 0;
+    virtual int register_buffers(const struct iovec* buffers,
+                                 unsigned count) = 0;
+    virtual int unregister_buffers() = 0;
+    // Called once the pool has stopped: hurries the operations in flight
+    // to a completion, usually -ECANCELED, or stops counting them.
+    virtual void cancel() = 0;
+
+    size_t in_flight() const {
+        return in_flight_.load(std::memory_order_acquire);
+    }
+
+protected:
+    std::atomic<size_t> in_flight_{0};
+};
+
+} // namespace detail
+
+namespace {
+
+using detail::IoOp;
+
+// Completions moved per reap() outside the workers' loop.
+constexpr size_t kReapBatch = 32;
+// Linux transfers at most this much per read or write call.
+constexpr size_t kMaxTransfer = 0x7ffff000;
+// Offset meaning the file's own position, as io_uring reads it.
+constexpr uint64_t kCurrentPosition = static_cast<uint64_t>(-1);
+
+// A reaped completion as a pool task: runs the handler once, or frees
+// the operation unrun if the pool drops the task.
+class IoCompletion {
+public:
+    explicit IoCompletion(IoOp* op) noexcept : op_(op) {}
+    IoCompletion(IoCompletion&& other) noexcept : op_(other.op_) {
+        other.op_ = nullptr;
+    }
+    IoCompletion(const IoCompletion&) = delete;
+    IoCompletion& operator=(const IoCompletion&) = delete;
+
+    ~IoCompletion() {
+        if (op_) {
+            op_->finish(op_, false);
+        }
+    }
+
+    void operator()() {
+        IoOp* op = op_;
+        op_ = nullptr;
+        op->finish(op, true);
+    }
+
+private:
+    IoOp* op_;
+};
+
+// Handler behind the future-returning calls. Destroyed without running,
+// because the submission was refused or dropped, it reports -ECANCELED.
+class PromiseHandler {
+public:
+    explicit PromiseHandler(std::promise<int>&& promise)
+        : promise_(std::move(promise)), pending_(true) {}
+    PromiseHandler(PromiseHandler&& other)
+        : promise_(std::move(other.promise_)), pending_(other.pending_) {
+        other.pending_ = false;
+    }
+
+    ~PromiseHandler() {
+        if (pending_) {
+            promise_.set_value(-ECANCELED);
+        }
+    }
+
+    void operator()(int result) {
+        pending_ = false;
+        promise_.set_value(result);
+    }
+
+private:
+    std::promise<int> promise_;
+    bool pending_;
+};
+
+// The Threads backend: a few threads run the blocking calls, and push
+// finished operations onto an intrusive stack the workers reap. What
+// the threads touch lives in a State they share, so a thread left
+// blocked by cancel() can outlive the device.
+class ThreadDevice : public detail::IoDevice {
+public:
+    ThreadDevice(size_t threads, void (*wake)(void*), void* pool)
+        : state_(new State(threads, wake, pool)), abandoned_(threads, false) {
+        threads_.reserve(threads);
+        LOCKFREE_TRY {
+            for (size_t i = 0; i < threads; ++i) {
+                std::shared_ptr<State> state = state_;
+                threads_.emplace_back([state, i] { run(*state, i); });
+            }
+        } LOCKFREE_CATCH_ALL {
+            stop();
+            LOCKFREE_RETHROW;
+        }
+    }
+
+    ~ThreadDevice() override { stop(); }
+
+    bool submit(IoOp* op, bool) noexcept override {
+        in_flight_.fetch_add(1, std::memory_order_seq_cst);
+        LOCKFREE_TRY {
+            state_->requests.push(op);
+            return true;
+        } LOCKFREE_CATCH_ALL {
+            in_flight_.fetch_sub(1, std::memory_order_seq_cst);
+            return false;
+        }
+    }
+
+    size_t reap(std::vector<Task>& out, size_t max) override {
+        bool expected = false;
+        if (!reaping_.compare_exchange_strong(expected, true,
+                                              std::memory_order_acquire)) {
+            return 0;
+        }
+        if (!reaped_) {
+            // The stack is newest first; reverse it to run oldest first.
+            IoOp* op = state_->finished.exchange(nullptr,
+                                                 std::memory_order_acquire);
+            while (op) {
+                IoOp* next = op->next;
+                op->next = reaped_;
+                reaped_ = op;
+                op = next;
+            }
+        }
+        size_t n = 0;
+        while (reaped_ && n < max) {
+            IoOp* op = reaped_;
+            reaped_ = op->next;
+            out.push_back(Task(IoCompletion(op)));
+            ++n;
+        }
+        state_->finished_count.fetch_sub(n, std::memory_order_seq_cst);
+        in_flight_.fetch_sub(n, std::memory_order_acq_rel);
+        reaping_.store(false, std::memory_order_release);
+        return n;
+    }
+
+    bool ready() const override {
+        return state_->finished_count.load(std::memory_order_seq_cst) != 0;
+    }
+
+    // Completions arrive through wake, so workers simply park.
+    bool needs_waiter() const override { return false; }
+    bool begin_wait() override { return false; }
+    void wait_until(std::chrono::steady_clock::time_point) override {}
+    void end_wait() override {}
+    void wake() override {}
+
+    // Queued operations are dropped unstarted. A call already blocked
+    // cannot be interrupted; one still blocked after kAbandonGrace is
+    // abandoned to its thread, which frees it once the call returns and
+    // is detached rather than joined.
+    void cancel() override {
+        state_->cancelled.store(true, std::memory_order_seq_cst);
+        const auto deadline = std::chrono::steady_clock::now() + kAbandonGrace;
+        while (busy() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        for (size_t i = 0; i < threads_.size(); ++i) {
+            if (state_->current[i].exchange(nullptr,
+                                            std::memory_order_acq_rel)) {
+                abandoned_[i] = true;
+                in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+            }
+        }
+        // Abandoned threads serve no more requests; the pool has stopped,
+        // so nothing new arrives behind these.
+        IoOp* op = nullptr;
+        while (state_->requests.pop(op)) {
+            op->finish(op, false);
+            in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    int register_buffers(const struct iovec* buffers,
+                         unsigned count) override {
+        std::lock_guard<std::mutex> lock(state_->buffers_mutex);
+        if (!state_->buffers.empty()) {
+            return -EBUSY;
+        }
+        if (count == 0) {
+            return -EINVAL;
+        }
+        LOCKFREE_TRY {
+            state_->buffers.assign(buffers, buffers + count);
+        } LOCKFREE_CATCH_ALL {
+            return -ENOMEM;
+        }
+        return 0;
+    }
+
+    int unregister_buffers() override {
+        std::lock_guard<std::mutex> lock(state_->buffers_mutex);
+        if (state_->buffers.empty()) {
+            return -ENXIO;
+        }
+        state_->buffers.clear();
+        return 0;
+    }
+
+private:
+    // Long enough for a file read to land, so only calls waiting on
+    // something that may never come, like an idle pipe, are abandoned.
+    static constexpr std::chrono::milliseconds kAbandonGrace{100};
+
+    struct State : detail::CacheAligned {
+        State(size_t threads, void (*wake_fn)(void*), void* pool_ptr)
+            : wake(wake_fn), pool(pool_ptr),
+              current(new std::atomic<IoOp*>[threads]) {
+            for (size_t i = 0; i < threads; ++i) {
+                current[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        void (*const wake)(void*);
+        void* const pool;
+        Queue<IoOp*> requests;
+        std::atomic<IoOp*> finished{nullptr};
+        std::atomic<size_t> finished_count{0};
+        std::atomic<bool> cancelled{false};
+        // The operation each thread is performing; whoever swaps it out
+        // owns it, the thread on return or cancel() to abandon it.
+        std::unique_ptr<std::atomic<IoOp*>[]> current;
+        std::mutex buffers_mutex;
+        std::vector<struct iovec> buffers;
+    };
+
+    static void run(State& state, size_t index) {
+        std::atomic<IoOp*>& current = state.current[index];
+        IoOp* op = nullptr;
+        while (state.requests.pop_wait(op) && op) {
+            current.store(op, std::memory_order_seq_cst);
+            op->result = state.cancelled.load(std::memory_order_seq_cst)
+                             ? -ECANCELED
+                             : perform(state, *op);
+            if (current.exchange(nullptr, std::memory_order_acq_rel) != op) {
+                // Abandoned: nobody reaps it, and the device may be gone.
+                op->finish(op, false);
+                return;
+            }
+            // Counted first, so ready() never lags a reapable operation.
+            state.finished_count.fetch_add(1, std::memory_order_seq_cst);
+            IoOp* head = state.finished.load(std::memory_order_relaxed);
+            do {
+                op->next = head;
+            } while (!state.finished.compare_exchange_weak(
+                head, op, std::memory_order_release,
+                std::memory_order_relaxed));
+            state.wake(state.pool);
+        }
+    }
+
+    static int perform(State& state, const IoOp& op) {
+        if ((op.kind == IoOp::ReadFixed || op.kind == IoOp::WriteFixed) &&
+            !in_registered_buffer(state, op)) {
+            return -EFAULT;
+        }
+        const size_t length = std::min(op.length, kMaxTransfer);
+        const off_t offset = static_cast<off_t>(op.offset);
+        const bool positioned = op.offset != kCurrentPosition;
+        ssize_t result;
+        do {
+            switch (op.kind) {
+            case IoOp::Read:
+            case IoOp::ReadFixed:
+                result = positioned ? ::pread(op.fd, op.data, length, offset)
+                                    : ::read(op.fd, op.data, length);
+                break;
+            case IoOp::Write:
+            case IoOp::WriteFixed:
+                result = positioned ? ::pwrite(op.fd, op.data, length, offset)
+                                    : ::write(op.fd, op.data, length);
+                break;
+            default:
+                result = ::fsync(op.fd);
+                break;
+            }
+        } while (result < 0 && errno == EINTR);
+        return result < 0 ? -errno : static_cast<int>(result);
+    }
+
+    static bool in_registered_buffer(State& state, const IoOp& op) {
+        std::lock_guard<std::mutex> lock(state.buffers_mutex);
+        const std::vector<struct iovec>& buffers = state.buffers;
+        if (op.buffer >= buffers.size()) {
+            return false;
+        }
+        const char* base = static_cast<const char*>(buffers[op.buffer].iov_base);
+        const char* data = static_cast<const char*>(op.data);
+        return data >= base &&
+               op.length <= buffers[op.buffer].iov_len &&
+               static_cast<size_t>(data - base) <=
+                   buffers[op.buffer].iov_len - op.length;
+    }
+
+    bool busy() const {
+        for (size_t i = 0; i < threads_.size(); ++i) {
+            if (state_->current[i].load(std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // A null request stops one thread; abandoned ones stop on their own.
+    void stop() {
+        for (size_t i = 0; i < threads_.size(); ++i) {
+            state_->requests.push(nullptr);
+        }
+        for (size_t i = 0; i < threads_.size(); ++i) {
+            if (abandoned_[i]) {
+                threads_[i].detach();
+            } else if (threads_[i].joinable()) {
+                threads_[i].join();
+            }
+        }
+        threads_.clear();
+    }
+
+    std::shared_ptr<State> state_;
+    std::vector<std::thread> threads_;
+    std::vector<bool> abandoned_;
+    // Owned by whoever holds reaping_: finished operations taken off
+    // the stack and not yet handed out, oldest first.
+    std::atomic<bool> reaping_{false};
+    IoOp* reaped_ = nullptr;
+};
+
+constexpr std::chrono::milliseconds ThreadDevice::kAbandonGrace;
+
+#if LOCKFREE_HAVE_IO_URING
+
+int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                   unsigned flags, const void* arg, size_t arg_size) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, arg, arg_size));
+}
+
+int io_uring_register(int fd, unsigned opcode, const void* arg,
+                      unsigned count) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// The ring indices are shared with the kernel.
+unsigned load_acquire(const unsigned* index) {
+    return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+void store_release(unsigned* index, unsigned value) {
+    __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+// The io_uring backend, driven through the raw system calls. Workers
+// submit straight into the ring; everything else, and whatever does not
+// fit, waits in a backlog that reap() hands in. An eventfd read is kept
+// armed on the ring so wake() can cut a blocked waiter short.
+class UringDevice : public detail::IoDevice {
+public:
+    // Null, with error set, if the kernel refuses the ring or lacks what
+    // this backend relies on.
+    static UringDevice* create(unsigned entries, int& error) {
+        std::unique_ptr<UringDevice> device(new UringDevice());
+        error = device->init(std::max(entries, 2u));
+        return error == 0 ? device.release() : nullptr;
+    }
+
+    ~UringDevice() override {
+        if (wake_armed_) {
+            // Let the read finish before its buffer goes away. Nothing
+            // else is in flight by now.
+            signal();
+            for (int attempt = 0; wake_armed_ && attempt < 100; ++attempt) {
+                wait_for(std::chrono::milliseconds(10));
+                unsigned head = *cq_head_;
+                const unsigned tail = load_acquire(cq_tail_);
+                for (; head != tail; ++head) {
+                    if (cqes_[head & cq_mask_].user_data == kWakeTag) {
+                        wake_armed_ = false;
+                    }
+                }
+                store_release(cq_head_, head);
+            }
+        }
+        if (sqes_) {
+            munmap(sqes_, sqes_size_);
+        }
+        if (cq_ring_ && cq_ring_ != sq_ring_) {
+            munmap(cq_ring_, cq_ring_size_);
+        }
+        if (sq_ring_) {
+            munmap(sq_ring_, sq_ring_size_);
+        }
+        if (ring_fd_ >= 0) {
+            close(ring_fd_);
+        }
+        if (event_fd_ >= 0) {
+            close(event_fd_);
+        }
+    }
+
+    bool submit(IoOp* op, bool from_worker) noexcept override {
+        in_flight_.fetch_add(1, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (from_worker && !backlog_head_ && in_kernel_ < limit_ &&
+            push(op)) {
+            ++in_kernel_;
+            flush();
+        } else {
+            op->next = nullptr;
+            if (backlog_tail_) {
+                backlog_tail_->next = op;
+            } else {
+                backlog_head_ = op;
+            }
+            backlog_tail_ = op;
+            ++backlog_size_;
+            update_unsent();
+        }
+        return true;
+    }
+
+    size_t reap(std::vector<Task>& out, size_t max) override {
+        bool expected = false;
+        if (!reaping_.compare_exchange_strong(expected, true,
+                                              std::memory_order_acquire)) {
+            return 0;
+        }
+        unsigned head = *cq_head_;
+        const unsigned tail = load_acquire(cq_tail_);
+        size_t n = 0;
+        bool rearm = false;
+        for (; head != tail && n < max; ++head) {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            if (cqe.user_data == kWakeTag) {
+                rearm = true;
+                continue;
+            }
+            if (cqe.user_data == kCancelTag) {
+                continue;
+            }
+            IoOp* op = reinterpret_cast<IoOp*>(
+                static_cast<uintptr_t>(cqe.user_data));
+            op->result = cqe.res;
+            out.push_back(Task(IoCompletion(op)));
+            ++n;
+        }
+        store_release(cq_head_, head);
+        if (n != 0 || rearm || unsent_.load(std::memory_order_seq_cst) != 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            in_kernel_ -= n;
+            if (rearm) {
+                wake_armed_ = false;
+                arm_wake();
+            }
+            while (backlog_head_ && in_kernel_ < limit_ && push(backlog_head_)) {
+                backlog_head_ = backlog_head_->next;
+                if (!backlog_head_) {
+                    backlog_tail_ = nullptr;
+                }
+                --backlog_size_;
+                ++in_kernel_;
+            }
+            flush();
+        }
+        in_flight_.fetch_sub(n, std::memory_order_acq_rel);
+        reaping_.store(false, std::memory_order_release);
+        return n;
+    }
+
+    bool ready() const override {
+        return load_acquire(cq_tail_) != __atomic_load_n(cq_head_, __ATOMIC_RELAXED) ||
+               unsent_.load(std::memory_order_seq_cst) != 0;
+    }
+
+    bool needs_waiter() const override {
+        return in_flight_.load(std::memory_order_seq_cst) != 0 &&
+               !waiter_.load(std::memory_order_seq_cst);
+    }
+
+    bool begin_wait() override {
+        if (in_flight_.load(std::memory_order_seq_cst) == 0) {
+            return false;
+        }
+        bool expected = false;
+        return waiter_.compare_exchange_strong(expected, true,
+                                               std::memory_order_seq_cst);
+    }
+
+    void wait_until(std::chrono::steady_clock::time_point deadline) override {
+        const auto now = std::chrono::steady_clock::now();
+        if (deadline > now) {
+            wait_for(deadline - now);
+        }
+    }
+
+    void end_wait() override {
+        waiter_.store(false, std::memory_order_seq_cst);
+    }
+
+    void wake() override {
+        if (waiter_.load(std::memory_order_seq_cst)) {
+            signal();
+        }
+    }
+
+    // The backlog is dropped here; the kernel gets one cancel matching
+    // every request it holds (Linux 5.19), and those complete through
+    // reap() as usual, with -ECANCELED unless they had already finished.
+    void cancel() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (backlog_head_) {
+            IoOp* op = backlog_head_;
+            backlog_head_ = op->next;
+            op->finish(op, false);
+            in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        backlog_tail_ = nullptr;
+        backlog_size_ = 0;
+#ifdef IORING_ASYNC_CANCEL_ANY
+        if (in_kernel_ != 0) {
+            if (io_uring_sqe* sqe = next_sqe()) {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+                sqe->user_data = kCancelTag;
+                commit_sqe();
+            }
+        }
+#endif
+        flush();
+    }
+
+    int register_buffers(const struct iovec* buffers,
+                         unsigned count) override {
+        return io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, buffers,
+                                 count) < 0 ? -errno : 0;
+    }
+
+    int unregister_buffers() override {
+        return io_uring_register(ring_fd_, IORING_UNREGISTER_BUFFERS, nullptr,
+                                 0) < 0 ? -errno : 0;
+    }
+
+private:
+    // user_data of the eventfd read and of cancel(); operations carry
+    // their address, which is never that small.
+    static constexpr uint64_t kWakeTag = 0;
+    static constexpr uint64_t kCancelTag = 1;
+
+    UringDevice() = default;
+
+    // 0 or an errno value.
+    int init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+#ifdef IORING_SETUP_CLAMP
+        params.flags = IORING_SETUP_CLAMP;
+#endif
+        ring_fd_ = io_uring_setup(entries, &params);
+        if (ring_fd_ < 0) {
+            return errno;
+        }
+        if (!(params.features & IORING_FEAT_EXT_ARG) ||
+            !(params.features & IORING_FEAT_NODROP)) {
+            return ENOSYS;
+        }
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+        sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+        if (!sq_ring_) {
+            return errno;
+        }
+        cq_ring_ = single_mmap ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+        if (!cq_ring_) {
+            return errno;
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+        if (!sqes_) {
+            return errno;
+        }
+
+        char* sq = static_cast<char*>(sq_ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_entries_ = params.sq_entries;
+        char* cq = static_cast<char*>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        // One entry stays free for the eventfd read; the completion ring
+        // is twice the size, so it cannot overflow.
+        limit_ = sq_entries_ - 1;
+
+        event_fd_ = eventfd(0, EFD_CLOEXEC);
+        if (event_fd_ < 0) {
+            return errno;
+        }
+        return check_wake();
+    }
+
+    void* map(size_t size, off_t offset) {
+        void* ring = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+        return ring == MAP_FAILED ? nullptr : ring;
+    }
+
+    // Proves the wake-up path on a signalled eventfd, which completes the
+    // read at once, then arms it for real.
+    int check_wake() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        signal();
+        arm_wake();
+        flush();
+        for (int attempt = 0; wake_armed_ && attempt < 100; ++attempt) {
+            wait_for(std::chrono::milliseconds(10));
+            unsigned head = *cq_head_;
+            const unsigned tail = load_acquire(cq_tail_);
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                if (cqe.user_data == kWakeTag) {
+                    wake_armed_ = false;
+                    if (cqe.res != sizeof(wake_value_)) {
+                        store_release(cq_head_, head + 1);
+                        return cqe.res < 0 ? -cqe.res : EIO;
+                    }
+                }
+            }
+            store_release(cq_head_, head);
+        }
+        if (wake_armed_) {
+            return ETIMEDOUT;
+        }
+        arm_wake();
+        flush();
+        return 0;
+    }
+
+    void signal() {
+        const uint64_t one = 1;
+        const ssize_t written = ::write(event_fd_, &one, sizeof(one));
+        (void)written;
+    }
+
+    // Blocks until a completion is posted or timeout expires.
+    void wait_for(std::chrono::steady_clock::duration timeout) {
+        const auto ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+        __kernel_timespec ts;
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+        io_uring_getevents_arg arg;
+        std::memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uintptr_t>(&ts);
+        io_uring_enter(ring_fd_, 0, 1,
+                       IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                       sizeof(arg));
+    }
+
+    // The rest runs under mutex_.
+
+    // Fills the next submission entry; false if the ring is full.
+    bool push(const IoOp* op) {
+        io_uring_sqe* sqe = next_sqe();
+        if (!sqe) {
+            return false;
+        }
+        switch (op->kind) {
+        case IoOp::Read:
+            sqe->opcode = IORING_OP_READ;
+            break;
+        case IoOp::Write:
+            sqe->opcode = IORING_OP_WRITE;
+            break;
+        case IoOp::Fsync:
+            sqe->opcode = IORING_OP_FSYNC;
+            break;
+        case IoOp::ReadFixed:
+            sqe->opcode = IORING_OP_READ_FIXED;
+            break;
+        case IoOp::WriteFixed:
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            break;
+        }
+        sqe->fd = op->fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(op->data);
+        sqe->len = static_cast<uint32_t>(std::min(op->length, kMaxTransfer));
+        sqe->off = op->offset;
+        sqe->buf_index = static_cast<uint16_t>(
+            std::min(op->buffer, static_cast<unsigned>(UINT16_MAX)));
+        sqe->user_data = reinterpret_cast<uintptr_t>(op);
+        commit_sqe();
+        return true;
+    }
+
+    void arm_wake() {
+        io_uring_sqe* sqe = next_sqe();
+        if (!sqe) {
+            return;
+        }
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = event_fd_;
+        sqe->addr = reinterpret_cast<uintptr_t>(&wake_value_);
+        sqe->len = sizeof(wake_value_);
+        sqe->off = kCurrentPosition;
+        sqe->user_data = kWakeTag;
+        commit_sqe();
+        wake_armed_ = true;
+    }
+
+    io_uring_sqe* next_sqe() {
+        const unsigned tail = *sq_tail_;
+        if (tail - load_acquire(sq_head_) >= sq_entries_) {
+            return nullptr;
+        }
+        io_uring_sqe* sqe = &sqes_[tail & sq_mask_];
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    void commit_sqe() {
+        const unsigned tail = *sq_tail_;
+        sq_array_[tail & sq_mask_] = tail & sq_mask_;
+        store_release(sq_tail_, tail + 1);
+        ++unflushed_;
+    }
+
+    // Hands the filled entries to the kernel. What it refuses for now
+    // (EAGAIN, EBUSY) stays queued, and ready() brings a worker back.
+    void flush() {
+        while (unflushed_ != 0) {
+            const int submitted =
+                io_uring_enter(ring_fd_, unflushed_, 0, 0, nullptr, 0);
+            if (submitted > 0) {
+                unflushed_ -= static_cast<unsigned>(submitted);
+            } else if (submitted == 0 || errno != EINTR) {
+                break;
+            }
+        }
+        update_unsent();
+    }
+
+    void update_unsent() {
+        unsent_.store(backlog_size_ + unflushed_, std::memory_order_seq_cst);
+    }
+
+    int ring_fd_ = -1;
+    int event_fd_ = -1;
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    size_t sqes_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    std::atomic<bool> reaping_{false};
+    std::atomic<bool> waiter_{false};
+    // Backlog entries plus filled entries the kernel has not taken.
+    std::atomic<size_t> unsent_{0};
+
+    // Submission side: every call fills an entry and enters the kernel
+    // anyway, so a mutex costs little next to the system call.
+    std::mutex mutex_;
+    IoOp* backlog_head_ = nullptr;
+    IoOp* backlog_tail_ = nullptr;
+    size_t backlog_size_ = 0;
+    unsigned unflushed_ = 0;
+    size_t in_kernel_ = 0;
+    size_t limit_ = 0;
+    bool wake_armed_ = false;
+    uint64_t wake_value_ = 0;
+};
+
+constexpr uint64_t UringDevice::kWakeTag;
+constexpr uint64_t UringDevice::kCancelTag;
+
+#endif // LOCKFREE_HAVE_IO_URING
+
+} // namespace
+
+AsyncIo::AsyncIo(ThreadPool& pool, const IoOptions& options)
+    : pool_(&pool), engine_(IoEngine::Threads) {
+    if (options.engine != IoEngine::Threads) {
+        int error = ENOSYS;
+#if LOCKFREE_HAVE_IO_URING
+        device_.reset(UringDevice::create(options.queue_depth, error));
+#endif
+        if (device_) {
+            engine_ = IoEngine::IoUring;
+        } else if (options.engine == IoEngine::IoUring) {
+            detail::raise(std::system_error(error, std::system_category(),
+                                            "io_uring unavailable"));
+        }
+    }
+    if (!device_) {
+        device_.reset(new ThreadDevice(options.threads, &AsyncIo::wake_pool,
+                                       pool_));
+    }
+    pool_->attach_io(device_.get());
+}
+
+AsyncIo::~AsyncIo() {
+    wait();
+    pool_->detach_io(device_.get());
+}
+
+std::future<int> AsyncIo::read(int fd, void* buf, size_t len, uint64_t offset) {
+    std::promise<int> promise;
+    std::future<int> future = promise.get_future();
+    read(fd, buf, len, offset, PromiseHandler(std::move(promise)));
+    return future;
+}
+
+std::future<int> AsyncIo::write(int fd, const void* buf, size_t len,
+                                uint64_t offset) {
+    std::promise<int> promise;
+    std::future<int> future = promise.get_future();
+    write(fd, buf, len, offset, PromiseHandler(std::move(promise)));
+    return future;
+}
+
+std::future<int> AsyncIo::fsync(int fd) {
+    std::promise<int> promise;
+    std::future<int> future = promise.get_future();
+    fsync(fd, PromiseHandler(std::move(promise)));
+    return future;
+}
+
+int AsyncIo::register_buffers(const struct iovec* buffers, unsigned count) {
+    return device_->register_buffers(buffers, count);
+}
+
+int AsyncIo::unregister_buffers() {
+    return device_->unregister_buffers();
+}
+
+size_t AsyncIo::in_flight() const {
+    return device_->in_flight();
+}
+
+void AsyncIo::wait() {
+    std::vector<Task> dropped;
+    dropped.reserve(kReapBatch);
+    bool cancelled = false;
+    while (device_->in_flight() != 0) {
+        if (pool_->stop_.load(std::memory_order_acquire)) {
+            // No worker reaps any more, and nothing would run what
+            // completes: cancel the rest, take the completions here and
+            // drop their handlers.
+            if (!cancelled) {
+                device_->cancel();
+                cancelled = true;
+            }
+            dropped.clear();
+            if (device_->reap(dropped, kReapBatch) != 0) {
+                continue;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+// Counted in like any task before the backend sees it, so the pool's
+// wait() and Drain cover it; the completion task counts it out.
+SubmitStatus AsyncIo::submit(detail::IoOp* op) noexcept {
+    if (!pool_->accepting()) {
+        op->finish(op, false);
+        return SubmitStatus::Shutdown;
+    }
+    const auto& context = ThreadPool::current_worker();
+    const bool from_worker = context.pool == pool_;
+    pool_->count_queued(from_worker, context.index, 1);
+    if (!device_->submit(op, from_worker)) {
+        pool_->count_queued(from_worker, context.index, -1);
+        op->finish(op, false);
+        return SubmitStatus::NoMemory;
+    }
+    if (device_->ready() || device_->needs_waiter()) {
+        pool_->wake_idle();
+    }
+    return SubmitStatus::Ok;
+}
+
+void AsyncIo::wake_pool(void* pool) {
+    static_cast<ThreadPool*>(pool)->wake_idle();
+}
+
+} // namespace lockfree
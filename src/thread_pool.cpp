@@ -0,0 +1,609 @@
+#include "lockfree/thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <iostream>
+#include <random>
+
+namespace lockfree {
+
+// The queue operations every translation unit using the pool would
+// otherwise instantiate; see the extern declarations in thread_pool.hpp.
+template Queue<Task>::Queue();
+template Queue<Task>::Queue(const BackoffPolicy&);
+template Queue<Task>::~Queue();
+template void Queue<Task>::push(Task&&);
+template bool Queue<Task>::pop(Task&);
+template size_t Queue<Task>::pop_bulk(std::vector<Task>&, size_t);
+template bool Queue<Task>::pop_wait(Task&);
+template void Queue<Task>::clear();
+template size_t Queue<Task>::get_active_nodes();
+template void Queue<Task>::force_release_nodes();
+template void Queue<Task>::link(Node*);
+template void Queue<Task>::link_chain(Node*, Node*, size_t);
+template bool Queue<Task>::claim_front(detail::HazardPointer&,
+                                       detail::HazardPointer&,
+                                       Node*&, Node*&);
+template bool Queue<Task>::spin_pop(Task&);
+template bool Queue<Task>::should_park() const;
+template void Queue<Task>::wake_waiters();
+
+constexpr std::chrono::milliseconds ThreadPool::kIdleParkInterval;
+
+ThreadPool::ThreadPool(size_t num_threads, SchedulingMode mode,
+                       const BackoffPolicy& backoff)
+    : mode_(mode), backoff_(backoff), global_queue_(backoff),
+      arena_budget_(num_threads) {
+    timers_.set_wake([](void* pool) {
+        static_cast<ThreadPool*>(pool)->wake_idle();
+    }, this);
+    // Initialize workers vector atomically
+    std::vector<std::shared_ptr<Worker>> temp_workers;
+    temp_workers.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        temp_workers.emplace_back(std::shared_ptr<Worker>(new Worker(backoff_)));
+    }
+    
+    // Atomically swap the initialized workers
+    workers_.swap(temp_workers);
+    
+    // Start worker threads
+    std::atomic<size_t> threads_started{0};
+    for (size_t i = 0; i < num_threads; ++i) {
+        LOCKFREE_TRY {
+            workers_[i]->thread = std::thread([this, i, &threads_started]() {
+                WorkerContext& context = current_worker();
+                context.pool = this;
+                context.index = i;
+                workers_[i]->idle.store(false, std::memory_order_relaxed);
+                threads_started.fetch_add(1, std::memory_order_release);
+                this->worker_loop(i);
+            });
+            
+            // Wait for thread to start
+            while (threads_started.load(std::memory_order_acquire) <= i) {
+                std::this_thread::yield();
+            }
+        } LOCKFREE_CATCH_ALL {
+            running_.store(false, std::memory_order_release);
+            stop_workers();
+            LOCKFREE_RETHROW;
+        }
+    }
+}
+
+void ThreadPool::worker_loop(size_t worker_id) {
+    // Safely get worker pointer
+    if (worker_id >= workers_.size() || !workers_[worker_id]) {
+        return;
+    }
+    Worker* self = workers_[worker_id].get();
+
+    std::vector<Task> injected;
+    injected.reserve(kInjectorBatch);
+
+    size_t poll_countdown = kPollInterval;
+    size_t lifo_runs = 0;
+    while (!stop_.load(std::memory_order_acquire)) {
+        // The idle path below polls timers and the injector every pass.
+        // A worker that always has local work, e.g. a strand that keeps
+        // rescheduling itself, still polls both now and then so timers
+        // stay timely and external submissions are not starved.
+        if (--poll_countdown == 0) {
+            poll_countdown = kPollInterval;
+            poll_timers(self);
+            poll_io(self, injected);
+            Task global_task;
+            if (!global_queue_.empty() && pop_injected(global_task, injected, self->local_queue)) {
+                set_idle(self, worker_id, false);
+                run_task(global_task, worker_id);
+                continue;
+            }
+        }
+
+        if (self->lifo_slot) {
+            if (lifo_runs < kMaxLifoRuns) {
+                ++lifo_runs;
+                Task lifo_task = std::move(self->lifo_slot);
+                set_idle(self, worker_id, false);
+                run_task(lifo_task, worker_id);
+                continue;
+            }
+            self->local_queue.push(std::move(self->lifo_slot));
+        }
+        lifo_runs = 0;
+
+        Task local_task;
+        if (self->local_queue.pop(local_task)) {
+            set_idle(self, worker_id, false);
+            run_task(local_task, worker_id);
+            continue;
+        }
+
+        // Refill from the injection queue before stealing. Its size counter
+        // is a plain load, so idle workers skip the probe while it is empty.
+        Task global_task;
+        if (!global_queue_.empty() && pop_injected(global_task, injected, self->local_queue)) {
+            set_idle(self, worker_id, false);
+            run_task(global_task, worker_id);
+            continue;
+        }
+
+        // Attempt to steal work from another worker
+        Task stolen_task;
+        if (steal_task(stolen_task, worker_id)) {
+            set_idle(self, worker_id, false);
+            run_task(stolen_task, worker_id);
+            continue;
+        }
+
+        // Then a fork-join child some other worker's TaskGroup spawned.
+        if (detail::Job* job = steal_job()) {
+            set_idle(self, worker_id, false);
+            job->run();
+            continue;
+        }
+
+        if (poll_timers(self)) {
+            continue;
+        }
+        if (poll_io(self, injected)) {
+            continue;
+        }
+
+        set_idle(self, worker_id, true);
+        if (!self->idle_wait.pause()) {
+            park_idle(self);
+        }
+    }
+    set_idle(self, worker_id, false);
+}
+
+// Moves due timers onto self's queue, where other workers can steal them.
+// A timer whose task cannot be queued for lack of memory is dropped as it
+// would be at shutdown, so its handle reads inactive.
+bool ThreadPool::poll_timers(Worker* self) {
+    if (timers_.pending() == 0) {
+        return false;
+    }
+    return timers_.poll(TimerWheel::Clock::now(),
+                        [this, self](detail::TimerRef timer) {
+        Worker::bump(self->spawned);
+        LOCKFREE_TRY {
+            self->local_queue.push(detail::TimerTask(timers_, std::move(timer)));
+        } LOCKFREE_CATCH_ALL {
+            Worker::bump(self->spawned, static_cast<size_t>(-1));
+        }
+    }) > 0;
+}
+
+// Moves finished I/O's completion tasks onto self's queue. They were
+// counted in when the operation was submitted, so no bump here.
+bool ThreadPool::poll_io(Worker* self, std::vector<Task>& batch) {
+    if (io_.load(std::memory_order_relaxed) == nullptr) {
+        return false;
+    }
+    detail::IoPoller* io = pin_io();
+    if (!io) {
+        return false;
+    }
+    batch.clear();
+    const size_t reaped = io->reap(batch, kInjectorBatch);
+    unpin_io();
+    if (reaped == 0) {
+        return false;
+    }
+    self->local_queue.push_bulk(std::make_move_iterator(batch.begin()),
+                                std::make_move_iterator(batch.end()));
+    batch.clear();
+    return true;
+}
+
+// A parking worker with I/O in flight and nobody waiting on it blocks in
+// the AsyncIo's wait instead of the parking lot, so completions wake it.
+// Same handshake as park_idle(): it claims the role, then checks for
+// work; wake_io() runs after work is published.
+bool ThreadPool::wait_io(std::chrono::steady_clock::time_point deadline) {
+    if (io_.load(std::memory_order_relaxed) == nullptr) {
+        return false;
+    }
+    detail::IoPoller* io = pin_io();
+    if (!io) {
+        return false;
+    }
+    const bool claimed = io->begin_wait();
+    if (claimed) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!stop_.load(std::memory_order_acquire) && !has_queued_work()) {
+            io->wait_until(deadline);
+        }
+        io->end_wait();
+    }
+    unpin_io();
+    return claimed;
+}
+
+void ThreadPool::wake_io() {
+    if (io_.load(std::memory_order_relaxed) == nullptr) {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (detail::IoPoller* io = pin_io()) {
+        io->wake();
+        unpin_io();
+    }
+}
+
+detail::IoPoller* ThreadPool::pin_io() const {
+    io_users_.fetch_add(1, std::memory_order_seq_cst);
+    detail::IoPoller* io = io_.load(std::memory_order_seq_cst);
+    if (!io) {
+        unpin_io();
+    }
+    return io;
+}
+
+void ThreadPool::attach_io(detail::IoPoller* io) {
+    detail::IoPoller* expected = nullptr;
+    if (!io_.compare_exchange_strong(expected, io, std::memory_order_seq_cst)) {
+        detail::raise(std::logic_error("ThreadPool already has an AsyncIo"));
+    }
+}
+
+// The worker waiting in io may be blocked until its deadline; wake it
+// until every user has left.
+void ThreadPool::detach_io(detail::IoPoller* io) {
+    io_.store(nullptr, std::memory_order_seq_cst);
+    while (io_users_.load(std::memory_order_seq_cst) != 0) {
+        io->wake();
+        std::this_thread::yield();
+    }
+}
+
+namespace {
+
+// Runs task, logging whatever escapes it. False if it threw.
+bool invoke(Task& task, size_t worker_id) noexcept {
+#if LOCKFREE_HAS_EXCEPTIONS
+    try {
+        task();
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Worker " << worker_id << " task exception: " << e.what() << "\n";
+    } catch (...) {
+        std::cerr << "Worker " << worker_id << " unknown task exception\n";
+    }
+    return false;
+#else
+    (void)worker_id;
+    task();
+    return true;
+#endif
+}
+
+} // namespace
+
+// The one place a task is counted out, whether it returned or threw.
+void ThreadPool::run_task(Task& task, size_t worker_id) {
+    trace(worker_id, TraceEventKind::TaskBegin);
+    if (invoke(task, worker_id)) {
+        Worker::bump(workers_[worker_id]->executed);
+    }
+    // Free the closure before the task counts as done, so wait() also
+    // means everything it captured has been released.
+    task = nullptr;
+    trace(worker_id, TraceEventKind::TaskEnd);
+    Worker::bump(workers_[worker_id]->completed);
+}
+
+// Records transitions only, so an idle worker spinning through its
+// backoff produces one idle slice rather than an event per pass.
+void ThreadPool::set_idle(Worker* self, size_t worker_id, bool idle) {
+    if (self->idle.load(std::memory_order_relaxed) == idle) {
+        return;
+    }
+    self->idle.store(idle, std::memory_order_relaxed);
+    trace(worker_id, idle ? TraceEventKind::ParkBegin : TraceEventKind::ParkEnd);
+    if (idle) {
+        searching_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    self->idle_wait.succeeded();
+    self->idle_wait.reset();
+    // The last searcher found work; if more is queued, nobody else is
+    // looking for it.
+    if (searching_.fetch_sub(1, std::memory_order_relaxed) == 1) {
+        LOCKFREE_SCHEDULE_POINT();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!global_queue_.empty() || !self->local_queue.empty() ||
+            io_needs_worker()) {
+            wake_idle();
+        }
+    }
+}
+
+// Called once the idle backoff is used up. The sleeper announces itself
+// and then checks for work; push_task() publishes work and then checks for
+// sleepers. The fences order both pairs, so either the sleeper sees the
+// work or the submitter sees the sleeper.
+void ThreadPool::park_idle(Worker* self) {
+    searching_.fetch_sub(1, std::memory_order_relaxed);
+    sleepers_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    LOCKFREE_SCHEDULE_POINT();
+    // Read after the fence: a timer scheduled earlier than this either
+    // shows up here or its wake_idle() sees us in sleepers_.
+    const auto deadline = std::min(
+        std::chrono::steady_clock::now() + kIdleParkInterval,
+        timers_.next_deadline());
+    if (!wait_io(deadline)) {
+        detail::ParkingLot::park_until(&sleepers_, [this] {
+            return !stop_.load(std::memory_order_acquire) && !has_queued_work();
+        }, deadline);
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    searching_.fetch_add(1, std::memory_order_relaxed);
+    self->idle_wait.reset();
+}
+
+// Work any idle worker could pick up; LIFO slots are private. I/O
+// counts when there is something to reap or submit, or in-flight
+// operations nobody waits on yet.
+bool ThreadPool::has_queued_work() const {
+    if (!global_queue_.empty()) {
+        return true;
+    }
+    for (const auto& worker : workers_) {
+        if (!worker->local_queue.empty() || !worker->jobs.empty()) {
+            return true;
+        }
+    }
+    return io_needs_worker();
+}
+
+// Completions to reap, submissions to hand in, or operations in flight
+// with no worker waiting on them.
+bool ThreadPool::io_needs_worker() const {
+    if (io_.load(std::memory_order_relaxed) == nullptr) {
+        return false;
+    }
+    detail::IoPoller* io = pin_io();
+    if (!io) {
+        return false;
+    }
+    const bool needed = io->ready() || io->needs_waiter();
+    unpin_io();
+    return needed;
+}
+
+void ThreadPool::wake_idle() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) != 0 &&
+        searching_.load(std::memory_order_relaxed) == 0) {
+        detail::ParkingLot::unpark_all(&sleepers_);
+        wake_io();
+    }
+}
+
+bool ThreadPool::pop_injected(Task& task, std::vector<Task>& batch,
+                              Queue<Task>& local) {
+    // Take a fair share so one worker does not hoard a burst.
+    size_t share = global_queue_.size() / workers_.size() + 1;
+    if (share > kInjectorBatch) share = kInjectorBatch;
+    batch.clear();
+    if (global_queue_.pop_bulk(batch, share) == 0) {
+        return false;
+    }
+
+    local.push_bulk(std::make_move_iterator(batch.begin() + 1),
+                    std::make_move_iterator(batch.end()));
+    task = std::move(batch.front());
+    batch.clear();
+    return true;
+}
+
+bool ThreadPool::steal_task(Task& task, size_t thief_id) {
+    const size_t n = workers_.size();
+    if (n < 2) {
+        return false;
+    }
+    Worker* thief = workers_[thief_id].get();
+    std::vector<Task>& batch = thief->steal_buffer;
+    const size_t attempts = n - 1 < kMaxStealAttempts ? n - 1 : kMaxStealAttempts;
+
+    // Go back to the last victim that had work first, then random ones.
+    size_t victim = thief->last_victim;
+    for (size_t attempt = 0; attempt < attempts; ++attempt) {
+        if (attempt > 0 || victim == thief_id || victim >= n) {
+            victim = select_victim(thief_id);
+        }
+        Worker::bump(thief->steal_attempts);
+
+        // Take half of the victim's backlog in one pop_bulk so a skewed
+        // load spreads over the pool in O(log n) rounds of stealing.
+        Queue<Task>& victim_queue = workers_[victim]->local_queue;
+        size_t available = victim_queue.size();
+        if (available == 0) {
+            continue;
+        }
+        LOCKFREE_SCHEDULE_POINT();
+        batch.clear();
+        if (victim_queue.pop_bulk(batch, (available + 1) / 2) == 0) {
+            continue;
+        }
+
+        thief->last_victim = victim;
+        Worker::bump(thief->stolen, batch.size());
+        trace(thief_id, TraceEventKind::Steal,
+              static_cast<uint64_t>(victim) << 32 | batch.size());
+        thief->local_queue.push_bulk(std::make_move_iterator(batch.begin() + 1),
+                                     std::make_move_iterator(batch.end()));
+        task = std::move(batch.front());
+        batch.clear();
+        return true;
+    }
+
+    thief->last_victim = thief_id;
+    return false;
+}
+
+detail::JobDeque* ThreadPool::local_jobs() const {
+    const WorkerContext& context = current_worker();
+    return context.pool == this ? &workers_[context.index]->jobs : nullptr;
+}
+
+// Probes every other worker once, starting at a random one. Jobs are
+// taken one at a time: the oldest job of a recursive spawn tree is the
+// biggest, so one is usually enough.
+detail::Job* ThreadPool::steal_job() {
+    const size_t n = workers_.size();
+    if (n == 0) {
+        return nullptr;
+    }
+    const WorkerContext& context = current_worker();
+    const bool in_pool = context.pool == this;
+    static thread_local std::minstd_rand gen(std::random_device{}());
+    const size_t start = gen() % n;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t victim = (start + i) % n;
+        if (in_pool && victim == context.index) {
+            continue;
+        }
+        detail::JobDeque& deque = workers_[victim]->jobs;
+        if (deque.empty()) {
+            continue;
+        }
+        LOCKFREE_SCHEDULE_POINT();
+        if (detail::Job* job = deque.steal()) {
+            if (in_pool) {
+                Worker::bump(workers_[context.index]->stolen);
+            }
+            trace(in_pool ? context.index : n, TraceEventKind::Steal,
+                  static_cast<uint64_t>(victim) << 32 | 1);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+size_t ThreadPool::select_victim(size_t thief_id) {
+    // Draw from the other n - 1 workers so the thief never picks itself.
+    static thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_int_distribution<size_t> dist(0, workers_.size() - 2);
+    size_t victim = dist(gen);
+    return victim >= thief_id ? victim + 1 : victim;
+}
+
+// Completions are read before submissions. A task is counted in before
+// it is queued and counted out after it ran, so every completion seen
+// here has its submission seen below, and the difference cannot drop
+// below the number of tasks really outstanding.
+size_t ThreadPool::active_tasks() const {
+    size_t completed = 0;
+    for (const auto& worker : workers_) {
+        completed += worker->completed.load(std::memory_order_acquire);
+    }
+    size_t queued = injected_.load(std::memory_order_acquire);
+    for (const auto& worker : workers_) {
+        queued += worker->spawned.load(std::memory_order_acquire);
+    }
+    return queued - completed;
+}
+
+void ThreadPool::wait() {
+    const auto start = std::chrono::steady_clock::now();
+    while (active_tasks() > 0) {
+        if (std::chrono::steady_clock::now() - start > std::chrono::seconds(10)) {
+            std::cerr << "Warning: wait() timeout after 10 seconds\n";
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void ThreadPool::enable_tracing(size_t events_per_thread) {
+    if (!trace_storage_) {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            names.push_back("worker " + std::to_string(i));
+        }
+        names.push_back("external");
+        trace_storage_.reset(new Tracer(names, events_per_thread));
+    }
+    tracer_.store(trace_storage_.get(), std::memory_order_release);
+}
+
+void ThreadPool::disable_tracing() {
+    tracer_.store(nullptr, std::memory_order_release);
+}
+
+bool ThreadPool::write_trace(std::ostream& out) const {
+    if (!trace_storage_) {
+        return false;
+    }
+    trace_storage_->write_chrome_trace(out);
+    return true;
+}
+
+bool ThreadPool::shutdown(ShutdownMode mode,
+                          std::chrono::steady_clock::duration timeout) {
+    if (current_worker().pool == this) {
+        detail::raise(
+            std::logic_error("ThreadPool::shutdown called from a pool task"));
+    }
+    std::lock_guard<std::mutex> lock(shutdown_mutex_);
+    if (stop_.load(std::memory_order_acquire)) {
+        return true;
+    }
+
+    bool drained = true;
+    if (mode == ShutdownMode::Drain) {
+        draining_.store(true, std::memory_order_release);
+        running_.store(false, std::memory_order_release);
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (active_tasks() > 0) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                drained = false;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        draining_.store(false, std::memory_order_release);
+    } else {
+        running_.store(false, std::memory_order_release);
+    }
+
+    stop_workers();
+    drop_queued_tasks();
+    return drained;
+}
+
+void ThreadPool::stop_workers() {
+    stop_.store(true, std::memory_order_release);
+    detail::ParkingLot::unpark_all(&sleepers_);
+    wake_io();
+    for (auto& worker : workers_) {
+        if (worker && worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+// Runs after the workers are joined. Destroying a queued Task releases
+// its TaskPromise, which fails the matching future; pending timers are
+// cancelled.
+void ThreadPool::drop_queued_tasks() {
+    timers_.clear();
+    global_queue_.clear();
+    for (auto& worker : workers_) {
+        if (worker) {
+            worker->lifo_slot = nullptr;
+            worker->local_queue.clear();
+            worker->spawned.store(0, std::memory_order_relaxed);
+            worker->completed.store(0, std::memory_order_relaxed);
+        }
+    }
+    injected_.store(0, std::memory_order_release);
+}
+
+} // namespace lockfree
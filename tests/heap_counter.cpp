@@ -0,0 +1,33 @@
+// Replaces the global operator new and delete to count heap allocations.
+// Kept out of the tests that read the count, so the compiler never sees
+// these malloc/free bodies next to the new-expressions they serve.
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> g_heap_allocs(0);
+
+} // namespace
+
+uint64_t heap_allocations() {
+    return g_heap_allocs.load();
+}
+
+void* operator new(size_t size) {
+    g_heap_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,214 @@
+#ifndef LOCKFREE_TESTS_STRESS_HISTORY_HPP
+#define LOCKFREE_TESTS_STRESS_HISTORY_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Operation histories of a FIFO queue and a linearizability check over
+// them. Each thread appends to its own log, so recording adds a clock
+// read per call and no shared writes; the logs are merged once the
+// threads are joined.
+//
+// The check assumes every pushed value is unique, which reduces
+// linearizability of a queue history to the absence of a handful of bad
+// patterns instead of a search over interleavings. These are found in
+// O(n log n):
+//
+//   - a pop returns a value nobody pushed, or returns it twice, or
+//     returns before the push that produced it started;
+//   - push(a) returns before push(b) starts, yet pop(b) returns before
+//     pop(a) starts, or b is popped and a never is;
+//   - a pop reports empty while some value was certainly inside for the
+//     whole call: pushed before it started, popped after it returned.
+//
+// Every reported violation is a real one. The empty-pop rule looks at
+// one value at a time, so an empty pop that is only illegal because of
+// several values together goes unreported.
+namespace stress {
+
+inline uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Operation {
+    enum Kind { Push, Pop, PopEmpty };
+
+    Kind kind;
+    uint64_t value;
+    uint64_t invoked;
+    uint64_t returned;
+};
+
+class QueueHistory {
+public:
+    explicit QueueHistory(size_t threads, size_t ops_per_thread = 0)
+        : logs_(threads) {
+        for (auto& log : logs_) {
+            log.reserve(ops_per_thread);
+        }
+    }
+
+    // invoked is now_ns() taken just before the call.
+    void push(size_t thread, uint64_t value, uint64_t invoked) {
+        logs_[thread].push_back({Operation::Push, value, invoked, now_ns()});
+    }
+
+    void pop(size_t thread, bool popped, uint64_t value, uint64_t invoked) {
+        logs_[thread].push_back({popped ? Operation::Pop : Operation::PopEmpty,
+                                 popped ? value : 0, invoked, now_ns()});
+    }
+
+    // For histories built by hand.
+    void record(size_t thread, const Operation& op) {
+        logs_[thread].push_back(op);
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const auto& log : logs_) {
+            n += log.size();
+        }
+        return n;
+    }
+
+    // Empty if the history is linearizable, otherwise the first
+    // violation found.
+    std::string check() const;
+
+private:
+    std::vector<std::vector<Operation>> logs_;
+};
+
+namespace detail {
+
+const uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+struct ValueLife {
+    uint64_t value;
+    uint64_t push_invoked, push_returned;
+    uint64_t pop_invoked, pop_returned;  // kNever if never popped
+};
+
+inline std::string describe(const ValueLife& v) {
+    std::ostringstream out;
+    out << "value " << v.value << " (push [" << v.push_invoked << ", "
+        << v.push_returned << "]";
+    if (v.pop_invoked == kNever) {
+        out << ", never popped)";
+    } else {
+        out << ", pop [" << v.pop_invoked << ", " << v.pop_returned << "])";
+    }
+    return out.str();
+}
+
+} // namespace detail
+
+inline std::string QueueHistory::check() const {
+    using detail::ValueLife;
+    using detail::kNever;
+
+    std::unordered_map<uint64_t, ValueLife> lives;
+    std::vector<const Operation*> pops, empties;
+    for (const auto& log : logs_) {
+        for (const Operation& op : log) {
+            if (op.kind == Operation::Push) {
+                ValueLife life = {op.value, op.invoked, op.returned,
+                                  kNever, kNever};
+                if (!lives.insert(std::make_pair(op.value, life)).second) {
+                    std::ostringstream out;
+                    out << "value " << op.value << " pushed twice";
+                    return out.str();
+                }
+            } else if (op.kind == Operation::Pop) {
+                pops.push_back(&op);
+            } else {
+                empties.push_back(&op);
+            }
+        }
+    }
+
+    for (const Operation* op : pops) {
+        auto it = lives.find(op->value);
+        if (it == lives.end()) {
+            std::ostringstream out;
+            out << "popped value " << op->value << " that was never pushed";
+            return out.str();
+        }
+        ValueLife& life = it->second;
+        if (life.pop_invoked != kNever) {
+            return detail::describe(life) + " popped a second time";
+        }
+        life.pop_invoked = op->invoked;
+        life.pop_returned = op->returned;
+        if (life.pop_returned < life.push_invoked) {
+            return detail::describe(life) + " popped before it was pushed";
+        }
+    }
+
+    // by_push[i] in order of push completion; latest[i] is the one among
+    // by_push[0..i] popped last (or never), so "some value pushed before
+    // t is still inside after u" is one binary search and one compare.
+    std::vector<const ValueLife*> by_push;
+    by_push.reserve(lives.size());
+    for (const auto& entry : lives) {
+        by_push.push_back(&entry.second);
+    }
+    std::sort(by_push.begin(), by_push.end(),
+              [](const ValueLife* a, const ValueLife* b) {
+                  return a->push_returned < b->push_returned;
+              });
+    std::vector<const ValueLife*> latest(by_push.size());
+    for (size_t i = 0; i < by_push.size(); ++i) {
+        latest[i] = by_push[i];
+        if (i > 0 && latest[i - 1]->pop_invoked > latest[i]->pop_invoked) {
+            latest[i] = latest[i - 1];
+        }
+    }
+    // The value pushed completely before t that leaves the queue last.
+    auto outlasting = [&](uint64_t t) -> const ValueLife* {
+        auto end = std::lower_bound(
+            by_push.begin(), by_push.end(), t,
+            [](const ValueLife* v, uint64_t time) {
+                return v->push_returned < time;
+            });
+        if (end == by_push.begin()) {
+            return nullptr;
+        }
+        return latest[end - by_push.begin() - 1];
+    };
+
+    for (const ValueLife* b : by_push) {
+        if (b->pop_returned == kNever) {
+            continue;
+        }
+        const ValueLife* a = outlasting(b->push_invoked);
+        if (a && a->pop_invoked > b->pop_returned) {
+            return "FIFO order broken: " + detail::describe(*a) +
+                   " was pushed first but " + detail::describe(*b) +
+                   " left the queue first";
+        }
+    }
+
+    for (const Operation* op : empties) {
+        const ValueLife* v = outlasting(op->invoked);
+        if (v && v->pop_invoked > op->returned) {
+            std::ostringstream out;
+            out << "pop [" << op->invoked << ", " << op->returned
+                << "] reported empty while " << detail::describe(*v)
+                << " was inside";
+            return out.str();
+        }
+    }
+    return std::string();
+}
+
+} // namespace stress
+
+#endif // LOCKFREE_TESTS_STRESS_HISTORY_HPP
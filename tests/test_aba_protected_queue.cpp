@@ -28,6 +28,7 @@ TEST_F(ABAProtectedQueueTest, ConcurrentOperations) {
     constexpr int kThreads = 4;
     constexpr int kItems = 1000;
     std::atomic<int> count{0};
+    std::atomic<int> consumed{0};
     
     auto producer = [this, &count] {
         for (int i = 0; i < kItems; ++i) {
@@ -36,11 +37,14 @@ TEST_F(ABAProtectedQueueTest, ConcurrentOperations) {
         }
     };
     
-    auto consumer = [this, &count] {
+    // Run until every item is consumed; count can touch zero while
+    // producers are still running.
+    auto consumer = [this, &count, &consumed] {
         int val;
-        while (count.load(std::memory_order_relaxed) > 0 || !q.empty()) {
+        while (consumed.load(std::memory_order_relaxed) < kThreads * kItems) {
             if (q.pop(val)) {
                 count.fetch_sub(1, std::memory_order_relaxed);
+                consumed.fetch_add(1, std::memory_order_relaxed);
             }
         }
     };
@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/arena.hpp"
+#include "../include/lockfree/task.hpp"
+#include "../include/lockfree/thread_pool.hpp"
+#include <array>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Counts allocations routed through it; copies share the counter.
+template <typename T>
+struct CountingAllocator {
+    typedef T value_type;
+
+    explicit CountingAllocator(std::atomic<int>* c) : count(c) {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) : count(other.count) {}
+
+    T* allocate(size_t n) {
+        count->fetch_add(1);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        count->fetch_sub(1);
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    std::atomic<int>* count;
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& a, const CountingAllocator<U>& b) {
+    return a.count == b.count;
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& a, const CountingAllocator<U>& b) {
+    return a.count != b.count;
+}
+
+} // namespace
+
+TEST(TaskTest, SmallCallablesAreStoredInline) {
+    int hits = 0;
+    auto small = [&hits]() { ++hits; };
+    EXPECT_TRUE(lockfree::Task::stored_inline<decltype(small)>());
+
+    std::array<char, 128> big = {};
+    auto large = [big, &hits]() { hits += big[0] + 1; };
+    EXPECT_FALSE(lockfree::Task::stored_inline<decltype(large)>());
+
+    std::atomic<int> live(0);
+    CountingAllocator<char> alloc(&live);
+    {
+        lockfree::Task inline_task(std::allocator_arg, alloc, small);
+        EXPECT_EQ(0, live.load());
+        lockfree::Task boxed_task(std::allocator_arg, alloc, large);
+        EXPECT_EQ(1, live.load());
+
+        lockfree::Task moved(std::move(boxed_task));
+        EXPECT_FALSE(static_cast<bool>(boxed_task));
+        inline_task();
+        moved();
+        EXPECT_EQ(1, live.load());
+    }
+    EXPECT_EQ(2, hits);
+    EXPECT_EQ(0, live.load());
+}
+
+TEST(TaskTest, HoldsMoveOnlyCallables) {
+    // C++11 has no init-capture; a hand-written functor owns the pointer.
+    struct Reader {
+        int* seen;
+        std::unique_ptr<int> value;
+        void operator()() { *seen = *value; }
+    };
+    int seen = 0;
+    lockfree::Task task(Reader{&seen, std::unique_ptr<int>(new int(7))});
+    lockfree::Task other;
+    EXPECT_FALSE(static_cast<bool>(other));
+    other = std::move(task);
+    other();
+    EXPECT_EQ(7, seen);
+    other = nullptr;
+    EXPECT_FALSE(static_cast<bool>(other));
+    EXPECT_THROW(other(), std::bad_function_call);
+}
+
+TEST(ArenaTest, ReusesFreedBlocks) {
+    lockfree::ArenaAllocator<std::array<char, 100>> alloc;
+    auto* first = alloc.allocate(1);
+    alloc.deallocate(first, 1);
+    auto* second = alloc.allocate(1);
+    EXPECT_EQ(first, second);
+    alloc.deallocate(second, 1);
+
+    // Past the largest size class the arena defers to operator new.
+    lockfree::ArenaAllocator<char> bytes;
+    char* large = bytes.allocate(1 << 20);
+    large[0] = 1;
+    large[(1 << 20) - 1] = 1;
+    bytes.deallocate(large, 1 << 20);
+}
+
+TEST(ArenaTest, WorksWithStandardContainers) {
+    std::vector<int, lockfree::ArenaAllocator<int>> values;
+    for (int i = 0; i < 1000; ++i) {
+        values.push_back(i);
+    }
+    EXPECT_EQ(499500, std::accumulate(values.begin(), values.end(), 0));
+
+    auto shared = std::allocate_shared<std::string>(
+        lockfree::ArenaAllocator<std::string>(), "arena");
+    EXPECT_EQ("arena", *shared);
+}
+
+TEST(ArenaTest, CrossThreadFreeReturnsToOwner) {
+    lockfree::ArenaAllocator<std::array<char, 200>> alloc;
+    const int kBlocks = 1000;
+    std::vector<std::array<char, 200>*> blocks;
+    for (int i = 0; i < kBlocks; ++i) {
+        blocks.push_back(alloc.allocate(1));
+    }
+
+    std::thread other([&]() {
+        for (auto* p : blocks) {
+            alloc.deallocate(p, 1);
+        }
+    });
+    other.join();
+
+    // Once its local list runs dry the owner picks the blocks back up
+    // from the remote list instead of carving a new slab.
+    std::set<void*> freed(blocks.begin(), blocks.end());
+    size_t recycled = 0;
+    blocks.clear();
+    for (int i = 0; i < 4 * kBlocks && recycled < freed.size(); ++i) {
+        auto* p = alloc.allocate(1);
+        recycled += freed.count(p);
+        blocks.push_back(p);
+    }
+    EXPECT_EQ(freed.size(), recycled);
+    for (auto* p : blocks) {
+        alloc.deallocate(p, 1);
+    }
+}
+
+TEST(ArenaTest, ConcurrentProducersAndConsumers) {
+    typedef std::array<uint64_t, 8> Block;
+    lockfree::Queue<Block*> handoff;
+    lockfree::ArenaAllocator<Block> alloc;
+    const int kProducers = 4;
+    const int kPerProducer = 20000;
+    std::atomic<int> consumed(0);
+    std::atomic<bool> corrupt(false);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kProducers; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < kPerProducer; ++i) {
+                Block* b = alloc.allocate(1);
+                b->fill(static_cast<uint64_t>(t) << 32 | i);
+                handoff.push(b);
+            }
+        });
+        threads.emplace_back([&]() {
+            Block* b = nullptr;
+            while (consumed.load() < kProducers * kPerProducer) {
+                if (!handoff.pop(b)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (uint64_t word : *b) {
+                    if (word != (*b)[0]) {
+                        corrupt.store(true);
+                    }
+                }
+                alloc.deallocate(b, 1);
+                consumed.fetch_add(1);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_FALSE(corrupt.load());
+    EXPECT_EQ(kProducers * kPerProducer, consumed.load());
+}
+
+TEST(ArenaTest, PoolSubmitWithAllocator) {
+    lockfree::ThreadPool pool(4);
+    std::atomic<int> live(0);
+    CountingAllocator<char> counting(&live);
+    std::array<int, 64> payload;
+    payload.fill(3);
+
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 200; ++i) {
+        if (i % 2 == 0) {
+            futures.push_back(pool.submit(
+                std::allocator_arg, lockfree::ArenaAllocator<char>(),
+                [payload, i]() { return payload[i % 64] + i; }));
+        } else {
+            futures.push_back(pool.submit(
+                std::allocator_arg, counting,
+                [payload, i]() { return payload[i % 64] + i; }));
+        }
+    }
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_EQ(3 + i, futures[i].get());
+    }
+    futures.clear();
+    pool.wait();
+    // Both the shared state and the boxed closure went through the
+    // allocator, and both have been released.
+    EXPECT_EQ(0, live.load());
+
+    auto failing = pool.submit(std::allocator_arg,
+                               lockfree::ArenaAllocator<char>(),
+                               []() -> int { throw std::runtime_error("x"); });
+    EXPECT_THROW(failing.get(), std::runtime_error);
+}
@@ -0,0 +1,250 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/async_io.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// A scratch file, removed again at scope exit.
+class TempFile {
+public:
+    TempFile() {
+        char path[] = "/tmp/lockfree_async_io_XXXXXX";
+        fd_ = mkstemp(path);
+        path_ = path;
+    }
+    ~TempFile() {
+        if (fd_ >= 0) {
+            close(fd_);
+            unlink(path_.c_str());
+        }
+    }
+    int fd() const { return fd_; }
+
+private:
+    int fd_;
+    std::string path_;
+};
+
+std::vector<char> pattern(size_t size, char seed) {
+    std::vector<char> data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<char>(seed + i % 31);
+    }
+    return data;
+}
+
+void wait_for(const std::atomic<int>& counter, int expected) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (counter.load() < expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+} // namespace
+
+class AsyncIoTest : public ::testing::TestWithParam<lockfree::IoEngine> {
+protected:
+    lockfree::IoOptions options(unsigned depth = 256) const {
+        return lockfree::IoOptions(GetParam(), depth, 2);
+    }
+};
+
+TEST_P(AsyncIoTest, WriteFsyncReadRoundTrip) {
+    lockfree::ThreadPool pool(2);
+    lockfree::AsyncIo io(pool, options());
+    TempFile file;
+    ASSERT_GE(file.fd(), 0);
+    const std::vector<char> data = pattern(8192, 'a');
+    std::vector<char> back(data.size());
+
+    EXPECT_EQ(8192, io.write(file.fd(), data.data(), data.size(), 0).get());
+    EXPECT_EQ(0, io.fsync(file.fd()).get());
+    EXPECT_EQ(8192, io.read(file.fd(), back.data(), back.size(), 0).get());
+    EXPECT_EQ(data, back);
+    // Reads past the end are short, and errors come back as -errno.
+    EXPECT_EQ(0, io.read(file.fd(), back.data(), back.size(), 8192).get());
+    EXPECT_EQ(-EBADF, io.read(-1, back.data(), back.size(), 0).get());
+    EXPECT_EQ(0u, io.in_flight());
+}
+
+// A handler is a pool task, so it can issue the next operation itself;
+// the pool's wait() covers operations still in flight.
+TEST_P(AsyncIoTest, HandlersChainOnThePool) {
+    lockfree::ThreadPool pool(2);
+    lockfree::AsyncIo io(pool, options());
+    TempFile file;
+    const std::vector<char> data = pattern(4096, 'k');
+    std::vector<char> back(data.size());
+    std::atomic<int> written(-1), read(-1);
+
+    pool.post([&] {
+        io.write(file.fd(), data.data(), data.size(), 0, [&](int n) {
+            written = n;
+            io.read(file.fd(), back.data(), back.size(), 0, [&](int m) {
+                read = m;
+            });
+        });
+    });
+    pool.wait();
+    EXPECT_EQ(4096, written.load());
+    EXPECT_EQ(4096, read.load());
+    EXPECT_EQ(data, back);
+    EXPECT_EQ(0u, io.in_flight());
+}
+
+TEST_P(AsyncIoTest, RegisteredBuffers) {
+    lockfree::ThreadPool pool(2);
+    lockfree::AsyncIo io(pool, options());
+    TempFile file;
+    std::vector<char> out = pattern(4096, 'r');
+    std::vector<char> in(4096);
+    struct iovec buffers[2] = {{out.data(), out.size()}, {in.data(), in.size()}};
+    ASSERT_EQ(0, io.register_buffers(buffers, 2));
+    EXPECT_EQ(-EBUSY, io.register_buffers(buffers, 2));
+
+    std::atomic<int> done(0);
+    std::atomic<int> written(-1), read(-1), outside(0);
+    io.write_fixed(file.fd(), 0, out.data(), out.size(), 0, [&](int n) {
+        written = n;
+        ++done;
+    });
+    wait_for(done, 1);
+    io.read_fixed(file.fd(), 1, in.data() + 1024, 2048, 1024, [&](int n) {
+        read = n;
+        ++done;
+    });
+    // Not inside the buffer named by the index.
+    io.read_fixed(file.fd(), 0, in.data(), 16, 0, [&](int n) {
+        outside = n;
+        ++done;
+    });
+    wait_for(done, 3);
+    EXPECT_EQ(4096, written.load());
+    EXPECT_EQ(2048, read.load());
+    EXPECT_EQ(-EFAULT, outside.load());
+    EXPECT_TRUE(std::equal(out.begin() + 1024, out.begin() + 3072,
+                           in.begin() + 1024));
+    EXPECT_EQ(0, io.unregister_buffers());
+}
+
+// Far more reads than I/O threads or ring entries, on two workers.
+TEST_P(AsyncIoTest, ManyOutstandingReads) {
+    lockfree::ThreadPool pool(2);
+    lockfree::AsyncIo io(pool, options(8));
+    TempFile file;
+    constexpr int kBlocks = 500;
+    constexpr size_t kBlock = 512;
+    const std::vector<char> data = pattern(kBlocks * kBlock, '0');
+    ASSERT_EQ(static_cast<ssize_t>(data.size()),
+              pwrite(file.fd(), data.data(), data.size(), 0));
+
+    std::vector<char> back(data.size());
+    std::atomic<int> done(0), bytes(0);
+    for (int i = 0; i < kBlocks; ++i) {
+        ASSERT_EQ(lockfree::SubmitStatus::Ok,
+                  io.read(file.fd(), back.data() + i * kBlock, kBlock,
+                          i * kBlock, [&](int n) {
+                              bytes += n;
+                              ++done;
+                          }));
+    }
+    pool.wait();
+    EXPECT_EQ(kBlocks, done.load());
+    EXPECT_EQ(static_cast<int>(data.size()), bytes.load());
+    EXPECT_EQ(data, back);
+}
+
+TEST_P(AsyncIoTest, ShutdownRefusesAndCancels) {
+    lockfree::ThreadPool pool(2);
+    lockfree::AsyncIo io(pool, options());
+    TempFile file;
+    char byte = 0;
+    pool.shutdown(lockfree::ShutdownMode::Drain);
+    bool ran = false;
+    EXPECT_EQ(lockfree::SubmitStatus::Shutdown,
+              io.read(file.fd(), &byte, 1, 0, [&ran](int) { ran = true; }));
+    EXPECT_EQ(-ECANCELED, io.read(file.fd(), &byte, 1, 0).get());
+    EXPECT_FALSE(ran);
+}
+
+// Reads from a pipe nobody writes to never complete on their own. Once
+// the pool has stopped, tearing the AsyncIo down cancels them instead of
+// waiting forever.
+TEST_P(AsyncIoTest, StoppedPoolCancelsBlockedReads) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    char bytes[3];
+    lockfree::ThreadPool pool(2);
+    std::vector<std::future<int>> pending;
+    auto torn_down = std::chrono::steady_clock::now();
+    {
+        lockfree::AsyncIo io(pool, options());
+        // One more than the Threads backend has threads, so one queues.
+        for (int i = 0; i < 3; ++i) {
+            pending.push_back(io.read(fds[0], &bytes[i], 1,
+                                      static_cast<uint64_t>(-1)));
+        }
+        EXPECT_FALSE(pool.shutdown(lockfree::ShutdownMode::Drain,
+                                   std::chrono::milliseconds(50)));
+        torn_down = std::chrono::steady_clock::now();
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - torn_down,
+              std::chrono::seconds(5));
+    // An abandoned read lets go of its handler once the call returns.
+    close(fds[1]);
+    for (auto& result : pending) {
+        EXPECT_EQ(-ECANCELED, result.get());
+    }
+    close(fds[0]);
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, AsyncIoTest,
+                         ::testing::Values(lockfree::IoEngine::Threads,
+                                           lockfree::IoEngine::Auto));
+
+TEST(AsyncIoPoolTest, OnePerPool) {
+    lockfree::ThreadPool pool(1);
+    lockfree::AsyncIo io(pool, lockfree::IoOptions(lockfree::IoEngine::Threads));
+    EXPECT_THROW(lockfree::AsyncIo second(pool), std::logic_error);
+    EXPECT_EQ(lockfree::IoEngine::Threads, io.engine());
+}
+
+// Idle workers block on the ring rather than park, so a completion is
+// picked up without waiting for a park interval to run out.
+TEST(AsyncIoPoolTest, IdleWorkersWakeForCompletions) {
+    lockfree::ThreadPool pool(2);
+    lockfree::AsyncIo io(pool);
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    char byte = 0;
+    std::atomic<int> done(0);
+    std::chrono::steady_clock::time_point finished;
+    io.read(fds[0], &byte, 1, static_cast<uint64_t>(-1), [&](int n) {
+        EXPECT_EQ(1, n);
+        finished = std::chrono::steady_clock::now();
+        ++done;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto written = std::chrono::steady_clock::now();
+    ASSERT_EQ(1, ::write(fds[1], "x", 1));
+    wait_for(done, 1);
+    ASSERT_EQ(1, done.load());
+    EXPECT_EQ('x', byte);
+    EXPECT_LT(finished - written, std::chrono::milliseconds(25));
+    close(fds[0]);
+    close(fds[1]);
+}
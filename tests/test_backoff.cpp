@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/backoff.hpp"
+#include "../include/lockfree/queue.hpp"
+#include "../include/lockfree/thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(BackoffTest, SpinsThenYieldsThenAsksToPark) {
+    lockfree::BackoffPolicy policy(4, 32, 3, false);
+    lockfree::Backoff backoff(policy);
+    // 4, 8, 16, 32 pauses, then three yields.
+    int steps = 0;
+    while (backoff.pause()) {
+        ++steps;
+    }
+    EXPECT_EQ(7, steps);
+    EXPECT_FALSE(backoff.pause());
+
+    backoff.reset();
+    EXPECT_TRUE(backoff.spinning());
+    EXPECT_TRUE(backoff.pause());
+}
+
+TEST(BackoffTest, YieldOnlySkipsSpinning) {
+    lockfree::Backoff backoff(lockfree::BackoffPolicy::yield_only(2));
+    EXPECT_FALSE(backoff.spinning());
+    EXPECT_TRUE(backoff.pause());
+    EXPECT_TRUE(backoff.pause());
+    EXPECT_FALSE(backoff.pause());
+}
+
+TEST(BackoffTest, BudgetFollowsOutcomes) {
+    lockfree::BackoffState state(lockfree::BackoffPolicy(4, 64, 1));
+    EXPECT_EQ(64u, state.spin_budget());
+
+    // Waits that run out halve the budget, down to min_spins.
+    for (int i = 0; i < 10; ++i) {
+        lockfree::Backoff backoff(state);
+        while (backoff.pause()) {
+        }
+    }
+    EXPECT_EQ(4u, state.spin_budget());
+
+    // Waits that succeed while spinning double it back up.
+    for (int i = 0; i < 10; ++i) {
+        lockfree::Backoff backoff(state);
+        backoff.pause();
+        backoff.succeeded();
+    }
+    EXPECT_EQ(64u, state.spin_budget());
+}
+
+TEST(BackoffTest, FixedPolicyDoesNotAdapt) {
+    lockfree::BackoffState state(lockfree::BackoffPolicy(4, 64, 1, false));
+    lockfree::Backoff backoff(state);
+    while (backoff.pause()) {
+    }
+    EXPECT_EQ(64u, state.spin_budget());
+}
+
+TEST(BackoffTest, QueuePopWaitUsesPolicy) {
+    lockfree::Queue<int> queue(lockfree::BackoffPolicy::yield_only(1));
+    std::thread producer([&queue] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.push(42);
+    });
+    int value = 0;
+    EXPECT_TRUE(queue.pop_wait(value));
+    EXPECT_EQ(42, value);
+    producer.join();
+}
+
+TEST(BackoffTest, ContendedQueueLosesNothing) {
+    lockfree::Queue<int> queue(lockfree::BackoffPolicy(1, 64, 2));
+    const int kPerProducer = 20000;
+    std::atomic<long long> sum{0};
+    std::atomic<int> popped{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < 2; ++p) {
+        threads.emplace_back([&queue] {
+            for (int i = 1; i <= kPerProducer; ++i) {
+                queue.push(i);
+            }
+        });
+    }
+    for (int c = 0; c < 4; ++c) {
+        threads.emplace_back([&] {
+            int value;
+            while (popped.load() < 2 * kPerProducer) {
+                if (queue.pop(value)) {
+                    sum += value;
+                    ++popped;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(2LL * kPerProducer * (kPerProducer + 1) / 2, sum.load());
+}
+
+// Workers park once their backoff runs out; a submission must still
+// reach them promptly, well inside the park safety-net interval.
+TEST(BackoffTest, ParkedWorkersWakeOnSubmit) {
+    lockfree::ThreadPool pool(4, lockfree::SchedulingMode::Fifo,
+                              lockfree::BackoffPolicy(4, 64, 1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int round = 0; round < 5; ++round) {
+        const auto start = std::chrono::steady_clock::now();
+        auto f = pool.submit([] { return 7; });
+        EXPECT_EQ(7, f.get());
+        EXPECT_LT(std::chrono::steady_clock::now() - start,
+                  std::chrono::milliseconds(40));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
+
+TEST(BackoffTest, ParkedWorkersHelpWithSpawnedWork) {
+    lockfree::ThreadPool pool(4, lockfree::SchedulingMode::Fifo,
+                              lockfree::BackoffPolicy(4, 64, 1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::atomic<int> done{0};
+    pool.post([&pool, &done] {
+        for (int i = 0; i < 64; ++i) {
+            pool.post([&done] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                ++done;
+            });
+        }
+    });
+    pool.wait();
+    EXPECT_EQ(64, done.load());
+    EXPECT_GT(pool.tasks_stolen(), 0u);
+}
+
+TEST(BackoffTest, ShutdownWakesParkedWorkers) {
+    const auto start = std::chrono::steady_clock::now();
+    {
+        lockfree::ThreadPool pool(4);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(50 + 40));
+}
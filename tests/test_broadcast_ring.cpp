@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/broadcast_ring.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(BroadcastRingTest, EverySubscriberSeesEveryMessage) {
+    lockfree::BroadcastRing<std::string> ring(8);
+    EXPECT_EQ(8u, ring.capacity());
+    ring.publish("dropped");  // Nobody subscribed yet.
+
+    auto a = ring.subscribe();
+    auto b = ring.subscribe();
+    ring.publish("one");
+    ring.publish(std::string("two"));
+    EXPECT_EQ(3u, ring.published());
+    EXPECT_EQ(2u, a.available());
+
+    std::string value;
+    ASSERT_TRUE(a.try_read(value));
+    EXPECT_EQ("one", value);
+    ASSERT_TRUE(a.try_read(value));
+    EXPECT_EQ("two", value);
+    EXPECT_FALSE(a.try_read(value));
+
+    std::vector<std::string> seen;
+    EXPECT_EQ(2u, b.read_batch([&seen](const std::string& s) {
+        seen.push_back(s);
+    }));
+    EXPECT_EQ((std::vector<std::string>{"one", "two"}), seen);
+}
+
+TEST(BroadcastRingTest, SlowestSubscriberGatesWriter) {
+    lockfree::BroadcastRing<int> ring(4);
+    auto fast = ring.subscribe();
+    auto slow = ring.subscribe();
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(ring.try_publish(i));
+        int value;
+        ASSERT_TRUE(fast.try_read(value));
+    }
+    // slow has not read anything, so the ring is full for it.
+    EXPECT_FALSE(ring.try_publish(4));
+
+    int value;
+    ASSERT_TRUE(slow.try_read(value));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(ring.try_publish(4));
+    EXPECT_FALSE(ring.try_publish(5));
+
+    // An unsubscribed reader no longer holds the writer back.
+    slow.unsubscribe();
+    EXPECT_TRUE(ring.try_publish(5));
+}
+
+TEST(BroadcastRingTest, ReadBatchHonoursMax) {
+    lockfree::BroadcastRing<int> ring(16);
+    auto sub = ring.subscribe();
+    for (int i = 0; i < 10; ++i) {
+        ring.publish(i);
+    }
+    int sum = 0;
+    EXPECT_EQ(4u, sub.read_batch([&sum](int v) { sum += v; }, 4));
+    EXPECT_EQ(6, sum);
+    EXPECT_EQ(6u, sub.available());
+}
+
+class BroadcastRingStrategyTest
+    : public ::testing::TestWithParam<lockfree::WaitStrategy> {};
+
+// A small ring forces the writer to wait on the readers constantly, and
+// the readers on the writer.
+TEST_P(BroadcastRingStrategyTest, FanOutUnderBackpressure) {
+    const int kReaders = 4;
+    if (GetParam() == lockfree::WaitStrategy::BusySpin &&
+        std::thread::hardware_concurrency() <= kReaders) {
+        GTEST_SKIP() << "busy-spinning readers need a core each";
+    }
+    lockfree::BroadcastRing<uint64_t> ring(16, GetParam());
+    const uint64_t kMessages = 50000;
+
+    std::vector<lockfree::BroadcastRing<uint64_t>::Subscriber> subs;
+    for (int i = 0; i < kReaders; ++i) {
+        subs.push_back(ring.subscribe());
+    }
+    std::vector<uint64_t> sums(kReaders, 0);
+    std::atomic<bool> out_of_order(false);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < kReaders; ++i) {
+        readers.emplace_back([&, i]() {
+            uint64_t expected = 0;
+            while (subs[i].wait_batch([&](uint64_t v) {
+                if (v != expected++) {
+                    out_of_order.store(true);
+                }
+                sums[i] += v;
+            }, 1 + i * 7)) {
+            }
+        });
+    }
+    for (uint64_t m = 0; m < kMessages; ++m) {
+        ring.publish(m);
+    }
+    ring.close();
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    EXPECT_FALSE(out_of_order.load());
+    for (int i = 0; i < kReaders; ++i) {
+        EXPECT_EQ(kMessages * (kMessages - 1) / 2, sums[i]) << "reader " << i;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Strategies, BroadcastRingStrategyTest,
+                         ::testing::Values(lockfree::WaitStrategy::BusySpin,
+                                           lockfree::WaitStrategy::Yield,
+                                           lockfree::WaitStrategy::Block));
+
+TEST(BroadcastRingTest, SubscribeWhilePublishing) {
+    lockfree::BroadcastRing<uint64_t> ring(8, lockfree::WaitStrategy::Yield);
+    std::atomic<bool> stop(false);
+    std::atomic<bool> gap(false);
+    std::thread writer([&]() {
+        uint64_t m = 0;
+        while (!stop.load()) {
+            ring.try_publish(m) && ++m;
+            std::this_thread::yield();
+        }
+    });
+
+    // Late subscribers start somewhere in the stream but must then see a
+    // gap-free sequence, never a slot the writer has already reused.
+    for (int round = 0; round < 200; ++round) {
+        auto sub = ring.subscribe();
+        uint64_t first = 0;
+        uint64_t count = 0;
+        while (count < 20) {
+            if (!sub.read_batch([&](uint64_t v) {
+                    if (count == 0) {
+                        first = v;
+                    } else if (v != first + count) {
+                        gap.store(true);
+                    }
+                    ++count;
+                })) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    stop.store(true);
+    writer.join();
+    EXPECT_FALSE(gap.load());
+}
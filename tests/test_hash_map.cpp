@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/hash_map.hpp"
+#include "../include/lockfree/thread_pool.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(HashMapTest, InsertFindErase) {
+    lockfree::HashMap<int, std::string> map;
+    std::string value;
+    EXPECT_TRUE(map.empty());
+    EXPECT_FALSE(map.find(1, value));
+
+    EXPECT_TRUE(map.insert(1, "one"));
+    EXPECT_FALSE(map.insert(1, "uno"));
+    ASSERT_TRUE(map.find(1, value));
+    EXPECT_EQ("one", value);
+    EXPECT_EQ(1u, map.size());
+
+    EXPECT_FALSE(map.insert_or_assign(1, "uno"));
+    ASSERT_TRUE(map.find(1, value));
+    EXPECT_EQ("uno", value);
+
+    EXPECT_TRUE(map.erase(1));
+    EXPECT_FALSE(map.erase(1));
+    EXPECT_FALSE(map.contains(1));
+    EXPECT_TRUE(map.empty());
+
+    EXPECT_TRUE(map.insert_or_assign(1, "one"));
+    EXPECT_TRUE(map.contains(1));
+}
+
+TEST(HashMapTest, UpdateAndVisit) {
+    lockfree::HashMap<std::string, std::vector<int>> map;
+    EXPECT_FALSE(map.update("a", [](std::vector<int>& v) { v.push_back(1); }));
+    map.insert("a", std::vector<int>());
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(map.update("a", [i](std::vector<int>& v) { v.push_back(i); }));
+    }
+    size_t seen = 0;
+    EXPECT_TRUE(map.visit("a", [&seen](const std::vector<int>& v) {
+        seen = v.size();
+    }));
+    EXPECT_EQ(5u, seen);
+}
+
+TEST(HashMapTest, GrowsThroughSeveralResizes) {
+    lockfree::HashMap<int, int> map;
+    const size_t initial = map.capacity();
+    const int n = 20000;
+    for (int i = 0; i < n; ++i) {
+        ASSERT_TRUE(map.insert(i, i * 2));
+    }
+    EXPECT_GT(map.capacity(), initial);
+    EXPECT_EQ(static_cast<size_t>(n), map.size());
+    int value = 0;
+    for (int i = 0; i < n; ++i) {
+        ASSERT_TRUE(map.find(i, value)) << i;
+        EXPECT_EQ(i * 2, value);
+    }
+    EXPECT_FALSE(map.contains(n));
+}
+
+TEST(HashMapTest, TombstonesDoNotFillTheTable) {
+    lockfree::HashMap<int, int> map(16);
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 16; ++i) {
+            ASSERT_TRUE(map.insert(round * 16 + i, i));
+        }
+        for (int i = 0; i < 16; ++i) {
+            ASSERT_TRUE(map.erase(round * 16 + i));
+        }
+    }
+    EXPECT_TRUE(map.empty());
+    EXPECT_LE(map.capacity(), 256u);
+}
+
+// A resize of a table that is mostly tombstones must still find room in
+// the successor for the few live keys, while churn keeps writing to it.
+TEST(HashMapTest, TombstoneChurnResizeKeepsLiveKeys) {
+    lockfree::HashMap<int, int> map;
+    for (int i = 0; i < 9000; ++i) {
+        ASSERT_TRUE(map.insert(i, i));
+    }
+    for (int i = 10; i < 9000; ++i) {
+        ASSERT_TRUE(map.erase(i));
+    }
+    // Single inserts and erases until the table resizes, then bursts
+    // that outgrow a successor sized for the ten live keys alone.
+    int key = 9000;
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 200; ++i, ++key) {
+            ASSERT_TRUE(map.insert(key, key));
+            ASSERT_TRUE(map.erase(key));
+        }
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_TRUE(map.insert(key + i, key + i));
+        }
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_TRUE(map.erase(key + i));
+        }
+        key += 100;
+    }
+    EXPECT_EQ(10u, map.size());
+    int value = -1;
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(map.find(i, value)) << i;
+        EXPECT_EQ(i, value);
+    }
+}
+
+// Callers' heap maps keep their padded counters on lines of their own.
+TEST(HashMapTest, HeapMapsAreCacheLineAligned) {
+    std::vector<std::unique_ptr<lockfree::HashMap<int, int>>> maps;
+    for (int i = 0; i < 16; ++i) {
+        maps.emplace_back(new lockfree::HashMap<int, int>);
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(maps.back().get()) % 64);
+    }
+}
+
+TEST(HashMapTest, DestructorReleasesValues) {
+    std::shared_ptr<int> tracked = std::make_shared<int>(0);
+    {
+        lockfree::HashMap<int, std::shared_ptr<int>> map;
+        for (int i = 0; i < 1000; ++i) {
+            map.insert(i, tracked);
+        }
+        for (int i = 0; i < 500; ++i) {
+            map.erase(i);
+        }
+    }
+    lockfree::detail::hazard_reclaim();
+    EXPECT_EQ(1, tracked.use_count());
+}
+
+TEST(HashMapTest, ConcurrentInsertsDuringResize) {
+    lockfree::HashMap<int, int> map;
+    const int kThreads = 4;
+    const int kPerThread = 20000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&map, t] {
+            for (int i = 0; i < kPerThread; ++i) {
+                const int key = i * kThreads + t;
+                map.insert(key, key);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(static_cast<size_t>(kThreads * kPerThread), map.size());
+    int value = 0;
+    for (int key = 0; key < kThreads * kPerThread; ++key) {
+        ASSERT_TRUE(map.find(key, value)) << key;
+        EXPECT_EQ(key, value);
+    }
+}
+
+// Keys present from the start must stay visible to readers while
+// writers churn other keys and force resizes underneath them.
+TEST(HashMapTest, ReadersNeverMissStableKeys) {
+    lockfree::HashMap<int, int> map;
+    const int kStable = 1000;
+    for (int i = 0; i < kStable; ++i) {
+        map.insert(i, i);
+    }
+    std::atomic<bool> stop{false};
+    std::atomic<int> misses{0};
+    std::vector<std::thread> threads;
+    for (int r = 0; r < 2; ++r) {
+        threads.emplace_back([&] {
+            int value = 0;
+            while (!stop.load()) {
+                for (int i = 0; i < kStable; ++i) {
+                    if (!map.find(i, value) || value != i) {
+                        ++misses;
+                    }
+                }
+            }
+        });
+    }
+    for (int w = 0; w < 2; ++w) {
+        threads.emplace_back([&map, w] {
+            const int base = kStable + w * 100000;
+            for (int i = 0; i < 50000; ++i) {
+                map.insert(base + i, i);
+                if (i % 3 == 0) {
+                    map.erase(base + i / 2);
+                }
+            }
+        });
+    }
+    for (size_t i = 2; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    stop.store(true);
+    threads[0].join();
+    threads[1].join();
+    EXPECT_EQ(0, misses.load());
+}
+
+// Writers of one key are serialized, so concurrent read-modify-write
+// updates never lose an increment.
+TEST(HashMapTest, ConcurrentUpdatesOfOneKey) {
+    lockfree::HashMap<int, long> map;
+    map.insert(7, 0);
+    lockfree::ThreadPool pool(4);
+    std::vector<std::future<void>> futures;
+    for (int t = 0; t < 8; ++t) {
+        futures.push_back(pool.submit([&map] {
+            for (int i = 0; i < 1000; ++i) {
+                map.update(7, [](long& v) { ++v; });
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    long value = 0;
+    ASSERT_TRUE(map.find(7, value));
+    EXPECT_EQ(8000, value);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/hazard_pointer.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Counted {
+    static std::atomic<int> live;
+    Counted() { live.fetch_add(1); }
+    ~Counted() { live.fetch_sub(1); }
+};
+
+std::atomic<int> Counted::live{0};
+
+void force_scan() {
+    lockfree::detail::hazard_reclaim();
+}
+
+} // namespace
+
+TEST(HazardPointerTest, ProtectedNodeSurvivesRetire) {
+    std::atomic<Counted*> shared{new Counted};
+    Counted* victim = shared.load();
+
+    lockfree::detail::HazardPointer hp;
+    EXPECT_EQ(victim, hp.protect(shared));
+
+    shared.store(nullptr);
+    std::thread retirer([victim] {
+        lockfree::detail::hazard_retire(victim);
+        force_scan();
+    });
+    retirer.join();
+
+    // Only the protected node may still be alive; the retirer's leftovers
+    // were handed to the domain when it exited.
+    EXPECT_GE(Counted::live.load(), 1);
+
+    hp.reset();
+    force_scan();
+    EXPECT_EQ(0, Counted::live.load());
+}
+
+TEST(HazardPointerTest, NestedGuardsGetDistinctSlots) {
+    std::vector<std::unique_ptr<lockfree::detail::HazardPointer>> guards;
+    std::atomic<Counted*> targets[20];
+    for (auto& t : targets) {
+        t.store(new Counted);
+    }
+    for (auto& t : targets) {
+        guards.emplace_back(new lockfree::detail::HazardPointer);
+        guards.back()->protect(t);
+    }
+    for (auto& t : targets) {
+        lockfree::detail::hazard_retire(t.exchange(nullptr));
+    }
+    force_scan();
+    EXPECT_EQ(20, Counted::live.load());
+
+    guards.clear();
+    force_scan();
+    EXPECT_EQ(0, Counted::live.load());
+}
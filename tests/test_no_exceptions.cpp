@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/async_io.hpp"
+#include "../include/lockfree/broadcast_ring.hpp"
+#include "../include/lockfree/pipeline.hpp"
+#include "../include/lockfree/stack.hpp"
+#include "../include/lockfree/strand.hpp"
+#include "../include/lockfree/task_arena.hpp"
+#include "../include/lockfree/thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <vector>
+#include <unistd.h>
+
+// Built with -fno-exceptions, together with its own copies of
+// src/thread_pool.cpp and src/async_io.cpp, so the pool, its queues and
+// the status-returning submission API must compile and work without
+// exceptions.
+
+#if LOCKFREE_HAS_EXCEPTIONS
+#error "test_no_exceptions must be compiled with -fno-exceptions"
+#endif
+
+TEST(NoExceptionsTest, TryPostRunsEveryTask) {
+    lockfree::ThreadPool pool(4);
+    std::atomic<int> ran(0);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(lockfree::SubmitStatus::Ok, pool.try_post([&ran] { ++ran; }));
+    }
+    pool.wait();
+    EXPECT_EQ(1000, ran.load());
+    EXPECT_EQ(1000u, pool.tasks_executed());
+}
+
+TEST(NoExceptionsTest, TrySubmitDeliversResult) {
+    lockfree::ThreadPool pool(2);
+    std::future<int> future;
+    ASSERT_EQ(lockfree::SubmitStatus::Ok,
+              pool.try_submit([] { return 6 * 7; }, future));
+    EXPECT_EQ(42, future.get());
+}
+
+TEST(NoExceptionsTest, WorkersSpawnThroughTryPost) {
+    lockfree::ThreadPool pool(4, lockfree::SchedulingMode::Lifo);
+    std::atomic<int> ran(0);
+    pool.try_post([&pool, &ran] {
+        for (int i = 0; i < 100; ++i) {
+            pool.try_post([&ran] { ++ran; });
+        }
+    });
+    pool.wait();
+    EXPECT_EQ(100, ran.load());
+}
+
+TEST(NoExceptionsTest, ShutdownIsAStatus) {
+    lockfree::ThreadPool pool(2);
+    EXPECT_TRUE(pool.shutdown(lockfree::ShutdownMode::Drain));
+    EXPECT_EQ(lockfree::SubmitStatus::Shutdown, pool.try_post([] {}));
+    std::future<int> future;
+    EXPECT_EQ(lockfree::SubmitStatus::Shutdown,
+              pool.try_submit([] { return 1; }, future));
+    EXPECT_FALSE(future.valid());
+}
+
+TEST(NoExceptionsTest, TimersAndArenasRun) {
+    lockfree::ThreadPool pool(2);
+    std::atomic<int> fired(0);
+    pool.submit_after(std::chrono::milliseconds(1), [&fired] { ++fired; });
+    lockfree::TaskArena arena(pool, lockfree::ArenaOptions(1, 1));
+    for (int i = 0; i < 100; ++i) {
+        arena.post([&fired] { ++fired; });
+    }
+    arena.wait();
+    while (fired.load() < 101) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(101, fired.load());
+}
+
+TEST(NoExceptionsTest, AsyncIoCompletesOnThePool) {
+    lockfree::ThreadPool pool(2);
+    lockfree::AsyncIo io(pool);
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(1, write(fds[1], "x", 1));
+    char byte = 0;
+    std::atomic<int> result(0);
+    EXPECT_EQ(lockfree::SubmitStatus::Ok,
+              io.read(fds[0], &byte, 1, static_cast<uint64_t>(-1),
+                      [&result](int n) { result = n; }));
+    pool.wait();
+    EXPECT_EQ(1, result.load());
+    EXPECT_EQ('x', byte);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(NoExceptionsTest, StrandsPipelinesAndContainersRun) {
+    lockfree::ThreadPool pool(2);
+    lockfree::Strand strand(pool);
+    int serial = 0;  // only touched on the strand
+    for (int i = 0; i < 100; ++i) {
+        strand.post([&serial] { ++serial; });
+    }
+
+    std::vector<int> out;
+    int next = 0;
+    lockfree::Pipeline::source(pool, 4, [&next](lockfree::FlowControl& fc) {
+        if (next == 100) {
+            fc.stop();
+        }
+        return next++;
+    })
+        .sink(lockfree::StageMode::SerialInOrder,
+              [&out](int& v) { out.push_back(v); })
+        .run();
+    EXPECT_EQ(100u, out.size());
+    pool.wait();
+    EXPECT_EQ(100, serial);
+
+    lockfree::Stack<int> stack;
+    stack.push(1);
+    int value = 0;
+    EXPECT_TRUE(stack.pop(value));
+    EXPECT_EQ(1, value);
+
+    lockfree::BroadcastRing<int> ring(4);
+    auto reader = ring.subscribe();
+    ring.publish(9);
+    EXPECT_TRUE(reader.try_read(value));
+    EXPECT_EQ(9, value);
+}
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/object_pool.hpp"
+#include <atomic>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> g_live(0);
+
+struct Tracked {
+    Tracked() : owned(false) { g_live.fetch_add(1); }
+    ~Tracked() { g_live.fetch_sub(1); }
+
+    std::atomic<bool> owned;
+    char payload[64];
+};
+
+} // namespace
+
+TEST(ObjectPoolTest, ReusesReleasedObjects) {
+    {
+        lockfree::ObjectPool<Tracked> pool;
+        Tracked* first = pool.acquire();
+        pool.release(first);
+        EXPECT_EQ(first, pool.acquire());
+        pool.release(first);
+        pool.release(nullptr);
+        EXPECT_EQ(1, g_live.load());
+    }
+    EXPECT_EQ(0, g_live.load());
+}
+
+TEST(ObjectPoolTest, ObjectsFlowThroughDepot) {
+    lockfree::ObjectPool<Tracked> pool;
+    const int kObjects = 1000;
+    std::set<Tracked*> released;
+
+    // The worker's magazines go to the depot when it exits.
+    std::thread worker([&]() {
+        std::vector<Tracked*> objects;
+        for (int i = 0; i < kObjects; ++i) {
+            objects.push_back(pool.acquire());
+        }
+        for (Tracked* t : objects) {
+            released.insert(t);
+            pool.release(t);
+        }
+    });
+    worker.join();
+    EXPECT_EQ(static_cast<size_t>(kObjects), pool.cached());
+
+    for (int i = 0; i < kObjects; ++i) {
+        EXPECT_TRUE(released.count(pool.acquire())) << "object " << i;
+    }
+    EXPECT_EQ(0u, pool.cached());
+    EXPECT_EQ(kObjects, g_live.load());
+    // Acquired objects still belong to the pool's caller; hand them back
+    // so the pool can delete them.
+    for (Tracked* t : released) {
+        pool.release(t);
+    }
+}
+
+TEST(ObjectPoolTest, CapBoundsIdleObjects) {
+    const size_t kCap = 64;
+    {
+        lockfree::ObjectPool<Tracked> pool(kCap);
+        std::thread worker([&]() {
+            std::vector<Tracked*> objects;
+            for (int i = 0; i < 1000; ++i) {
+                objects.push_back(pool.acquire());
+            }
+            for (Tracked* t : objects) {
+                pool.release(t);
+            }
+        });
+        worker.join();
+        EXPECT_LE(pool.cached(), kCap);
+        EXPECT_EQ(static_cast<int>(pool.cached()), g_live.load());
+    }
+    EXPECT_EQ(0, g_live.load());
+}
+
+TEST(ObjectPoolTest, ConcurrentAcquireRelease) {
+    {
+        lockfree::ObjectPool<Tracked> pool(256);
+        std::atomic<bool> shared_owner(false);
+        const int kThreads = 8;
+        const int kIterations = 50000;
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t]() {
+                std::mt19937 rng(t);
+                std::vector<Tracked*> held;
+                for (int i = 0; i < kIterations; ++i) {
+                    if (held.empty() || (held.size() < 100 && rng() % 2)) {
+                        Tracked* obj = pool.acquire();
+                        // Nobody else may hold the same object.
+                        if (obj->owned.exchange(true)) {
+                            shared_owner.store(true);
+                        }
+                        held.push_back(obj);
+                    } else {
+                        Tracked* obj = held.back();
+                        held.pop_back();
+                        obj->owned.store(false);
+                        pool.release(obj);
+                    }
+                }
+                for (Tracked* obj : held) {
+                    obj->owned.store(false);
+                    pool.release(obj);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        EXPECT_FALSE(shared_owner.load());
+    }
+    EXPECT_EQ(0, g_live.load());
+}
+
+TEST(ObjectPoolTest, TaggedStackSurvivesConcurrentReuse) {
+    struct Node {
+        std::atomic<Node*> next;
+        std::atomic<int> holders;
+    };
+    const int kNodes = 16;
+    std::vector<Node> nodes(kNodes);
+    lockfree::detail::TaggedStack<Node> stack;
+    for (auto& n : nodes) {
+        n.holders.store(0);
+        stack.push(&n);
+    }
+
+    std::atomic<bool> duplicate(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 100000; ++i) {
+                Node* n = stack.pop();
+                if (!n) {
+                    continue;
+                }
+                if (n->holders.fetch_add(1) != 0) {
+                    duplicate.store(true);
+                }
+                n->holders.fetch_sub(1);
+                stack.push(n);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_FALSE(duplicate.load());
+
+    int remaining = 0;
+    while (stack.pop()) {
+        ++remaining;
+    }
+    EXPECT_EQ(kNodes, remaining);
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/pipeline.hpp"
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Source yielding 0..count-1.
+struct Counter {
+    int next;
+    int count;
+
+    int operator()(lockfree::FlowControl& fc) {
+        if (next == count) {
+            fc.stop();
+        }
+        return next++;
+    }
+};
+
+// Larger than PipelineValue's inline storage.
+struct Record {
+    int id;
+    char payload[200];
+};
+
+std::atomic<int> g_live_records(0);
+
+struct TrackedRecord {
+    explicit TrackedRecord(int id) : id(id) { g_live_records.fetch_add(1); }
+    TrackedRecord(const TrackedRecord& other) : id(other.id) {
+        g_live_records.fetch_add(1);
+    }
+    ~TrackedRecord() { g_live_records.fetch_sub(1); }
+
+    int id;
+    char payload[100];
+};
+
+} // namespace
+
+TEST(PipelineTest, InOrderSinkSeesSourceOrder) {
+    lockfree::ThreadPool pool(4);
+    const int kItems = 10000;
+    std::vector<int> out;  // Unsynchronized on purpose
+
+    lockfree::Pipeline pipeline =
+        lockfree::Pipeline::source(pool, 16, Counter{0, kItems})
+            .stage(lockfree::StageMode::Parallel, [](int& v) {
+                if (v % 7 == 0) {
+                    std::this_thread::yield();
+                }
+                return std::to_string(v);
+            })
+            .stage(lockfree::StageMode::Parallel,
+                   [](std::string& s) { return std::stoi(s); })
+            .sink(lockfree::StageMode::SerialInOrder,
+                  [&out](int& v) { out.push_back(v); });
+    lockfree::PipelineStats stats = pipeline.run();
+
+    ASSERT_EQ(static_cast<size_t>(kItems), out.size());
+    for (int i = 0; i < kItems; ++i) {
+        ASSERT_EQ(i, out[i]);
+    }
+    EXPECT_EQ(static_cast<size_t>(kItems), stats.items);
+    ASSERT_EQ(4u, stats.stages.size());
+    // The source is also called for the input that stops it.
+    EXPECT_EQ(static_cast<size_t>(kItems + 1), stats.stages[0].items);
+    for (size_t i = 1; i < stats.stages.size(); ++i) {
+        EXPECT_EQ(static_cast<size_t>(kItems), stats.stages[i].items);
+    }
+    EXPECT_GT(stats.items_per_second, 0);
+}
+
+TEST(PipelineTest, TokensBoundItemsInFlight) {
+    lockfree::ThreadPool pool(4);
+    const size_t kTokens = 4;
+    std::atomic<size_t> in_flight(0);
+    std::atomic<size_t> max_seen(0);
+    std::atomic<bool> overlapped(false);
+    std::atomic<int> serial_running(0);
+    int produced = 0;
+
+    lockfree::Pipeline pipeline =
+        lockfree::Pipeline::source(pool, kTokens,
+                [&](lockfree::FlowControl& fc) {
+            if (produced == 5000) {
+                fc.stop();
+                return 0;
+            }
+            // The source is serial, so nothing races this update.
+            const size_t n = in_flight.fetch_add(1) + 1;
+            if (n > max_seen.load()) {
+                max_seen.store(n);
+            }
+            return produced++;
+        })
+            .stage(lockfree::StageMode::Parallel, [](int& v) { return v; })
+            .sink(lockfree::StageMode::SerialOutOfOrder, [&](int&) {
+                if (serial_running.fetch_add(1) != 0) {
+                    overlapped.store(true);
+                }
+                serial_running.fetch_sub(1);
+                in_flight.fetch_sub(1);
+            });
+    lockfree::PipelineStats stats = pipeline.run();
+
+    EXPECT_FALSE(overlapped.load());
+    EXPECT_LE(max_seen.load(), kTokens);
+    EXPECT_LE(stats.max_in_flight, kTokens);
+    EXPECT_LE(stats.stages[2].max_queued, kTokens);
+    EXPECT_EQ(5000u, stats.items);
+}
+
+TEST(PipelineTest, LargeValuesAreDestroyed) {
+    {
+        lockfree::ThreadPool pool(4);
+        std::atomic<int> sum(0);
+        lockfree::Pipeline pipeline =
+            lockfree::Pipeline::source(pool, 8, Counter{0, 1000})
+                .stage(lockfree::StageMode::Parallel, [](int& v) {
+                    Record r;
+                    r.id = v;
+                    return r;
+                })
+                .stage(lockfree::StageMode::SerialOutOfOrder,
+                       [](Record& r) { return TrackedRecord(r.id); })
+                .stage(lockfree::StageMode::Parallel,
+                       [](TrackedRecord& r) {
+                           return std::unique_ptr<int>(new int(r.id));
+                       })
+                .sink(lockfree::StageMode::Parallel,
+                      [&sum](std::unique_ptr<int>& v) { sum += *v; });
+        pipeline.run();
+        EXPECT_EQ(999 * 1000 / 2, sum.load());
+        EXPECT_EQ(0, g_live_records.load());
+    }
+    EXPECT_EQ(0, g_live_records.load());
+}
+
+TEST(PipelineTest, StageExceptionStopsRunAndIsRethrown) {
+    lockfree::ThreadPool pool(4);
+    std::atomic<int> sunk(0);
+    bool fail = true;
+    int next = 0;
+
+    // An endless source: only the failure ends the first run.
+    lockfree::Pipeline pipeline =
+        lockfree::Pipeline::source(pool, 8,
+                [&next, &fail](lockfree::FlowControl& fc) {
+            if (!fail && next == 100) {
+                fc.stop();
+            }
+            return next++;
+        })
+            .stage(lockfree::StageMode::SerialInOrder, [&fail](int& v) {
+                if (fail && v == 50) {
+                    throw std::runtime_error("bad record");
+                }
+                return v;
+            })
+            .sink(lockfree::StageMode::SerialInOrder,
+                  [&sunk](int&) { sunk.fetch_add(1); });
+
+    EXPECT_THROW(pipeline.run(), std::runtime_error);
+    // Items ahead of the failure that had not reached the sink yet are
+    // cancelled too.
+    EXPECT_LE(sunk.load(), 50);
+
+    // The pipeline can run again once the failure is gone.
+    fail = false;
+    next = 0;
+    sunk.store(0);
+    lockfree::PipelineStats stats = pipeline.run();
+    EXPECT_EQ(100u, stats.items);
+    EXPECT_EQ(100, sunk.load());
+}
+
+TEST(PipelineTest, EmptySourceFinishesImmediately) {
+    lockfree::ThreadPool pool(2);
+    bool ran = false;
+    lockfree::Pipeline pipeline =
+        lockfree::Pipeline::source(pool, 4, Counter{0, 0})
+            .sink(lockfree::StageMode::Parallel, [&ran](int&) { ran = true; });
+    lockfree::PipelineStats stats = pipeline.run();
+    EXPECT_FALSE(ran);
+    EXPECT_EQ(0u, stats.items);
+    EXPECT_THROW(lockfree::Pipeline::source(pool, 0, Counter{0, 0}),
+                 std::invalid_argument);
+}
@@ -3,6 +3,10 @@
 #include <thread>
 #include <vector>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
 
 TEST(QueueTest, BasicOperations) {
     lockfree::Queue<int> q;
@@ -28,6 +32,7 @@ TEST(QueueTest, ConcurrentPushPop) {
     constexpr int kThreads = 4;
     constexpr int kItems = 10000;
     std::atomic<int> count{0};
+    std::atomic<int> consumed{0};
     
     auto producer = [&q, &count] {
         for (int i = 0; i < kItems; ++i) {
@@ -36,11 +41,14 @@ TEST(QueueTest, ConcurrentPushPop) {
         }
     };
     
-    auto consumer = [&q, &count] {
+    // Run until every item is consumed; count can touch zero while
+    // producers are still running.
+    auto consumer = [&q, &count, &consumed] {
         int val;
-        while (count.load(std::memory_order_relaxed) > 0 || !q.empty()) {
+        while (consumed.load(std::memory_order_relaxed) < kThreads * kItems) {
             if (q.pop(val)) {
                 count.fetch_sub(1, std::memory_order_relaxed);
+                consumed.fetch_add(1, std::memory_order_relaxed);
             }
         }
     };
@@ -150,3 +158,261 @@ TEST(QueueTest, ExceptionSafety) {
         EXPECT_TRUE(q.empty());
     }
 }
+
+TEST(QueueTest, PopWaitReceivesLaterPush) {
+    lockfree::Queue<int> q;
+    int val = 0;
+
+    std::thread producer([&q] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        q.push(7);
+    });
+
+    EXPECT_TRUE(q.pop_wait(val));
+    EXPECT_EQ(7, val);
+    producer.join();
+}
+
+TEST(QueueTest, PopWaitForTimesOut) {
+    lockfree::Queue<int> q;
+    int val = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(q.pop_wait_for(val, std::chrono::milliseconds(20)));
+    EXPECT_GE(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(20));
+
+    q.push(3);
+    EXPECT_TRUE(q.pop_wait_for(val, std::chrono::milliseconds(20)));
+    EXPECT_EQ(3, val);
+}
+
+TEST(QueueTest, PopWaitReturnsOnClear) {
+    lockfree::Queue<int> q;
+
+    std::thread consumer([&q] {
+        int val;
+        EXPECT_FALSE(q.pop_wait(val));
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    q.clear();
+    consumer.join();
+}
+
+TEST(QueueTest, BlockingConsumers) {
+    lockfree::Queue<int> q;
+    constexpr int kConsumers = 4;
+    constexpr int kItems = 10000;
+    std::atomic<long> sum{0};
+
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < kConsumers; ++i) {
+        consumers.emplace_back([&q, &sum] {
+            int val;
+            while (q.pop_wait(val) && val >= 0) {
+                sum.fetch_add(val, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (int i = 1; i <= kItems; ++i) {
+        q.push(i);
+    }
+    for (int i = 0; i < kConsumers; ++i) {
+        q.push(-1);
+    }
+
+    for (auto& t : consumers) {
+        t.join();
+    }
+
+    EXPECT_EQ(static_cast<long>(kItems) * (kItems + 1) / 2, sum.load());
+    EXPECT_TRUE(q.empty());
+}
+
+namespace {
+
+struct Message {
+    Message(int id, char fill) : id(id) {
+        for (auto& b : payload) b = fill;
+    }
+    Message(const Message&) = delete;
+    Message& operator=(const Message&) = delete;
+
+    int id;
+    char payload[252];
+};
+
+struct Tracked {
+    static std::atomic<int> live;
+    explicit Tracked(int v) : value(v) { live.fetch_add(1); }
+    Tracked(Tracked&& other) : value(other.value) { live.fetch_add(1); }
+    Tracked& operator=(Tracked&& other) {
+        value = other.value;
+        return *this;
+    }
+    ~Tracked() { live.fetch_sub(1); }
+    int value;
+};
+
+std::atomic<int> Tracked::live{0};
+
+} // namespace
+
+TEST(QueueTest, EmplaceAndConsumeInPlace) {
+    lockfree::Queue<Message> q;
+    q.emplace(1, 'a');
+    q.emplace(2, 'b');
+
+    int seen = 0;
+    EXPECT_TRUE(q.consume([&seen](Message& m) {
+        EXPECT_EQ('a', m.payload[251]);
+        seen = m.id;
+    }));
+    EXPECT_EQ(1, seen);
+    EXPECT_TRUE(q.consume([&seen](Message& m) { seen = m.id; }));
+    EXPECT_EQ(2, seen);
+    EXPECT_FALSE(q.consume([](Message&) { FAIL(); }));
+}
+
+TEST(QueueTest, MoveOnlyElements) {
+    lockfree::Queue<std::unique_ptr<int>> q;
+    q.push(std::unique_ptr<int>(new int(5)));
+
+    std::unique_ptr<int> out;
+    EXPECT_TRUE(q.pop(out));
+    ASSERT_TRUE(out);
+    EXPECT_EQ(5, *out);
+}
+
+TEST(QueueTest, ElementsDestroyedExactlyOnce) {
+    {
+        lockfree::Queue<Tracked> q;
+        EXPECT_EQ(0, Tracked::live.load());  // sentinel holds no element
+
+        for (int i = 0; i < 10; ++i) {
+            q.emplace(i);
+        }
+        EXPECT_EQ(10, Tracked::live.load());
+
+        EXPECT_TRUE(q.consume([](Tracked& t) { EXPECT_EQ(0, t.value); }));
+        EXPECT_EQ(9, Tracked::live.load());
+
+        EXPECT_THROW(q.consume([](Tracked&) { throw std::runtime_error("x"); }),
+                     std::runtime_error);
+        EXPECT_EQ(8, Tracked::live.load());
+        EXPECT_EQ(8u, q.size());
+    }
+    EXPECT_EQ(0, Tracked::live.load());
+}
+
+TEST(QueueTest, ConcurrentConsumeManyConsumers) {
+    lockfree::Queue<int> q;
+    constexpr int kProducers = 4;
+    constexpr int kConsumers = 4;
+    constexpr int kItems = 20000;
+    std::atomic<long> sum{0};
+    std::atomic<int> consumed{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < kProducers; ++p) {
+        threads.emplace_back([&q] {
+            for (int i = 1; i <= kItems; ++i) {
+                q.emplace(i);
+            }
+        });
+    }
+    for (int c = 0; c < kConsumers; ++c) {
+        threads.emplace_back([&] {
+            while (consumed.load() < kProducers * kItems) {
+                q.consume([&](int& v) {
+                    sum.fetch_add(v, std::memory_order_relaxed);
+                    consumed.fetch_add(1);
+                });
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(static_cast<long>(kProducers) * kItems * (kItems + 1) / 2,
+              sum.load());
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(QueueTest, BulkPushPop) {
+    lockfree::Queue<int> q;
+    std::vector<int> in = {1, 2, 3, 4, 5};
+    q.push_bulk(in.begin(), in.end());
+    EXPECT_EQ(5u, q.size());
+
+    std::vector<int> out;
+    EXPECT_EQ(3u, q.pop_bulk(out, 3));
+    EXPECT_EQ((std::vector<int>{1, 2, 3}), out);
+    EXPECT_EQ(2u, q.size());
+
+    EXPECT_EQ(2u, q.pop_bulk(out, 10));
+    EXPECT_EQ((std::vector<int>{1, 2, 3, 4, 5}), out);
+    EXPECT_EQ(0u, q.pop_bulk(out, 10));
+    EXPECT_TRUE(q.empty());
+
+    q.push(6);
+    int val;
+    EXPECT_TRUE(q.pop(val));
+    EXPECT_EQ(6, val);
+}
+
+TEST(QueueTest, ConcurrentBulkConsumers) {
+    lockfree::Queue<int> q;
+    constexpr int kProducers = 2;
+    constexpr int kConsumers = 4;
+    constexpr int kItems = 20000;
+    std::atomic<long> sum{0};
+    std::atomic<int> consumed{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < kProducers; ++p) {
+        threads.emplace_back([&q] {
+            std::vector<int> batch;
+            for (int i = 1; i <= kItems; ++i) {
+                batch.push_back(i);
+                if (batch.size() == 7 || i == kItems) {
+                    q.push_bulk(batch.begin(), batch.end());
+                    batch.clear();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < kConsumers; ++c) {
+        threads.emplace_back([&] {
+            std::vector<int> out;
+            while (consumed.load() < kProducers * kItems) {
+                out.clear();
+                size_t n = q.pop_bulk(out, 5);
+                long local = 0;
+                for (int v : out) local += v;
+                sum.fetch_add(local);
+                consumed.fetch_add(static_cast<int>(n));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(static_cast<long>(kProducers) * kItems * (kItems + 1) / 2,
+              sum.load());
+    EXPECT_TRUE(q.empty());
+}
+
+// head_ and tail_ sit on their own lines only if the object does; new
+// must keep the queue's 64-byte alignment even before C++17.
+TEST(QueueTest, HeapQueuesAreCacheLineAligned) {
+    std::vector<std::unique_ptr<lockfree::Queue<int>>> queues;
+    for (int i = 0; i < 16; ++i) {
+        queues.emplace_back(new lockfree::Queue<int>);
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(queues.back().get()) % 64);
+    }
+}
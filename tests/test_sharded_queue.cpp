@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/sharded_queue.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+TEST(ShardedQueueTest, BasicOperations) {
+    lockfree::ShardedQueue<int> q(4);
+    EXPECT_EQ(4u, q.shard_count());
+    EXPECT_TRUE(q.empty());
+
+    q.push(1);
+    q.emplace(2);
+    EXPECT_EQ(2u, q.size());
+
+    int val;
+    EXPECT_TRUE(q.pop(val));
+    EXPECT_EQ(1, val);
+    EXPECT_TRUE(q.pop(val));
+    EXPECT_EQ(2, val);
+    EXPECT_FALSE(q.pop(val));
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ShardedQueueTest, StrictOrderIsFifo) {
+    lockfree::ShardedQueue<int> q(8, lockfree::ShardOrder::Strict);
+    for (int i = 0; i < 1000; ++i) {
+        q.push(i);
+    }
+    int val;
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(q.pop(val));
+        EXPECT_EQ(i, val);
+    }
+    EXPECT_FALSE(q.pop(val));
+}
+
+// Producers race on few shards while one consumer drains, so tickets
+// t and t + n regularly meet on a shard. Each producer's items must still
+// come out in the order it pushed them.
+TEST(ShardedQueueTest, StrictOrderHoldsAcrossProducers) {
+    lockfree::ShardedQueue<std::pair<int, int>> q(2, lockfree::ShardOrder::Strict);
+    constexpr int kProducers = 4;
+    constexpr int kItems = 20000;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&q, p] {
+            for (int i = 0; i < kItems; ++i) {
+                q.emplace(p, i);
+            }
+        });
+    }
+
+    std::vector<int> last(kProducers, -1);
+    std::pair<int, int> item;
+    int count = 0;
+    bool ordered = true;
+    while (count < kProducers * kItems) {
+        if (!q.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ordered = ordered && item.second == last[item.first] + 1;
+        last[item.first] = item.second;
+        ++count;
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    EXPECT_TRUE(ordered);
+    EXPECT_FALSE(q.pop(item));
+}
+
+namespace {
+
+struct ThrowsOnNegative {
+    int value;
+    explicit ThrowsOnNegative(int v) : value(v) {
+        if (v < 0) throw std::runtime_error("negative");
+    }
+};
+
+} // namespace
+
+// A push that throws never takes a ticket, so no pop waits for it.
+TEST(ShardedQueueTest, StrictThrowingPushLeavesNoHole) {
+    lockfree::ShardedQueue<ThrowsOnNegative> q(4, lockfree::ShardOrder::Strict);
+    q.emplace(0);
+    EXPECT_THROW(q.emplace(-1), std::runtime_error);
+    q.emplace(1);
+    EXPECT_EQ(2u, q.size());
+
+    int seen = 0;
+    auto take = [&seen](ThrowsOnNegative& item) { seen = item.value; };
+    ASSERT_TRUE(q.consume(take));
+    EXPECT_EQ(0, seen);
+    ASSERT_TRUE(q.consume(take));
+    EXPECT_EQ(1, seen);
+    EXPECT_FALSE(q.consume(take));
+}
+
+TEST(ShardedQueueTest, RelaxedKeepsPerProducerOrder) {
+    lockfree::ShardedQueue<std::pair<int, int>> q(4);
+    constexpr int kProducers = 4;
+    constexpr int kItems = 5000;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&q, p] {
+            for (int i = 0; i < kItems; ++i) {
+                q.emplace(p, i);
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    std::vector<int> last(kProducers, -1);
+    std::pair<int, int> item;
+    int count = 0;
+    while (q.pop(item)) {
+        EXPECT_GT(item.second, last[item.first]);
+        last[item.first] = item.second;
+        ++count;
+    }
+    EXPECT_EQ(kProducers * kItems, count);
+}
+
+class ShardedQueueModeTest
+    : public ::testing::TestWithParam<lockfree::ShardOrder> {};
+
+TEST_P(ShardedQueueModeTest, ConcurrentProducersConsumers) {
+    lockfree::ShardedQueue<int> q(4, GetParam());
+    constexpr int kThreads = 4;
+    constexpr int kItems = 10000;
+    std::atomic<long> sum{0};
+    std::atomic<int> consumed{0};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&q] {
+            for (int j = 1; j <= kItems; ++j) {
+                q.push(j);
+            }
+        });
+        threads.emplace_back([&] {
+            int val;
+            while (consumed.load() < kThreads * kItems) {
+                if (q.pop(val)) {
+                    sum.fetch_add(val, std::memory_order_relaxed);
+                    consumed.fetch_add(1);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(static_cast<long>(kThreads) * kItems * (kItems + 1) / 2,
+              sum.load());
+    EXPECT_TRUE(q.empty());
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, ShardedQueueModeTest,
+                         ::testing::Values(lockfree::ShardOrder::Relaxed,
+                                           lockfree::ShardOrder::Strict));
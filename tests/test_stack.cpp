@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/stack.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST(StackTest, PopsInReverseOrder) {
+    lockfree::Stack<int> stack;
+    int value = 0;
+    EXPECT_TRUE(stack.empty());
+    EXPECT_FALSE(stack.pop(value));
+
+    for (int i = 0; i < 100; ++i) {
+        stack.push(i);
+    }
+    EXPECT_EQ(100u, stack.size());
+    for (int i = 99; i >= 0; --i) {
+        ASSERT_TRUE(stack.pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_TRUE(stack.empty());
+    EXPECT_EQ(0u, stack.size());
+}
+
+TEST(StackTest, HoldsMoveOnlyValues) {
+    lockfree::Stack<std::unique_ptr<int>> stack;
+    stack.push(std::unique_ptr<int>(new int(1)));
+    stack.emplace(new int(2));
+    std::unique_ptr<int> value;
+    ASSERT_TRUE(stack.pop(value));
+    EXPECT_EQ(2, *value);
+    ASSERT_TRUE(stack.pop(value));
+    EXPECT_EQ(1, *value);
+}
+
+TEST(StackTest, DestructorDestroysRemainingValues) {
+    std::shared_ptr<int> tracked = std::make_shared<int>(0);
+    {
+        lockfree::Stack<std::shared_ptr<int>> stack;
+        for (int i = 0; i < 10; ++i) {
+            stack.push(tracked);
+        }
+        std::shared_ptr<int> popped;
+        stack.pop(popped);
+        EXPECT_EQ(11, tracked.use_count());
+    }
+    EXPECT_EQ(1, tracked.use_count());
+}
+
+TEST(StackTest, HeapStacksAreCacheLineAligned) {
+    std::vector<std::unique_ptr<lockfree::Stack<int>>> stacks;
+    for (int i = 0; i < 16; ++i) {
+        stacks.emplace_back(new lockfree::Stack<int>);
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(stacks.back().get()) % 64);
+    }
+}
+
+TEST(StackTest, ConcurrentPushPop) {
+    lockfree::Stack<int> stack;
+    const int kThreads = 8;
+    const int kPerThread = 20000;
+    std::vector<std::atomic<int>> seen(kThreads * kPerThread);
+    for (auto& s : seen) {
+        s.store(0);
+    }
+    std::atomic<int> popped(0);
+
+    // Every thread both pushes and pops, so head_ is contended and pairs
+    // regularly meet in the elimination slots.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < kPerThread; ++i) {
+                stack.push(t * kPerThread + i);
+                int value;
+                if (stack.pop(value)) {
+                    seen[value].fetch_add(1);
+                    popped.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    int value;
+    while (stack.pop(value)) {
+        seen[value].fetch_add(1);
+        popped.fetch_add(1);
+    }
+
+    EXPECT_EQ(kThreads * kPerThread, popped.load());
+    for (size_t i = 0; i < seen.size(); ++i) {
+        ASSERT_EQ(1, seen[i].load()) << "value " << i;
+    }
+}
@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/strand.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void wait_idle(const lockfree::Strand& strand) {
+    while (!strand.idle()) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+TEST(StrandTest, RunsSeriallyInPostingOrder) {
+    lockfree::ThreadPool pool(4);
+    lockfree::Strand strand(pool);
+    std::vector<int> order;  // Unsynchronized on purpose
+    std::atomic_int in_flight(0);
+    std::atomic_bool overlapped(false);
+
+    const int kTasks = 10000;
+    for (int i = 0; i < kTasks; ++i) {
+        strand.post([&, i] {
+            if (in_flight.fetch_add(1) != 0) {
+                overlapped = true;
+            }
+            order.push_back(i);
+            in_flight.fetch_sub(1);
+        });
+    }
+    wait_idle(strand);
+
+    EXPECT_FALSE(overlapped.load());
+    ASSERT_EQ(static_cast<size_t>(kTasks), order.size());
+    for (int i = 0; i < kTasks; ++i) {
+        EXPECT_EQ(i, order[i]);
+    }
+}
+
+TEST(StrandTest, ConcurrentProducersKeepPerProducerOrder) {
+    lockfree::ThreadPool pool(4);
+    lockfree::Strand strand(pool);
+    const int kProducers = 4;
+    const int kPerProducer = 5000;
+    std::vector<int> last(kProducers, -1);
+    std::atomic_bool out_of_order(false);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < kPerProducer; ++i) {
+                strand.post([&, p, i] {
+                    if (last[p] != i - 1) {
+                        out_of_order = true;
+                    }
+                    last[p] = i;
+                });
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    wait_idle(strand);
+
+    EXPECT_FALSE(out_of_order.load());
+    for (int p = 0; p < kProducers; ++p) {
+        EXPECT_EQ(kPerProducer - 1, last[p]);
+    }
+}
+
+TEST(StrandTest, StrandsRunInParallel) {
+    lockfree::ThreadPool pool(2);
+    lockfree::Strand a(pool);
+    lockfree::Strand b(pool);
+    std::atomic_int arrived(0);
+
+    // Each side waits for the other, which only works if both strands
+    // hold a worker at the same time.
+    auto rendezvous = [&arrived] {
+        arrived.fetch_add(1);
+        const auto deadline = std::chrono::steady_clock::now() +
+                              std::chrono::seconds(5);
+        while (arrived.load() < 2 &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        return arrived.load();
+    };
+    auto fa = a.submit(rendezvous);
+    auto fb = b.submit(rendezvous);
+    EXPECT_EQ(2, fa.get());
+    EXPECT_EQ(2, fb.get());
+}
+
+TEST(StrandTest, BatchesInterleaveBetweenStrands) {
+    lockfree::ThreadPool pool(1);
+    lockfree::Strand a(pool);
+    lockfree::Strand b(pool);
+    std::vector<char> trace;  // Single worker, so no race
+
+    // Posted from the worker so both drains start in its local queue,
+    // a's ahead of b's, and neither runs before everything is queued.
+    const int kTasks = 4 * static_cast<int>(lockfree::Strand::kMaxBatch);
+    pool.submit([&] {
+        for (int i = 0; i < kTasks; ++i) {
+            a.post([&trace] { trace.push_back('a'); });
+        }
+        for (int i = 0; i < kTasks; ++i) {
+            b.post([&trace] { trace.push_back('b'); });
+        }
+    }).get();
+    wait_idle(a);
+    wait_idle(b);
+
+    ASSERT_EQ(static_cast<size_t>(2 * kTasks), trace.size());
+    // b got the worker before a finished its backlog.
+    size_t first_b = 0;
+    while (trace[first_b] != 'b') ++first_b;
+    size_t last_a = trace.size() - 1;
+    while (trace[last_a] != 'a') --last_a;
+    EXPECT_LT(first_b, last_a);
+}
+
+TEST(StrandTest, SubmitPropagatesResultsAndExceptions) {
+    lockfree::ThreadPool pool(2);
+    lockfree::Strand strand(pool);
+    auto value = strand.submit([] { return 42; });
+    auto error = strand.submit([]() -> int {
+        throw std::runtime_error("strand task failed");
+    });
+    auto after = strand.submit([] { return 7; });
+
+    EXPECT_EQ(42, value.get());
+    EXPECT_THROW(error.get(), std::runtime_error);
+    EXPECT_EQ(7, after.get());
+}
+
+TEST(StrandTest, PostedExceptionsAreLogged) {
+    lockfree::ThreadPool pool(1);
+    lockfree::Strand strand(pool);
+    std::atomic_int after(0);
+    testing::internal::CaptureStderr();
+    strand.post([] { throw std::runtime_error("posted task failed"); });
+    strand.post([&after] { after.fetch_add(1); });
+    wait_idle(strand);
+    const std::string log = testing::internal::GetCapturedStderr();
+    EXPECT_NE(std::string::npos, log.find("posted task failed"));
+    EXPECT_EQ(1, after.load());
+}
+
+// Once the pool is gone every post reports it, instead of queueing
+// behind a drain that will never run.
+TEST(StrandTest, PostAfterShutdownThrowsAndDoesNotWedge) {
+    lockfree::ThreadPool pool(1);
+    lockfree::Strand strand(pool);
+    pool.shutdown();
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_THROW(strand.post([] { FAIL() << "ran after shutdown"; }),
+                     std::runtime_error);
+        EXPECT_TRUE(strand.idle());
+    }
+}
+
+// A drain still queued when the pool aborts is dropped, and takes the
+// strand's tasks with it rather than leaving the strand busy forever.
+TEST(StrandTest, AbortDropsQueuedDrain) {
+    lockfree::ThreadPool pool(1);
+    lockfree::Strand strand(pool);
+    std::atomic_bool release(false);
+    std::atomic_bool blocking(false);
+    pool.post([&] {
+        blocking = true;
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocking.load()) {
+        std::this_thread::yield();
+    }
+    std::atomic_int ran(0);
+    for (int i = 0; i < 3; ++i) {
+        strand.post([&ran] { ran.fetch_add(1); });
+    }
+    std::thread stopper([&pool] {
+        pool.shutdown(lockfree::ShutdownMode::Abort);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release = true;
+    stopper.join();
+
+    EXPECT_TRUE(strand.idle());
+    EXPECT_TRUE(ran.load() == 0 || ran.load() == 3);
+    EXPECT_THROW(strand.post([] {}), std::runtime_error);
+}
+
+TEST(StrandTest, IdleStrandIsSmall) {
+    EXPECT_LE(sizeof(lockfree::Strand), 64u);
+
+    lockfree::ThreadPool pool(2);
+    std::vector<std::unique_ptr<lockfree::Strand>> strands;
+    for (int i = 0; i < 10000; ++i) {
+        strands.emplace_back(new lockfree::Strand(pool));
+    }
+    std::atomic_int counter(0);
+    for (auto& s : strands) {
+        s->post([&counter] { counter.fetch_add(1); });
+    }
+    for (auto& s : strands) {
+        wait_idle(*s);
+    }
+    EXPECT_EQ(10000, counter.load());
+}
@@ -0,0 +1,275 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/aba_protected_queue.hpp"
+#include "../include/lockfree/queue.hpp"
+#include "../include/lockfree/schedule_point.hpp"
+#include "../include/lockfree/thread_pool.hpp"
+#include "stress/history.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Stress rounds run for LOCKFREE_STRESS_SECONDS (one round per test when
+// unset) starting from LOCKFREE_STRESS_SEED (random when unset). A
+// failure prints the seed of its round; rerunning with that seed replays
+// the same schedule-point decisions. Schedule points only fire in
+// LOCKFREE_STRESS builds; without them the rounds are plain stress.
+
+namespace {
+
+uint64_t env_or(const char* name, uint64_t fallback) {
+    const char* value = std::getenv(name);
+    return value ? std::strtoull(value, nullptr, 10) : fallback;
+}
+
+// Calls round(seed) once, or until the soak time is used up.
+template <typename F>
+void for_each_round(F round) {
+    const uint64_t base = env_or("LOCKFREE_STRESS_SEED", std::random_device{}());
+    const auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::seconds(env_or("LOCKFREE_STRESS_SECONDS", 0));
+    uint64_t seed = base;
+    do {
+        SCOPED_TRACE("LOCKFREE_STRESS_SEED=" + std::to_string(seed));
+        lockfree::stress::configure(seed, 50);
+        round(seed);
+        ++seed;
+    } while (!::testing::Test::HasFailure() &&
+             std::chrono::steady_clock::now() < deadline);
+    lockfree::stress::configure(0, 0);
+}
+
+void pop_some(lockfree::Queue<uint64_t>& queue, std::vector<uint64_t>& out,
+              size_t max) {
+    queue.pop_bulk(out, max);
+}
+
+void pop_some(lockfree::ABAProtectedQueue<uint64_t>& queue,
+              std::vector<uint64_t>& out, size_t) {
+    uint64_t value = 0;
+    if (queue.pop(value)) {
+        out.push_back(value);
+    }
+}
+
+// producers push disjoint ranges of values while consumers pop with a
+// mix of pop() and pop_bulk(); the main thread drains what is left.
+// Returns the first linearizability violation, if any.
+template <typename Q>
+std::string run_queue_round(Q& queue, uint64_t seed, size_t producers,
+                            size_t consumers, size_t per_producer,
+                            bool bulk) {
+    const size_t total = producers * per_producer;
+    const size_t threads = producers + consumers + 1;
+    stress::QueueHistory history(threads, per_producer * 2);
+    std::atomic<size_t> popped(0);
+    std::atomic<bool> go(false);
+
+    std::vector<std::thread> workers;
+    for (size_t p = 0; p < producers; ++p) {
+        workers.emplace_back([&, p] {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            for (size_t i = 0; i < per_producer; ++i) {
+                const uint64_t value = p * per_producer + i;
+                const uint64_t t = stress::now_ns();
+                queue.push(value);
+                history.push(p, value, t);
+            }
+        });
+    }
+    for (size_t c = 0; c < consumers; ++c) {
+        const size_t id = producers + c;
+        workers.emplace_back([&, id] {
+            std::mt19937_64 rng(seed + id);
+            std::vector<uint64_t> batch;
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            while (popped.load(std::memory_order_relaxed) < total) {
+                const uint64_t t = stress::now_ns();
+                if (bulk && rng() % 4 == 0) {
+                    batch.clear();
+                    pop_some(queue, batch, 1 + rng() % 4);
+                    if (batch.empty()) {
+                        history.pop(id, false, 0, t);
+                    }
+                    // A bulk pop takes a run of the front in one step;
+                    // each element is logged with the call's interval.
+                    for (uint64_t value : batch) {
+                        history.pop(id, true, value, t);
+                    }
+                    popped.fetch_add(batch.size(), std::memory_order_relaxed);
+                } else {
+                    uint64_t value = 0;
+                    const bool ok = queue.pop(value);
+                    history.pop(id, ok, value, t);
+                    if (ok) {
+                        popped.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+        });
+    }
+    go.store(true);
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    const size_t main_thread = threads - 1;
+    for (;;) {
+        uint64_t value = 0;
+        const uint64_t t = stress::now_ns();
+        const bool ok = queue.pop(value);
+        history.pop(main_thread, ok, value, t);
+        if (!ok) {
+            break;
+        }
+    }
+    return history.check();
+}
+
+stress::Operation op(stress::Operation::Kind kind, uint64_t value,
+                     uint64_t invoked, uint64_t returned) {
+    stress::Operation result = {kind, value, invoked, returned};
+    return result;
+}
+
+} // namespace
+
+TEST(QueueHistoryTest, AcceptsOverlappingFifoHistory) {
+    stress::QueueHistory history(2);
+    history.record(0, op(stress::Operation::Push, 1, 0, 10));
+    history.record(1, op(stress::Operation::Push, 2, 5, 15));
+    // Pushes overlap, so either order out is fine.
+    history.record(0, op(stress::Operation::Pop, 2, 20, 30));
+    history.record(1, op(stress::Operation::Pop, 1, 25, 35));
+    history.record(0, op(stress::Operation::PopEmpty, 0, 40, 50));
+    EXPECT_EQ("", history.check());
+}
+
+TEST(QueueHistoryTest, FlagsReorderedPops) {
+    stress::QueueHistory history(1);
+    history.record(0, op(stress::Operation::Push, 1, 0, 10));
+    history.record(0, op(stress::Operation::Push, 2, 20, 30));
+    history.record(0, op(stress::Operation::Pop, 2, 40, 50));
+    history.record(0, op(stress::Operation::Pop, 1, 60, 70));
+    EXPECT_NE(std::string::npos, history.check().find("FIFO order"));
+}
+
+TEST(QueueHistoryTest, FlagsValueOvertakingOneNeverPopped) {
+    stress::QueueHistory history(1);
+    history.record(0, op(stress::Operation::Push, 1, 0, 10));
+    history.record(0, op(stress::Operation::Push, 2, 20, 30));
+    history.record(0, op(stress::Operation::Pop, 2, 40, 50));
+    EXPECT_NE(std::string::npos, history.check().find("FIFO order"));
+}
+
+TEST(QueueHistoryTest, FlagsEmptyPopWithValueInside) {
+    stress::QueueHistory history(2);
+    history.record(0, op(stress::Operation::Push, 7, 0, 10));
+    history.record(1, op(stress::Operation::PopEmpty, 0, 20, 30));
+    history.record(1, op(stress::Operation::Pop, 7, 40, 50));
+    EXPECT_NE(std::string::npos, history.check().find("reported empty"));
+
+    // Overlapping the pop that took the value, the empty pop is legal.
+    stress::QueueHistory overlapping(2);
+    overlapping.record(0, op(stress::Operation::Push, 7, 0, 10));
+    overlapping.record(0, op(stress::Operation::Pop, 7, 15, 25));
+    overlapping.record(1, op(stress::Operation::PopEmpty, 0, 20, 30));
+    EXPECT_EQ("", overlapping.check());
+}
+
+TEST(QueueHistoryTest, FlagsPhantomAndDuplicatePops) {
+    stress::QueueHistory phantom(1);
+    phantom.record(0, op(stress::Operation::Pop, 3, 0, 10));
+    EXPECT_NE(std::string::npos, phantom.check().find("never pushed"));
+
+    stress::QueueHistory duplicate(2);
+    duplicate.record(0, op(stress::Operation::Push, 3, 0, 10));
+    duplicate.record(0, op(stress::Operation::Pop, 3, 20, 30));
+    duplicate.record(1, op(stress::Operation::Pop, 3, 25, 35));
+    EXPECT_NE(std::string::npos, duplicate.check().find("second time"));
+}
+
+TEST(StressTest, SchedulePointsFireOnlyInStressBuilds) {
+    lockfree::stress::configure(1, 1000);
+    for (int i = 0; i < 10; ++i) {
+        LOCKFREE_SCHEDULE_POINT();
+    }
+    EXPECT_EQ(lockfree::stress::kEnabled ? 10u : 0u,
+              lockfree::stress::injected());
+    lockfree::stress::configure(0, 0);
+}
+
+TEST(StressTest, QueueManyConsumersIsLinearizable) {
+    for_each_round([](uint64_t seed) {
+        lockfree::Queue<uint64_t> queue;
+        EXPECT_EQ("", run_queue_round(queue, seed, 2, 6, 5000, true));
+    });
+}
+
+TEST(StressTest, QueueManyProducersIsLinearizable) {
+    for_each_round([](uint64_t seed) {
+        lockfree::Queue<uint64_t> queue;
+        EXPECT_EQ("", run_queue_round(queue, seed, 6, 2, 2000, false));
+    });
+}
+
+TEST(StressTest, ABAProtectedQueueIsLinearizable) {
+    for_each_round([](uint64_t seed) {
+        lockfree::ABAProtectedQueue<uint64_t> queue;
+        EXPECT_EQ("", run_queue_round(queue, seed, 3, 5, 4000, true));
+    });
+}
+
+// Every task runs exactly once while external submissions, worker
+// spawns, steals and parking all race, and the pool's sharded counters
+// agree afterwards.
+TEST(StressTest, ThreadPoolRunsEveryTaskOnce) {
+    for_each_round([](uint64_t seed) {
+        const size_t kSubmitters = 3;
+        const size_t kSeeds = 200;
+        const size_t kFanout = 8;
+        const size_t kTasks = kSubmitters * kSeeds * (1 + kFanout);
+        std::unique_ptr<std::atomic<int>[]> runs(new std::atomic<int>[kTasks]);
+        for (size_t i = 0; i < kTasks; ++i) {
+            runs[i].store(0);
+        }
+
+        lockfree::ThreadPool pool(4, seed % 2 ? lockfree::SchedulingMode::Lifo
+                                              : lockfree::SchedulingMode::Fifo);
+        std::vector<std::thread> submitters;
+        for (size_t s = 0; s < kSubmitters; ++s) {
+            submitters.emplace_back([&, s] {
+                for (size_t i = 0; i < kSeeds; ++i) {
+                    const size_t id = (s * kSeeds + i) * (1 + kFanout);
+                    std::atomic<int>* slots = &runs[id];
+                    pool.post([&pool, slots, kFanout] {
+                        slots[0].fetch_add(1);
+                        for (size_t k = 1; k <= kFanout; ++k) {
+                            pool.post([slots, k] { slots[k].fetch_add(1); });
+                        }
+                    });
+                }
+            });
+        }
+        for (auto& t : submitters) {
+            t.join();
+        }
+        pool.wait();
+
+        size_t wrong = 0;
+        for (size_t i = 0; i < kTasks; ++i) {
+            wrong += runs[i].load() != 1;
+        }
+        EXPECT_EQ(0u, wrong);
+        EXPECT_EQ(0u, pool.active_tasks());
+        EXPECT_EQ(kTasks, pool.tasks_executed());
+    });
+}
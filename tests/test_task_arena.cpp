@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/task_arena.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Tracks how many tasks run at once.
+struct Occupancy {
+    std::atomic<int> now{0};
+    std::atomic<int> peak{0};
+
+    void enter() {
+        const int n = now.fetch_add(1) + 1;
+        int seen = peak.load();
+        while (seen < n && !peak.compare_exchange_weak(seen, n)) {
+        }
+    }
+    void leave() { now.fetch_sub(1); }
+};
+
+void spin_for(std::chrono::microseconds duration) {
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+} // namespace
+
+TEST(TaskArenaTest, RunsEveryTaskAcrossArenas) {
+    lockfree::ThreadPool pool(4);
+    lockfree::TaskArena a(pool);
+    lockfree::TaskArena b(pool, lockfree::ArenaOptions(2, 2, 1));
+    std::atomic<int> sum(0);
+    for (int i = 1; i <= 1000; ++i) {
+        a.post([&sum, i] { sum += i; });
+        b.post([&sum, i] { sum += i; });
+    }
+    a.wait();
+    b.wait();
+    EXPECT_EQ(2 * (1000 * 1001 / 2), sum.load());
+    EXPECT_EQ(1000u, a.tasks_executed());
+    EXPECT_EQ(1000u, b.tasks_executed());
+    EXPECT_EQ(0u, a.pending_tasks());
+    EXPECT_EQ(0u, b.active_workers());
+}
+
+TEST(TaskArenaTest, SubmitReturnsResultOrException) {
+    lockfree::ThreadPool pool(2);
+    lockfree::TaskArena arena(pool);
+    EXPECT_EQ(42, arena.submit([] { return 42; }).get());
+    auto failed = arena.submit([]() -> int {
+        throw std::runtime_error("task failed");
+    });
+    EXPECT_THROW(failed.get(), std::runtime_error);
+    // Tasks posted from inside the arena land in the same arena.
+    auto nested = arena.submit([&arena] {
+        return arena.submit([] { return 7; });
+    });
+    EXPECT_EQ(7, nested.get().get());
+}
+
+TEST(TaskArenaTest, PostedExceptionsAreLogged) {
+    lockfree::ThreadPool pool(1);
+    lockfree::TaskArena arena(pool);
+    std::atomic_int after(0);
+    testing::internal::CaptureStderr();
+    arena.post([] { throw std::runtime_error("posted task failed"); });
+    arena.post([&after] { after.fetch_add(1); });
+    arena.wait();
+    const std::string log = testing::internal::GetCapturedStderr();
+    EXPECT_NE(std::string::npos, log.find("posted task failed"));
+    EXPECT_EQ(1, after.load());
+}
+
+TEST(TaskArenaTest, NeverExceedsMaxConcurrency) {
+    lockfree::ThreadPool pool(4);
+    lockfree::TaskArena background(pool, lockfree::ArenaOptions(1, 2));
+    Occupancy occupancy;
+    for (int i = 0; i < 200; ++i) {
+        background.post([&occupancy] {
+            occupancy.enter();
+            spin_for(std::chrono::microseconds(200));
+            occupancy.leave();
+        });
+    }
+    background.wait();
+    EXPECT_LE(occupancy.peak.load(), 2);
+    EXPECT_EQ(200u, background.tasks_executed());
+}
+
+// A flood in one arena never occupies the worker another reserved, so
+// work posted there starts without queueing behind the flood.
+TEST(TaskArenaTest, ReservedWorkersStayFree) {
+    lockfree::ThreadPool pool(3);
+    lockfree::TaskArena latency(pool, lockfree::ArenaOptions(1, 0, 1));
+    lockfree::TaskArena bulk(pool);
+    Occupancy occupancy;
+    for (int i = 0; i < 100; ++i) {
+        bulk.post([&occupancy] {
+            occupancy.enter();
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            occupancy.leave();
+        });
+    }
+    const auto posted = std::chrono::steady_clock::now();
+    auto started = latency.submit([] {
+        return std::chrono::steady_clock::now();
+    }).get();
+    // bulk has 50 ms of backlog per shared worker left.
+    EXPECT_LT(started - posted, std::chrono::milliseconds(40));
+    bulk.wait();
+    EXPECT_LE(occupancy.peak.load(), 2);
+}
+
+// Two arenas, always backlogged, on one worker: the freed worker goes to
+// whichever is behind its weighted share, so busy time splits 3:1.
+TEST(TaskArenaTest, WeightsSplitContendedWorkers) {
+    lockfree::ThreadPool pool(1);
+    lockfree::TaskArena heavy(pool, lockfree::ArenaOptions(3));
+    lockfree::TaskArena light(pool, lockfree::ArenaOptions(1));
+    std::atomic<bool> stop(false);
+    std::atomic<int> heavy_runs(0), light_runs(0);
+    // Each task reposts itself, so both arenas stay runnable.
+    std::function<void()> heavy_task, light_task;
+    heavy_task = [&] {
+        spin_for(std::chrono::microseconds(50));
+        ++heavy_runs;
+        if (!stop.load()) heavy.post(heavy_task);
+    };
+    light_task = [&] {
+        spin_for(std::chrono::microseconds(50));
+        ++light_runs;
+        if (!stop.load()) light.post(light_task);
+    };
+    for (int i = 0; i < 4; ++i) {
+        heavy.post(heavy_task);
+        light.post(light_task);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    stop.store(true);
+    heavy.wait();
+    light.wait();
+
+    const double ratio = static_cast<double>(heavy.busy_time().count()) /
+                         static_cast<double>(light.busy_time().count());
+    EXPECT_GT(ratio, 2.0);
+    EXPECT_LT(ratio, 4.5);
+    EXPECT_GT(heavy_runs.load(), 2 * light_runs.load());
+}
+
+TEST(TaskArenaTest, ReservationsMustFitThePool) {
+    lockfree::ThreadPool pool(3);
+    lockfree::TaskArena first(pool, lockfree::ArenaOptions(1, 0, 1));
+    EXPECT_THROW(lockfree::TaskArena(pool, lockfree::ArenaOptions(1, 0, 2)),
+                 std::invalid_argument);
+    EXPECT_THROW(lockfree::TaskArena(pool, lockfree::ArenaOptions(1, 1, 2)),
+                 std::invalid_argument);
+    {
+        lockfree::TaskArena second(pool, lockfree::ArenaOptions(1, 0, 1));
+    }
+    // second's reservation was returned.
+    lockfree::TaskArena third(pool, lockfree::ArenaOptions(1, 0, 1));
+    EXPECT_EQ(5, third.submit([] { return 5; }).get());
+}
+
+// Reserving the last shared worker would leave unreserved arenas with
+// nothing to run on, and their wait() spinning forever.
+TEST(TaskArenaTest, ReservationsLeaveASharedWorker) {
+    lockfree::ThreadPool pool(1);
+    EXPECT_THROW(lockfree::TaskArena(pool, lockfree::ArenaOptions(4, 0, 1)),
+                 std::invalid_argument);
+    lockfree::TaskArena compaction(pool, lockfree::ArenaOptions(1, 1));
+    EXPECT_EQ(7, compaction.submit([] { return 7; }).get());
+}
+
+// A Drain shutdown stops wait() early, but the drains the pool still
+// runs belong to the arena, so its destructor must outlast them.
+TEST(TaskArenaTest, DestructorOutlastsDrainsDuringShutdown) {
+    for (const lockfree::ShutdownMode mode :
+         {lockfree::ShutdownMode::Drain, lockfree::ShutdownMode::Abort}) {
+        lockfree::ThreadPool pool(2);
+        std::unique_ptr<lockfree::TaskArena> arena(new lockfree::TaskArena(pool));
+        std::atomic<int> running(0);
+        for (int i = 0; i < 20; ++i) {
+            arena->post([&running] {
+                ++running;
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                --running;
+            });
+        }
+        while (running.load() == 0) {
+            std::this_thread::yield();
+        }
+        std::thread stopper([&pool, mode] { pool.shutdown(mode); });
+        while (pool.running()) {
+            std::this_thread::yield();
+        }
+        arena.reset();
+        EXPECT_EQ(0, running.load());
+        stopper.join();
+    }
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/task_group.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Global heap allocations so far, counted by the replacement operators
+// in heap_counter.cpp; used to check that spawn() makes none.
+uint64_t heap_allocations();
+
+namespace {
+
+long fib(lockfree::ThreadPool& pool, int n) {
+    if (n < 2) {
+        return n;
+    }
+    long a = 0;
+    lockfree::TaskGroup group(pool);
+    group.spawn([&pool, &a, n] { a = fib(pool, n - 1); });
+    const long b = fib(pool, n - 2);
+    group.sync();
+    return a + b;
+}
+
+void quicksort(lockfree::ThreadPool& pool, int* first, int* last) {
+    while (last - first > 64) {
+        const int pivot = first[(last - first) / 2];
+        int* mid1 = std::partition(first, last,
+                                   [pivot](int v) { return v < pivot; });
+        int* mid2 = std::partition(mid1, last,
+                                   [pivot](int v) { return !(pivot < v); });
+        lockfree::TaskGroup group(pool);
+        group.spawn([&pool, first, mid1] { quicksort(pool, first, mid1); });
+        quicksort(pool, mid2, last);
+        group.sync();
+        return;
+    }
+    std::sort(first, last);
+}
+
+} // namespace
+
+// Every worker ends up blocked in sync() many levels deep, which with a
+// future per child would deadlock a 4-thread pool.
+TEST(TaskGroupTest, RecursionDeeperThanThreadCount) {
+    lockfree::ThreadPool pool(4);
+    EXPECT_EQ(46368, pool.submit([&pool] { return fib(pool, 24); }).get());
+}
+
+TEST(TaskGroupTest, SortsInParallel) {
+    lockfree::ThreadPool pool(4);
+    std::vector<int> data(200000);
+    std::mt19937 gen(7);
+    for (int& v : data) {
+        v = static_cast<int>(gen() % 1000);
+    }
+    std::vector<int> expected = data;
+    std::sort(expected.begin(), expected.end());
+
+    pool.submit([&pool, &data] {
+        quicksort(pool, data.data(), data.data() + data.size());
+    }).get();
+    EXPECT_EQ(expected, data);
+}
+
+TEST(TaskGroupTest, ManyChildrenOfOneGroup) {
+    lockfree::ThreadPool pool(4);
+    std::atomic<int> sum(0);
+    pool.submit([&pool, &sum] {
+        lockfree::TaskGroup group(pool);
+        // More than the inline slots and the deque hold at once.
+        for (int i = 1; i <= 2000; ++i) {
+            group.spawn([&sum, i] { sum += i; });
+        }
+        group.sync();
+        // Reusable after sync.
+        group.spawn([&sum] { sum += 1; });
+    }).get();
+    EXPECT_EQ(2000 * 2001 / 2 + 1, sum.load());
+}
+
+TEST(TaskGroupTest, SyncRethrowsFirstChildException) {
+    lockfree::ThreadPool pool(4);
+    std::atomic<int> ran(0);
+    auto result = pool.submit([&pool, &ran] {
+        lockfree::TaskGroup group(pool);
+        for (int i = 0; i < 16; ++i) {
+            group.spawn([&ran, i] {
+                ++ran;
+                if (i % 4 == 0) {
+                    throw std::runtime_error("child failed");
+                }
+            });
+        }
+        try {
+            group.sync();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    });
+    EXPECT_TRUE(result.get());
+    EXPECT_EQ(16, ran.load());
+}
+
+TEST(TaskGroupTest, SpawnFromOutsideThePool) {
+    lockfree::ThreadPool pool(2);
+    std::vector<int> out(100, 0);
+    lockfree::TaskGroup group(pool);
+    for (int i = 0; i < 100; ++i) {
+        group.spawn([&out, i] { out[i] = i * i; });
+    }
+    group.sync();
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(i * i, out[i]);
+    }
+    // Nested groups from outside the pool, all through the injector.
+    EXPECT_EQ(55, fib(pool, 10));
+}
+
+TEST(TaskGroupTest, SpawnAllocatesNothing) {
+    lockfree::ThreadPool pool(4);
+    // Warm up: thread-local state, trace-free steal paths.
+    pool.submit([&pool] { return fib(pool, 16); }).get();
+
+    auto result = pool.submit([&pool] {
+        const uint64_t before = heap_allocations();
+        const long value = fib(pool, 20);
+        return std::make_pair(value, heap_allocations() - before);
+    }).get();
+    EXPECT_EQ(6765, result.first);
+    // fib(20) spawns 10945 children.
+    EXPECT_EQ(0u, result.second);
+}
@@ -6,6 +6,10 @@
 #include <thread>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <functional>
+#include <new>
+#include <stdexcept>
 
 TEST(ThreadPoolTest, BasicTaskExecution) {
     lockfree::ThreadPool pool(2);
@@ -139,3 +143,381 @@ TEST(ThreadPoolTest, ResourceCleanup) {
     // Verify pool is destroyed after scope
     EXPECT_TRUE(weak_pool.expired());
 }
+
+TEST(ThreadPoolTest, ExternalSubmittersUseInjector) {
+    lockfree::ThreadPool pool(4);
+    constexpr int kSubmitters = 4;
+    constexpr int kTasks = 500;
+    std::atomic_int counter(0);
+
+    std::vector<std::thread> submitters;
+    for (int i = 0; i < kSubmitters; ++i) {
+        submitters.emplace_back([&] {
+            for (int j = 0; j < kTasks; ++j) {
+                pool.submit([&counter] {
+                    counter.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+        });
+    }
+    for (auto& t : submitters) {
+        t.join();
+    }
+
+    pool.wait();
+    EXPECT_EQ(kSubmitters * kTasks, counter.load());
+}
+
+TEST(ThreadPoolTest, NestedSubmitFromWorker) {
+    lockfree::ThreadPool pool(2);
+    std::atomic_int counter(0);
+
+    auto outer = pool.submit([&pool, &counter] {
+        std::vector<std::future<void>> inner;
+        for (int i = 0; i < 50; ++i) {
+            inner.push_back(pool.submit([&counter] {
+                counter.fetch_add(1, std::memory_order_relaxed);
+            }));
+        }
+        return static_cast<int>(inner.size());
+    });
+
+    EXPECT_EQ(50, outer.get());
+    pool.wait();
+    EXPECT_EQ(50, counter.load());
+}
+
+TEST(ThreadPoolTest, SkewedLoadIsStolen) {
+    lockfree::ThreadPool pool(4);
+    std::atomic_int counter(0);
+
+    // Everything lands in the local queue of whichever worker runs the seed.
+    pool.submit([&pool, &counter] {
+        for (int i = 0; i < 200; ++i) {
+            pool.submit([&counter] {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                counter.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+    }).get();
+
+    pool.wait();
+    EXPECT_EQ(200, counter.load());
+    EXPECT_GT(pool.tasks_stolen(), 0u);
+    EXPECT_GE(pool.steal_attempts(), 1u);
+}
+
+TEST(ThreadPoolTest, BusyWorkerStillServesInjector) {
+    lockfree::ThreadPool pool(1);
+    const int kLimit = 100000;
+    std::atomic_int respawns(0);
+    std::atomic_int served_at(-1);
+
+    // Keeps the only worker's local queue non-empty until the external
+    // task has run or the limit is hit.
+    std::function<void()> spin = [&] {
+        if (served_at.load() < 0 && respawns.fetch_add(1) < kLimit) {
+            pool.post(spin);
+        }
+    };
+    pool.submit([&] {
+        pool.post(spin);
+    }).get();
+    pool.submit([&] { served_at.store(respawns.load()); }).get();
+
+    EXPECT_GE(served_at.load(), 0);
+    EXPECT_LT(served_at.load(), kLimit);
+    pool.wait();
+}
+
+TEST(ThreadPoolTest, DrainFinishesQueuedAndNestedTasks) {
+    lockfree::ThreadPool pool(4);
+    const std::thread::id caller = std::this_thread::get_id();
+    std::atomic_int counter(0);
+    std::atomic_bool ran_on_caller(false);
+
+    auto task = [&] {
+        if (std::this_thread::get_id() == caller) {
+            ran_on_caller = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        counter.fetch_add(1, std::memory_order_relaxed);
+    };
+    for (int i = 0; i < 40; ++i) {
+        pool.submit(task);
+    }
+    // Spawned while the drain is in progress.
+    pool.submit([&pool, task] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pool.submit(task);
+    });
+
+    EXPECT_TRUE(pool.shutdown(lockfree::ShutdownMode::Drain));
+    EXPECT_EQ(41, counter.load());
+    EXPECT_FALSE(ran_on_caller.load());
+    EXPECT_FALSE(pool.running());
+    EXPECT_TRUE(pool.shutdown());  // Already stopped
+}
+
+TEST(ThreadPoolTest, DrainDeadlineDropsRemainingTasks) {
+    lockfree::ThreadPool pool(1);
+    std::promise<void> started;
+    auto started_future = started.get_future();
+
+    auto slow = pool.submit([&started] {
+        started.set_value();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    });
+    started_future.wait();
+
+    std::atomic_int counter(0);
+    std::vector<std::future<void>> queued;
+    for (int i = 0; i < 10; ++i) {
+        queued.push_back(pool.submit([&counter] {
+            counter.fetch_add(1, std::memory_order_relaxed);
+        }));
+    }
+
+    EXPECT_FALSE(pool.shutdown(lockfree::ShutdownMode::Drain,
+                               std::chrono::milliseconds(10)));
+    EXPECT_NO_THROW(slow.get());
+    EXPECT_EQ(0, counter.load());
+    for (auto& f : queued) {
+        EXPECT_THROW(f.get(), std::runtime_error);
+    }
+}
+
+TEST(ThreadPoolTest, AbortCancelsQueuedFutures) {
+    lockfree::ThreadPool pool(2);
+    std::promise<void> started;
+    auto started_future = started.get_future();
+    std::atomic_bool release(false);
+
+    auto blocker = pool.submit([&] {
+        started.set_value();
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+        return 7;
+    });
+    started_future.wait();
+
+    // Keep the second worker busy too so the rest stay queued.
+    std::promise<void> started2;
+    auto started2_future = started2.get_future();
+    auto blocker2 = pool.submit([&] {
+        started2.set_value();
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    started2_future.wait();
+
+    std::vector<std::future<int>> queued;
+    for (int i = 0; i < 20; ++i) {
+        queued.push_back(pool.submit([i] { return i; }));
+    }
+
+    std::thread releaser([&release] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        release = true;
+    });
+    EXPECT_TRUE(pool.shutdown(lockfree::ShutdownMode::Abort));
+    releaser.join();
+
+    EXPECT_EQ(7, blocker.get());
+    EXPECT_NO_THROW(blocker2.get());
+    for (auto& f : queued) {
+        EXPECT_THROW(f.get(), std::runtime_error);
+    }
+    EXPECT_THROW(pool.submit([] {}), std::runtime_error);
+}
+
+TEST(ThreadPoolTest, DestructorDoesNotRunQueuedTasks) {
+    const std::thread::id caller = std::this_thread::get_id();
+    std::atomic_bool ran_on_caller(false);
+    std::vector<std::future<void>> futures;
+    {
+        lockfree::ThreadPool pool(1);
+        for (int i = 0; i < 100; ++i) {
+            futures.push_back(pool.submit([&ran_on_caller, caller] {
+                if (std::this_thread::get_id() == caller) {
+                    ran_on_caller = true;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }));
+        }
+    }
+    EXPECT_FALSE(ran_on_caller.load());
+    // Every future is ready: either run by a worker or cancelled.
+    for (auto& f : futures) {
+        EXPECT_EQ(std::future_status::ready,
+                  f.wait_for(std::chrono::seconds(0)));
+    }
+}
+
+TEST(ThreadPoolTest, ShutdownFromTaskIsRejected) {
+    lockfree::ThreadPool pool(1);
+    auto f = pool.submit([&pool] { pool.shutdown(); });
+    EXPECT_THROW(f.get(), std::logic_error);
+}
+
+TEST(ThreadPoolTest, DelayedAndPeriodicTasks) {
+    lockfree::ThreadPool pool(2);
+    std::promise<std::chrono::steady_clock::time_point> fired;
+    auto fired_at = fired.get_future();
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.submit_after(std::chrono::milliseconds(20), [&fired] {
+        fired.set_value(std::chrono::steady_clock::now());
+    });
+    ASSERT_EQ(std::future_status::ready,
+              fired_at.wait_for(std::chrono::seconds(5)));
+    EXPECT_GE(fired_at.get() - start, std::chrono::milliseconds(20));
+
+    std::atomic_int ticks(0);
+    lockfree::TimerHandle periodic = pool.submit_every(
+        std::chrono::milliseconds(2), [&ticks] { ticks.fetch_add(1); });
+    lockfree::TimerHandle never = pool.submit_at(
+        std::chrono::steady_clock::now() + std::chrono::hours(1),
+        [] { FAIL() << "cancelled timer ran"; });
+    EXPECT_TRUE(never.cancel());
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (ticks.load() < 5 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_GE(ticks.load(), 5);
+    EXPECT_TRUE(periodic.cancel());
+}
+
+TEST(ThreadPoolTest, ShutdownCancelsPendingTimers) {
+    auto payload = std::make_shared<int>(1);
+    std::weak_ptr<int> weak = payload;
+    lockfree::TimerHandle handle;
+    {
+        lockfree::ThreadPool pool(1);
+        handle = pool.submit_after(std::chrono::seconds(60), [payload] {});
+        payload.reset();
+        EXPECT_FALSE(weak.expired());
+        pool.shutdown(lockfree::ShutdownMode::Drain);
+        EXPECT_THROW(pool.submit_after(std::chrono::milliseconds(1), [] {}),
+                     std::runtime_error);
+    }
+    EXPECT_TRUE(weak.expired());
+    EXPECT_FALSE(handle.active());
+}
+
+TEST(ThreadPoolTest, LifoModeRunsNewestSpawnFirst) {
+    for (auto mode : {lockfree::SchedulingMode::Fifo,
+                      lockfree::SchedulingMode::Lifo}) {
+        lockfree::ThreadPool pool(1, mode);
+        EXPECT_EQ(mode, pool.scheduling_mode());
+        std::mutex mutex;
+        std::vector<int> order;
+        pool.submit([&] {
+            for (int i = 0; i < 3; ++i) {
+                pool.post([&, i] {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    order.push_back(i);
+                });
+            }
+        }).get();
+        pool.wait();
+
+        // LIFO: the last spawn sits in the slot, the ones it displaced
+        // queue up oldest first.
+        const std::vector<int> expected =
+            mode == lockfree::SchedulingMode::Lifo ? std::vector<int>{2, 0, 1}
+                                                   : std::vector<int>{0, 1, 2};
+        EXPECT_EQ(expected, order);
+    }
+}
+
+TEST(ThreadPoolTest, LifoModeStillSpreadsAndDrains) {
+    lockfree::ThreadPool pool(4, lockfree::SchedulingMode::Lifo);
+    std::atomic_int counter(0);
+
+    // A chain that keeps respawning into the slot must not starve the
+    // local queue, which the other workers steal from.
+    std::function<void(int)> chain = [&](int depth) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+        if (depth > 0) {
+            pool.post([&chain, depth] { chain(depth - 1); });
+        }
+    };
+    pool.submit([&] {
+        for (int i = 0; i < 200; ++i) {
+            pool.post([&counter] {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                counter.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        chain(1000);
+    }).get();
+
+    EXPECT_TRUE(pool.shutdown(lockfree::ShutdownMode::Drain));
+    EXPECT_EQ(1201, counter.load());
+    EXPECT_GT(pool.tasks_stolen(), 0u);
+}
+
+// active_tasks() and the statistics are summed over per-worker shards;
+// spawns from workers and submissions from outside must both count.
+TEST(ThreadPoolTest, ShardedCountersAddUp) {
+    lockfree::ThreadPool pool(4);
+    std::atomic<bool> release(false);
+    std::atomic<int> spawned_done(0);
+
+    pool.post([&pool, &release, &spawned_done] {
+        for (int i = 0; i < 100; ++i) {
+            pool.post([&release, &spawned_done] {
+                while (!release.load()) {
+                    std::this_thread::yield();
+                }
+                ++spawned_done;
+            });
+        }
+    });
+    for (int i = 0; i < 50; ++i) {
+        pool.post([&release] {
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    // The seed may or may not have finished, the rest are all blocked.
+    while (spawned_done.load() == 0 && pool.active_tasks() < 150) {
+        std::this_thread::yield();
+    }
+    EXPECT_GE(pool.active_tasks(), 150u);
+    EXPECT_LE(pool.active_tasks(), 151u);
+
+    release.store(true);
+    pool.wait();
+    EXPECT_EQ(0u, pool.active_tasks());
+    EXPECT_EQ(151u, pool.tasks_executed());
+}
+
+// The non-throwing calls report failures as statuses and leave nothing
+// counted in for a task that was never queued.
+TEST(ThreadPoolTest, TrySubmissionReportsStatus) {
+    struct ThrowingCopy {
+        ThrowingCopy() {}
+        ThrowingCopy(const ThrowingCopy&) { throw std::bad_alloc(); }
+        void operator()() const {}
+    };
+    lockfree::ThreadPool pool(2);
+    ThrowingCopy closure;
+    EXPECT_EQ(lockfree::SubmitStatus::NoMemory, pool.try_post(closure));
+
+    std::future<int> future;
+    EXPECT_EQ(lockfree::SubmitStatus::Ok,
+              pool.try_submit([] { return 3; }, future));
+    EXPECT_EQ(3, future.get());
+    pool.wait();
+    EXPECT_EQ(0u, pool.active_tasks());
+
+    EXPECT_TRUE(pool.shutdown());
+    EXPECT_EQ(lockfree::SubmitStatus::Shutdown, pool.try_post([] {}));
+    EXPECT_THROW(pool.post([] {}), std::runtime_error);
+}
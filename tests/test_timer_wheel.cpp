@@ -0,0 +1,286 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/timer_wheel.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = lockfree::TimerWheel::Clock;
+using std::chrono::milliseconds;
+
+// Polls the wheel at origin + ms and runs whatever fires inline.
+size_t advance_to(lockfree::TimerWheel& wheel, Clock::time_point origin,
+                  long ms) {
+    return wheel.poll(origin + milliseconds(ms),
+                      [&wheel](lockfree::detail::TimerRef timer) {
+        wheel.run(timer);
+    });
+}
+
+} // namespace
+
+TEST(TimerWheelTest, FiresAtDeadlineNotBefore) {
+    const Clock::time_point origin = Clock::now();
+    lockfree::TimerWheel wheel(milliseconds(1), origin);
+    int fired = 0;
+    wheel.schedule(origin + milliseconds(10), Clock::duration::zero(),
+                   [&fired] { ++fired; });
+    EXPECT_EQ(1u, wheel.pending());
+
+    EXPECT_EQ(0u, advance_to(wheel, origin, 9));
+    EXPECT_EQ(0, fired);
+    EXPECT_EQ(1u, advance_to(wheel, origin, 10));
+    EXPECT_EQ(1, fired);
+    EXPECT_EQ(0u, wheel.pending());
+}
+
+TEST(TimerWheelTest, CascadesAcrossLevelsInOrder) {
+    const Clock::time_point origin = Clock::now();
+    lockfree::TimerWheel wheel(milliseconds(1), origin);
+    // One timer per level plus one beyond the wheel's span.
+    const long deadlines[] = {3, 300, 70000, 20000000, 5000000000L};
+    std::vector<long> order;
+    for (long d : deadlines) {
+        wheel.schedule(origin + milliseconds(d), Clock::duration::zero(),
+                       [&order, d] { order.push_back(d); });
+    }
+    advance_to(wheel, origin, 0);
+
+    for (long d : deadlines) {
+        advance_to(wheel, origin, d - 1);
+        EXPECT_TRUE(order.empty() || order.back() != d);
+        advance_to(wheel, origin, d);
+        ASSERT_FALSE(order.empty());
+        EXPECT_EQ(d, order.back());
+    }
+    EXPECT_EQ(5u, order.size());
+}
+
+TEST(TimerWheelTest, CancelFreesCallableImmediately) {
+    const Clock::time_point origin = Clock::now();
+    lockfree::TimerWheel wheel(milliseconds(1), origin);
+    auto payload = std::make_shared<int>(42);
+    std::weak_ptr<int> weak = payload;
+    lockfree::TimerHandle handle = wheel.schedule(
+        origin + milliseconds(1000), Clock::duration::zero(),
+        [payload] { FAIL() << "cancelled timer ran"; });
+    payload.reset();
+
+    EXPECT_TRUE(handle.active());
+    EXPECT_TRUE(handle.cancel());
+    EXPECT_FALSE(handle.active());
+    EXPECT_TRUE(weak.expired());
+    EXPECT_FALSE(handle.cancel());
+
+    EXPECT_EQ(0u, advance_to(wheel, origin, 2000));
+    EXPECT_EQ(0u, wheel.pending());
+}
+
+TEST(TimerWheelTest, PeriodicTimerRearmsUntilCancelled) {
+    const Clock::time_point origin = Clock::now();
+    lockfree::TimerWheel wheel(milliseconds(1), origin);
+    std::atomic_int runs(0);
+    lockfree::TimerHandle handle = wheel.schedule(
+        Clock::now() + milliseconds(2), milliseconds(2), [&runs] { ++runs; });
+
+    const auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (runs.load() < 3 && Clock::now() < deadline) {
+        wheel.poll(Clock::now(), [&wheel](lockfree::detail::TimerRef timer) {
+            wheel.run(timer);
+        });
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    EXPECT_GE(runs.load(), 3);
+    EXPECT_TRUE(handle.active());
+    EXPECT_TRUE(handle.cancel());
+
+    const int seen = runs.load();
+    for (int i = 0; i < 10; ++i) {
+        wheel.poll(Clock::now(), [&wheel](lockfree::detail::TimerRef timer) {
+            wheel.run(timer);
+        });
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    EXPECT_EQ(seen, runs.load());
+}
+
+TEST(TimerWheelTest, ManyTimersMostlyCancelled) {
+    const Clock::time_point origin = Clock::now();
+    lockfree::TimerWheel wheel(milliseconds(1), origin);
+    const int kTimers = 200000;
+    int fired = 0;
+    std::vector<lockfree::TimerHandle> handles;
+    handles.reserve(kTimers);
+    for (int i = 0; i < kTimers; ++i) {
+        handles.push_back(wheel.schedule(
+            origin + milliseconds(1 + i % 5000), Clock::duration::zero(),
+            [&fired] { ++fired; }));
+    }
+    for (int i = 0; i < kTimers; ++i) {
+        if (i % 10 != 0) {
+            EXPECT_TRUE(handles[i].cancel());
+        }
+    }
+    advance_to(wheel, origin, 5000);
+    EXPECT_EQ(kTimers / 10, fired);
+    EXPECT_EQ(0u, wheel.pending());
+}
+
+// Cancelled nodes are unlinked at the next poll, not when the wheel gets
+// round to their slot an hour later.
+TEST(TimerWheelTest, CancelledLongTimeoutsFreedAtNextPoll) {
+    const Clock::time_point origin = Clock::now();
+    lockfree::TimerWheel wheel(milliseconds(1), origin);
+    std::vector<lockfree::TimerHandle> handles;
+    for (int i = 0; i < 1000; ++i) {
+        handles.push_back(wheel.schedule(
+            origin + std::chrono::hours(1) + milliseconds(i),
+            Clock::duration::zero(), [] { FAIL() << "cancelled timer ran"; }));
+    }
+    int fired = 0;
+    lockfree::TimerHandle kept = wheel.schedule(
+        origin + milliseconds(500), Clock::duration::zero(), [&fired] { ++fired; });
+    advance_to(wheel, origin, 1);  // files them all
+    EXPECT_EQ(1001u, wheel.pending());
+
+    for (auto& handle : handles) {
+        EXPECT_TRUE(handle.cancel());
+    }
+    advance_to(wheel, origin, 2);
+    EXPECT_EQ(1u, wheel.pending());
+    // Cancelled while still in the inbox.
+    lockfree::TimerHandle early = wheel.schedule(
+        origin + std::chrono::hours(2), Clock::duration::zero(), [] {});
+    EXPECT_TRUE(early.cancel());
+    advance_to(wheel, origin, 3);
+    EXPECT_EQ(1u, wheel.pending());
+
+    advance_to(wheel, origin, 500);
+    EXPECT_EQ(1, fired);
+    EXPECT_EQ(0u, wheel.pending());
+}
+
+// next_deadline() is what idle pollers park until: never past the earliest
+// live timer, and not held early by cancelled ones.
+TEST(TimerWheelTest, NextDeadlineTracksEarliestLiveTimer) {
+    const Clock::time_point origin = Clock::now();
+    lockfree::TimerWheel wheel(milliseconds(1), origin);
+    int wakes = 0;
+    wheel.set_wake([](void* count) { ++*static_cast<int*>(count); }, &wakes);
+    EXPECT_EQ(Clock::time_point::max(), wheel.next_deadline());
+
+    lockfree::TimerHandle late = wheel.schedule(
+        origin + milliseconds(1000), Clock::duration::zero(), [] {});
+    EXPECT_EQ(origin + milliseconds(1000), wheel.next_deadline());
+    lockfree::TimerHandle soon = wheel.schedule(
+        origin + milliseconds(500), Clock::duration::zero(), [] {});
+    EXPECT_EQ(origin + milliseconds(500), wheel.next_deadline());
+    wheel.schedule(origin + milliseconds(2000), Clock::duration::zero(), [] {});
+    EXPECT_EQ(2, wakes);  // only the two that moved it earlier
+
+    // Filed on a coarser level, the 500 ms timer needs a cascade first.
+    advance_to(wheel, origin, 1);
+    EXPECT_GT(wheel.next_deadline(), origin + milliseconds(1));
+    EXPECT_LE(wheel.next_deadline(), origin + milliseconds(500));
+    advance_to(wheel, origin, 300);
+    EXPECT_EQ(origin + milliseconds(500), wheel.next_deadline());
+
+    EXPECT_TRUE(soon.cancel());
+    advance_to(wheel, origin, 301);
+    EXPECT_GT(wheel.next_deadline(), origin + milliseconds(500));
+    EXPECT_LE(wheel.next_deadline(), origin + milliseconds(1000));
+
+    EXPECT_TRUE(late.cancel());
+    advance_to(wheel, origin, 2000);
+    EXPECT_EQ(0u, wheel.pending());
+    EXPECT_EQ(Clock::time_point::max(), wheel.next_deadline());
+}
+
+// A periodic timer whose firing task is dropped unrun, as by a pool that
+// shuts down, reads as cancelled rather than running.
+TEST(TimerWheelTest, DroppedFiringTaskAbandonsTimer) {
+    const Clock::time_point origin = Clock::now();
+    lockfree::TimerWheel wheel(milliseconds(1), origin);
+    int runs = 0;
+    lockfree::TimerHandle handle = wheel.schedule(
+        origin + milliseconds(5), milliseconds(5), [&runs] { ++runs; });
+    EXPECT_EQ(1u, wheel.poll(origin + milliseconds(5),
+                             [&wheel](lockfree::detail::TimerRef timer) {
+        lockfree::detail::TimerTask dropped(wheel, std::move(timer));
+    }));
+    EXPECT_FALSE(handle.active());
+    EXPECT_FALSE(handle.cancel());
+    EXPECT_EQ(0u, advance_to(wheel, origin, 100));
+    EXPECT_EQ(0, runs);
+}
+
+// A fire callback that throws loses only its own timer; the ones due
+// with it fire on the next poll.
+TEST(TimerWheelTest, ThrowingFireKeepsTheRestDue) {
+    const Clock::time_point origin = Clock::now();
+    lockfree::TimerWheel wheel(milliseconds(1), origin);
+    int runs = 0;
+    std::vector<lockfree::TimerHandle> handles;
+    for (int i = 0; i < 3; ++i) {
+        handles.push_back(wheel.schedule(origin + milliseconds(5),
+                                         Clock::duration::zero(),
+                                         [&runs] { ++runs; }));
+    }
+    EXPECT_THROW(wheel.poll(origin + milliseconds(5),
+                            [&wheel](lockfree::detail::TimerRef timer) {
+        lockfree::detail::TimerTask task(wheel, std::move(timer));
+        throw std::bad_alloc();
+    }), std::bad_alloc);
+    EXPECT_EQ(2u, wheel.pending());
+
+    EXPECT_EQ(2u, advance_to(wheel, origin, 6));
+    EXPECT_EQ(2, runs);
+    EXPECT_EQ(0u, wheel.pending());
+    int active = 0;
+    for (auto& handle : handles) {
+        active += handle.active();
+    }
+    EXPECT_EQ(0, active);
+}
+
+TEST(TimerWheelTest, ConcurrentScheduleAndPoll) {
+    lockfree::TimerWheel wheel(milliseconds(1));
+    std::atomic_int fired(0);
+    std::atomic_bool done(false);
+    const int kThreads = 4;
+    const int kPerThread = 1000;
+
+    std::thread poller([&] {
+        while (!done.load() || wheel.pending() > 0) {
+            wheel.poll(Clock::now(), [&wheel](lockfree::detail::TimerRef timer) {
+                wheel.run(timer);
+            });
+            std::this_thread::yield();
+        }
+    });
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; ++t) {
+        producers.emplace_back([&] {
+            for (int i = 0; i < kPerThread; ++i) {
+                lockfree::TimerHandle h = wheel.schedule(
+                    Clock::now() + milliseconds(i % 7), Clock::duration::zero(),
+                    [&fired] { fired.fetch_add(1); });
+                if (i % 2) {
+                    h.cancel();
+                }
+            }
+        });
+    }
+    for (auto& p : producers) {
+        p.join();
+    }
+    done = true;
+    poller.join();
+    // Odd ones may have fired before the cancel landed.
+    EXPECT_GE(fired.load(), kThreads * kPerThread / 2);
+    EXPECT_LE(fired.load(), kThreads * kPerThread);
+}
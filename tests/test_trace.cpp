@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "../include/lockfree/thread_pool.hpp"
+#include "../include/lockfree/trace.hpp"
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+size_t count_of(const std::string& haystack, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string::npos;
+         pos = haystack.find(needle, pos + needle.size())) {
+        ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+TEST(TraceTest, RingKeepsNewestEvents) {
+    lockfree::TraceRing ring(4);
+    EXPECT_EQ(4u, ring.capacity());
+    for (uint64_t i = 0; i < 10; ++i) {
+        ring.record(lockfree::TraceEventKind::Submit, i);
+    }
+    EXPECT_EQ(10u, ring.recorded());
+
+    std::vector<lockfree::TraceEvent> events;
+    ring.snapshot(events);
+    ASSERT_EQ(4u, events.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        EXPECT_EQ(6 + i, events[i].arg);
+        EXPECT_EQ(lockfree::TraceEventKind::Submit, events[i].kind);
+        if (i > 0) {
+            EXPECT_GE(events[i].timestamp, events[i - 1].timestamp);
+        }
+    }
+}
+
+TEST(TraceTest, SnapshotWhileRecording) {
+    lockfree::TraceRing ring(64);
+    std::atomic<bool> done(false);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&ring, &done]() {
+            while (!done.load(std::memory_order_relaxed)) {
+                ring.record(lockfree::TraceEventKind::Steal, 42);
+            }
+        });
+    }
+
+    std::vector<lockfree::TraceEvent> events;
+    for (int i = 0; i < 1000; ++i) {
+        events.clear();
+        ring.snapshot(events);
+        EXPECT_LE(events.size(), ring.capacity());
+        for (const auto& e : events) {
+            EXPECT_EQ(42u, e.arg);
+            EXPECT_EQ(lockfree::TraceEventKind::Steal, e.kind);
+        }
+    }
+    done.store(true);
+    for (auto& w : writers) {
+        w.join();
+    }
+}
+
+TEST(TraceTest, PoolExportsChromeTrace) {
+    lockfree::ThreadPool pool(2);
+    std::ostringstream before;
+    EXPECT_FALSE(pool.write_trace(before));
+
+    pool.enable_tracing();
+    const int kTasks = 100;
+    for (int i = 0; i < kTasks; ++i) {
+        pool.submit([]() {});
+    }
+    pool.wait();
+    pool.disable_tracing();
+    // Not recorded once tracing is off.
+    pool.submit([]() {}).get();
+
+    std::ostringstream out;
+    ASSERT_TRUE(pool.write_trace(out));
+    const std::string json = out.str();
+    EXPECT_EQ(0u, json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"worker 0\""));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"external\""));
+    EXPECT_EQ(static_cast<size_t>(kTasks),
+              count_of(json, "\"name\":\"submit\""));
+    EXPECT_EQ(static_cast<size_t>(kTasks),
+              count_of(json, "\"name\":\"task\",\"ph\":\"B\""));
+    EXPECT_EQ(static_cast<size_t>(kTasks),
+              count_of(json, "\"name\":\"task\",\"ph\":\"E\""));
+}